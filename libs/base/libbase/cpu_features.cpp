@@ -0,0 +1,55 @@
+#include "cpu_features.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+
+namespace {
+
+SimdLevel detectSimdLevel() {
+#ifdef LIBBASE_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return SimdLevel::AVX2;
+    if (__builtin_cpu_supports("sse4.1"))
+        return SimdLevel::SSE41;
+#endif
+    return SimdLevel::Scalar;
+}
+
+SimdLevel levelFromEnvironment(SimdLevel detected) {
+    const char *value = std::getenv("CVPUZZLE_SIMD");
+    if (!value)
+        return detected;
+    const std::string name = value;
+    SimdLevel requested = detected;
+    if (name == "scalar")
+        requested = SimdLevel::Scalar;
+    else if (name == "sse41")
+        requested = SimdLevel::SSE41;
+    else if (name == "avx2")
+        requested = SimdLevel::AVX2;
+    // environment can only lower the level - unsupported instructions would crash
+    return std::min(requested, detected);
+}
+
+} // namespace
+
+SimdLevel maxSimdLevel() {
+    static const SimdLevel level = levelFromEnvironment(detectSimdLevel());
+    return level;
+}
+
+SimdLevel supportedSimdLevel(SimdLevel level) { return std::min(level, maxSimdLevel()); }
+
+const char *simdLevelName(SimdLevel level) {
+    switch (level) {
+    case SimdLevel::Scalar:
+        return "scalar";
+    case SimdLevel::SSE41:
+        return "sse4.1";
+    case SimdLevel::AVX2:
+        return "avx2";
+    }
+    return "unknown";
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+// Defined if x86 SIMD kernels can be compiled (with __attribute__((target(...))) and <immintrin.h>),
+// they still must be called only if maxSimdLevel() allows it
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define LIBBASE_X86_SIMD
+#endif
+
+// Instruction sets which can be used by SIMD kernels, from the weakest to the strongest
+enum class SimdLevel {
+    Scalar = 0,
+    SSE41 = 1,
+    AVX2 = 2,
+};
+
+// The strongest instruction set supported by both the CPU (detected at runtime, once) and the build.
+// On non-x86 platforms (and with compilers other than GCC/Clang) it is always SimdLevel::Scalar.
+// Can be lowered with environment variable CVPUZZLE_SIMD=scalar|sse41|avx2 (f.e. to compare results/speed).
+SimdLevel maxSimdLevel();
+
+// min(level, maxSimdLevel()) - what kernels actually run when asked for level
+SimdLevel supportedSimdLevel(SimdLevel level);
+
+const char *simdLevelName(SimdLevel level);
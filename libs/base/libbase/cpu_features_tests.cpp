@@ -0,0 +1,14 @@
+#include "cpu_features.h"
+
+#include <gtest/gtest.h>
+
+#include <iostream>
+
+TEST(cpu_features, levelsAreOrdered) {
+    std::cout << "max SIMD level: " << simdLevelName(maxSimdLevel()) << std::endl;
+
+    EXPECT_EQ(supportedSimdLevel(SimdLevel::Scalar), SimdLevel::Scalar);
+    EXPECT_LE(supportedSimdLevel(SimdLevel::SSE41), SimdLevel::SSE41);
+    EXPECT_EQ(supportedSimdLevel(SimdLevel::AVX2), maxSimdLevel());
+    EXPECT_EQ(maxSimdLevel(), maxSimdLevel());
+}
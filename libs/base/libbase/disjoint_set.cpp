@@ -47,4 +47,39 @@ bool DisjointSetUnion::unite(std::size_t a, std::size_t b, std::source_location
 std::size_t DisjointSetUnion::set_size(std::size_t x, std::source_location loc) const {
     const std::size_t r = find(x, loc);
     return sz_[r];
-}
\ No newline at end of file
+}
+
+ConcurrentDisjointSetUnion::ConcurrentDisjointSetUnion(std::size_t n) : parent_(n) {
+    for (std::size_t i = 0; i < n; ++i)
+        parent_[i].store(i, std::memory_order_relaxed);
+}
+
+std::size_t ConcurrentDisjointSetUnion::find(std::size_t x, std::source_location loc) {
+    rassert(x < size(), 2391578193415, x, size(), format_code_location(loc));
+    while (true) {
+        std::size_t parent = parent_[x].load(std::memory_order_acquire);
+        if (parent == x)
+            return x;
+        const std::size_t grandparent = parent_[parent].load(std::memory_order_acquire);
+        if (grandparent != parent) {
+            // path halving - if another thread already changed parent[x], it is fine to skip it
+            parent_[x].compare_exchange_weak(parent, grandparent, std::memory_order_acq_rel);
+        }
+        x = grandparent;
+    }
+}
+
+bool ConcurrentDisjointSetUnion::unite(std::size_t a, std::size_t b, std::source_location loc) {
+    while (true) {
+        a = find(a, loc);
+        b = find(b, loc);
+        if (a == b)
+            return false;
+        if (a < b)
+            std::swap(a, b);
+        // link the larger root to the smaller one, retry if the larger root was linked by another thread meanwhile
+        std::size_t expected = a;
+        if (parent_[a].compare_exchange_strong(expected, b, std::memory_order_acq_rel))
+            return true;
+    }
+}
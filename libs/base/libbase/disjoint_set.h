@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <source_location>
 #include <utility>
 #include <vector>
@@ -25,4 +26,22 @@ public:
 private:
     std::vector<std::size_t> parent_;
     std::vector<std::size_t> sz_;
+};
+
+// Lock-free union-find: find() and unite() can be called from many threads at once.
+// Sets are linked by index (root of a set is always its minimal element) and find() does path halving with CAS,
+// so parent[x] <= x always holds and roots don't depend on the order of unite() calls.
+class ConcurrentDisjointSetUnion final {
+public:
+    explicit ConcurrentDisjointSetUnion(std::size_t n);
+
+    std::size_t size() const noexcept { return parent_.size(); }
+
+    std::size_t find(std::size_t x, std::source_location loc = std::source_location::current());
+
+    // Unites sets containing a and b. Returns true if merged (by this call).
+    bool unite(std::size_t a, std::size_t b, std::source_location loc = std::source_location::current());
+
+private:
+    std::vector<std::atomic<std::size_t>> parent_;
 };
\ No newline at end of file
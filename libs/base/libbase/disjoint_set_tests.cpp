@@ -5,6 +5,7 @@
 #include <cstddef>
 #include <cstdint>
 #include <random>
+#include <thread>
 #include <unordered_map>
 #include <utility>
 #include <vector>
@@ -279,4 +280,54 @@ TEST(DisjointSetUnion, StressLargeAgainstRefDsu) {
 
         (void)rx2;
     }
-}
\ No newline at end of file
+}
+TEST(ConcurrentDisjointSetUnion, RootIsMinimalElement) {
+    ConcurrentDisjointSetUnion dsu(6);
+    EXPECT_TRUE(dsu.unite(5, 3));
+    EXPECT_TRUE(dsu.unite(3, 4));
+    EXPECT_FALSE(dsu.unite(4, 5));
+    EXPECT_TRUE(dsu.unite(1, 4));
+    EXPECT_EQ(dsu.find(5), 1);
+    EXPECT_EQ(dsu.find(4), 1);
+    EXPECT_EQ(dsu.find(0), 0);
+    EXPECT_EQ(dsu.find(2), 2);
+}
+
+TEST(ConcurrentDisjointSetUnion, ManyThreadsMatchReference) {
+    constexpr std::size_t N = 20000;
+    constexpr int THREADS = 4;
+    constexpr int EDGES_PER_THREAD = 10000;
+
+    std::mt19937 rng(239);
+    std::uniform_int_distribution<std::size_t> dist(0, N - 1);
+    std::vector<std::vector<std::pair<std::size_t, std::size_t>>> edges(THREADS);
+    RefDsu ref(N);
+    for (auto &thread_edges : edges) {
+        for (int k = 0; k < EDGES_PER_THREAD; ++k) {
+            thread_edges.emplace_back(dist(rng), dist(rng));
+            ref.unite(thread_edges.back().first, thread_edges.back().second);
+        }
+    }
+
+    ConcurrentDisjointSetUnion dsu(N);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < THREADS; ++t) {
+        threads.emplace_back([&, t] {
+            for (auto [a, b] : edges[t])
+                dsu.unite(a, b);
+        });
+    }
+    for (auto &thread : threads)
+        thread.join();
+
+    // root of each set is its minimal element - the same as in the reference partition
+    std::unordered_map<std::size_t, std::size_t> min_of_ref_set;
+    for (std::size_t x = 0; x < N; ++x) {
+        const std::size_t r = ref.find(x);
+        if (!min_of_ref_set.count(r))
+            min_of_ref_set[r] = x;
+    }
+    for (std::size_t x = 0; x < N; ++x) {
+        ASSERT_EQ(dsu.find(x), min_of_ref_set[ref.find(x)]);
+    }
+}
@@ -100,40 +100,58 @@ template <AllowedType T> T maxValue(const std::vector<T> &values) {
     return *std::max_element(values.begin(), values.end());
 }
 
-template <AllowedType T> double percentile(const std::vector<T> &values, double p) {
-    if (values.empty())
+template <AllowedType T> double percentileInPlace(T *values, std::size_t n, double p) {
+    if (n == 0)
         throw std::invalid_argument("percentile: empty input");
+    if constexpr (std::is_same_v<T, std::uint8_t>) {
+        // counting select - values are left in place
+        Histogram<256> histogram;
+        histogram.add(values, n);
+        return histogram.percentile(p);
+    }
     if (!(p >= 0.0 && p <= 100.0))
         throw std::invalid_argument("percentile: p out of range [0,100]");
 
-    const std::size_t n = values.size();
     if (n == 1)
         return static_cast<double>(values[0]);
 
-    auto v = toDoubles(values);
-
     if (p <= 0.0)
-        return *std::min_element(v.begin(), v.end());
+        return static_cast<double>(*std::min_element(values, values + n));
     if (p >= 100.0)
-        return *std::max_element(v.begin(), v.end());
+        return static_cast<double>(*std::max_element(values, values + n));
 
     const double q = p / 100.0;
     const double pos = q * static_cast<double>(n - 1);
     const std::size_t i = static_cast<std::size_t>(std::floor(pos));
     const std::size_t j = static_cast<std::size_t>(std::ceil(pos));
 
-    std::nth_element(v.begin(), v.begin() + static_cast<std::ptrdiff_t>(i), v.end());
-    const double a = v[i];
+    std::nth_element(values, values + i, values + n);
+    const double a = static_cast<double>(values[i]);
     if (j == i)
         return a;
 
-    std::nth_element(v.begin(), v.begin() + static_cast<std::ptrdiff_t>(j), v.end());
-    const double b = v[j];
+    // j == i + 1: after nth_element all values to the right of i are not less than values[i],
+    // so the j-th order statistic is just the smallest of them
+    const double b = static_cast<double>(*std::min_element(values + j, values + n));
 
     const double t = pos - static_cast<double>(i);
     return a + t * (b - a);
 }
 
+template <AllowedType T> double medianInPlace(T *values, std::size_t n) { return percentileInPlace(values, n, 50.0); }
+
+template <AllowedType T> double percentile(const std::vector<T> &values, double p) {
+    if (values.empty())
+        throw std::invalid_argument("percentile: empty input");
+    if constexpr (std::is_same_v<T, std::uint8_t>) {
+        Histogram<256> histogram;
+        histogram.add(values.data(), values.size());
+        return histogram.percentile(p);
+    }
+    auto v = toDoubles(values);
+    return percentileInPlace(v.data(), v.size(), p);
+}
+
 template <AllowedType T> double sum(const std::vector<T> &values) {
     double total_sum = 0.0;
     for (const T &value: values) {
@@ -285,45 +303,67 @@ template std::string toPercent<float>(float part, float total);
 template std::string toPercent<double>(double part, double total);
 template std::string toPercent<std::size_t>(std::size_t part, std::size_t total);
 template std::string toPercent<std::uint8_t>(std::uint8_t part, std::uint8_t total);
+template std::string toPercent<std::uint16_t>(std::uint16_t part, std::uint16_t total);
 
 template int minValue<int>(const std::vector<int> &);
 template float minValue<float>(const std::vector<float> &);
 template double minValue<double>(const std::vector<double> &);
 template std::size_t minValue<std::size_t>(const std::vector<std::size_t> &);
 template std::uint8_t minValue<std::uint8_t>(const std::vector<std::uint8_t> &);
+template std::uint16_t minValue<std::uint16_t>(const std::vector<std::uint16_t> &);
 
 template int maxValue<int>(const std::vector<int> &);
 template float maxValue<float>(const std::vector<float> &);
 template double maxValue<double>(const std::vector<double> &);
 template std::size_t maxValue<std::size_t>(const std::vector<std::size_t> &);
 template std::uint8_t maxValue<std::uint8_t>(const std::vector<std::uint8_t> &);
+template std::uint16_t maxValue<std::uint16_t>(const std::vector<std::uint16_t> &);
 
 template double sum<int>(const std::vector<int> &);
 template double sum<float>(const std::vector<float> &);
 template double sum<double>(const std::vector<double> &);
 template double sum<std::size_t>(const std::vector<std::size_t> &);
 template double sum<std::uint8_t>(const std::vector<std::uint8_t> &);
+template double sum<std::uint16_t>(const std::vector<std::uint16_t> &);
 
 template double median<int>(const std::vector<int> &);
 template double median<float>(const std::vector<float> &);
 template double median<double>(const std::vector<double> &);
 template double median<std::size_t>(const std::vector<std::size_t> &);
 template double median<std::uint8_t>(const std::vector<std::uint8_t> &);
+template double median<std::uint16_t>(const std::vector<std::uint16_t> &);
 
 template double percentile<int>(const std::vector<int> &, double);
 template double percentile<float>(const std::vector<float> &, double);
 template double percentile<double>(const std::vector<double> &, double);
 template double percentile<std::size_t>(const std::vector<std::size_t> &, double);
 template double percentile<std::uint8_t>(const std::vector<std::uint8_t> &, double);
+template double percentile<std::uint16_t>(const std::vector<std::uint16_t> &, double);
+
+template double percentileInPlace<int>(int *, std::size_t, double);
+template double percentileInPlace<float>(float *, std::size_t, double);
+template double percentileInPlace<double>(double *, std::size_t, double);
+template double percentileInPlace<std::size_t>(std::size_t *, std::size_t, double);
+template double percentileInPlace<std::uint8_t>(std::uint8_t *, std::size_t, double);
+template double percentileInPlace<std::uint16_t>(std::uint16_t *, std::size_t, double);
+
+template double medianInPlace<int>(int *, std::size_t);
+template double medianInPlace<float>(float *, std::size_t);
+template double medianInPlace<double>(double *, std::size_t);
+template double medianInPlace<std::size_t>(std::size_t *, std::size_t);
+template double medianInPlace<std::uint8_t>(std::uint8_t *, std::size_t);
+template double medianInPlace<std::uint16_t>(std::uint16_t *, std::size_t);
 
 template std::string previewValues<int>(const std::vector<int> &);
 template std::string previewValues<float>(const std::vector<float> &);
 template std::string previewValues<double>(const std::vector<double> &);
 template std::string previewValues<std::size_t>(const std::vector<std::size_t> &);
 template std::string previewValues<std::uint8_t>(const std::vector<std::uint8_t> &);
+template std::string previewValues<std::uint16_t>(const std::vector<std::uint16_t> &);
 
 template std::string summaryStats<int>(const std::vector<int> &);
 template std::string summaryStats<std::size_t>(const std::vector<std::size_t> &);
 template std::string summaryStats<std::uint8_t>(const std::vector<std::uint8_t> &);
+template std::string summaryStats<std::uint16_t>(const std::vector<std::uint16_t> &);
 
 } // namespace stats
\ No newline at end of file
@@ -1,7 +1,10 @@
 #pragma once
 
+#include <array>
+#include <cmath>
 #include <cstddef>
 #include <cstdint>
+#include <stdexcept>
 #include <string>
 #include <type_traits>
 #include <vector>
@@ -10,7 +13,8 @@ namespace stats {
 
 template <typename T>
 concept AllowedType = std::is_same_v<T, int> || std::is_same_v<T, float> || std::is_same_v<T, double> ||
-                      std::is_same_v<T, std::size_t> || std::is_same_v<T, std::uint8_t>;
+                      std::is_same_v<T, std::size_t> || std::is_same_v<T, std::uint8_t> ||
+                      std::is_same_v<T, std::uint16_t>;
 
 template <typename T> std::string toPercent(T part, T total);
 
@@ -29,6 +33,63 @@ template <AllowedType T> double median(const std::vector<T> &values);
 // Throws std::invalid_argument if values is empty or p out of range.
 template <AllowedType T> double percentile(const std::vector<T> &values, double p);
 
+// The same as percentile()/median(), but selects in place - reorders values[0..n) and doesn't allocate.
+// Throws std::invalid_argument if n == 0 or p out of range.
+template <AllowedType T> double percentileInPlace(T *values, std::size_t n, double p);
+template <AllowedType T> double medianInPlace(T *values, std::size_t n);
+
+// Counting histogram of integer values in [0, Bins) - for bounded-range data (8-bit intensities, color differences...).
+// percentile()/median() select by counting in O(Bins) and give the same result as percentile()/median() of all added values.
+// Counters are stored inline (no allocation), values can be added one by one as a streaming accumulator.
+// percentile()/median() of std::uint8_t values use it internally.
+template <std::size_t Bins> class Histogram final {
+  public:
+    // value must be < Bins (not checked)
+    void add(std::size_t value) noexcept {
+        ++counts_[value];
+        ++total_;
+    }
+    template <typename T> void add(const T *values, std::size_t n) noexcept {
+        for (std::size_t i = 0; i < n; ++i)
+            add(static_cast<std::size_t>(values[i]));
+    }
+    void clear() noexcept {
+        counts_.fill(0);
+        total_ = 0;
+    }
+
+    std::size_t total() const noexcept { return total_; }
+    std::size_t count(std::size_t value) const noexcept { return counts_[value]; }
+
+    // Throws std::invalid_argument if the histogram is empty or p out of range [0, 100].
+    double percentile(double p) const {
+        if (total_ == 0)
+            throw std::invalid_argument("percentile: empty input");
+        if (!(p >= 0.0 && p <= 100.0))
+            throw std::invalid_argument("percentile: p out of range [0,100]");
+
+        const double pos = p / 100.0 * static_cast<double>(total_ - 1);
+        const std::size_t i = static_cast<std::size_t>(std::floor(pos));
+        const std::size_t j = static_cast<std::size_t>(std::ceil(pos));
+        // values with ranks i and j (j is i or i + 1) in the sorted order of all added values
+        std::size_t v = 0;
+        std::size_t seen = counts_[0];
+        while (seen <= i)
+            seen += counts_[++v];
+        const double a = static_cast<double>(v);
+        if (j == i)
+            return a;
+        while (seen <= j)
+            seen += counts_[++v];
+        return a + (pos - static_cast<double>(i)) * (static_cast<double>(v) - a);
+    }
+    double median() const { return percentile(50.0); }
+
+  private:
+    std::array<std::uint32_t, Bins> counts_{};
+    std::size_t total_ = 0;
+};
+
 // "N values - [v0, v1, v2, v3, v4, ... vN-5, vN-4, vN-3, vN-2, vN-1]"
 // If N <= 10: list all values.
 // If N == 0: "0 values - []"
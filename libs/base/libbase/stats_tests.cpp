@@ -90,3 +90,62 @@ TEST(Stats, SummaryEmpty) {
     EXPECT_EQ(stats::summaryStats(v), "0 values - (empty)");
     EXPECT_EQ(stats::summaryStats(v, 5), "0 values - (empty)");
 }
+
+TEST(Stats, PercentileInPlaceMatchesPercentile) {
+    std::vector<std::uint16_t> v;
+    for (int i = 0; i < 101; ++i) {
+        v.push_back(static_cast<std::uint16_t>((i * 37) % 101 + (i % 3 == 0 ? 500 : 0)));
+    }
+    for (std::size_t n: {1u, 2u, 7u, 50u, 101u}) {
+        const std::vector<std::uint16_t> prefix(v.begin(), v.begin() + n);
+        for (double p: {0.0, 5.0, 25.0, 50.0, 90.0, 100.0}) {
+            std::vector<std::uint16_t> scratch = prefix;
+            EXPECT_EQ(stats::percentileInPlace(scratch.data(), n, p), stats::percentile(prefix, p));
+        }
+        std::vector<std::uint16_t> scratch = prefix;
+        EXPECT_EQ(stats::medianInPlace(scratch.data(), n), stats::median(prefix));
+    }
+
+    std::vector<float> f{3.0f, 1.0f, 2.0f, 10.0f};
+    EXPECT_DOUBLE_EQ(stats::medianInPlace(f.data(), f.size()), 2.5);
+    EXPECT_THROW(stats::medianInPlace(f.data(), 0), std::invalid_argument);
+}
+
+TEST(Stats, HistogramMatchesPercentile) {
+    std::vector<int> v;
+    stats::Histogram<766> histogram;
+    for (int i = 0; i < 257; ++i) {
+        const int value = (i * 131) % 766;
+        v.push_back(value);
+        histogram.add(value);
+        if (i == 0 || i == 1 || i == 10 || i == 256) {
+            // streaming: percentiles are valid after every added value
+            for (double p: {0.0, 5.0, 33.3, 50.0, 90.0, 100.0}) {
+                EXPECT_DOUBLE_EQ(histogram.percentile(p), stats::percentile(v, p)) << i << " " << p;
+            }
+            EXPECT_DOUBLE_EQ(histogram.median(), stats::median(v));
+        }
+    }
+    EXPECT_EQ(histogram.total(), v.size());
+
+    histogram.clear();
+    EXPECT_EQ(histogram.total(), 0u);
+    EXPECT_THROW(histogram.median(), std::invalid_argument);
+    histogram.add(5);
+    EXPECT_THROW(histogram.percentile(101), std::invalid_argument);
+}
+
+TEST(Stats, PercentileUint8MatchesInt) {
+    std::vector<std::uint8_t> v;
+    std::vector<int> ints;
+    for (int i = 0; i < 77; ++i) {
+        v.push_back(static_cast<std::uint8_t>((i * 97) % 256));
+        ints.push_back(v.back());
+    }
+    for (double p: {0.0, 10.0, 50.0, 90.0, 100.0}) {
+        EXPECT_DOUBLE_EQ(stats::percentile(v, p), stats::percentile(ints, p));
+        std::vector<std::uint8_t> scratch = v;
+        EXPECT_DOUBLE_EQ(stats::percentileInPlace(scratch.data(), scratch.size(), p), stats::percentile(ints, p));
+    }
+    EXPECT_THROW(stats::percentile(v, -1), std::invalid_argument);
+}
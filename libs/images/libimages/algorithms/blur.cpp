@@ -1,5 +1,6 @@
 #include "blur.h"
 
+#include <libbase/cpu_features.h>
 #include <libbase/runtime_assert.h>
 
 #include <algorithm>
@@ -8,6 +9,14 @@
 #include <type_traits>
 #include <vector>
 
+#ifdef LIBBASE_X86_SIMD
+#include <immintrin.h>
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 namespace {
 
 inline int clampi(int v, int lo, int hi) noexcept {
@@ -66,177 +75,207 @@ inline T from_f(float v) noexcept {
     }
 }
 
-// --------------------- Image blur: 1 channel ---------------------
+// --------------------- SIMD kernels ---------------------
+// All levels sum the taps in the same order with separate multiply and add (no FMA),
+// so they give bit-identical results (and identical to the straightforward per-pixel loops).
 
-template <typename T>
-Image<T> blur_gray(const Image<T>& image, const Kernel1D& k) {
-    const int W = image.width();
-    const int H = image.height();
-    const int R = k.r;
-    const float* kw = k.w.data();
-
-    std::vector<float> tmp(static_cast<size_t>(W) * static_cast<size_t>(H), 0.0f);
-
-    #pragma omp parallel for
-    for (int y = 0; y < H; ++y) {
-        const size_t row = static_cast<size_t>(y) * static_cast<size_t>(W);
-
-        const int leftEnd = std::min(R, W);
-        for (int x = 0; x < leftEnd; ++x) {
-            float acc = 0.0f;
-            for (int dx = -R; dx <= R; ++dx) {
-                const int sx = clampi(x + dx, 0, W - 1);
-                acc += kw[dx + R] * to_f(image(y, sx));
-            }
-            tmp[row + static_cast<size_t>(x)] = acc;
+// dst[k] = sum over t of kw[t] * rows[t][k], for k in [from, n)
+void convolve_rows_scalar(const float* const* rows, int taps, const float* kw, int from, int n, float* dst) {
+    for (int k = from; k < n; ++k) {
+        float acc = 0.0f;
+        for (int t = 0; t < taps; ++t) {
+            acc += kw[t] * rows[t][k];
         }
+        dst[k] = acc;
+    }
+}
 
-        const int midBegin = R;
-        const int midEnd = W - R;
-        if (midBegin < midEnd) {
-            for (int x = midBegin; x < midEnd; ++x) {
-                float acc = 0.0f;
-                for (int dx = -R; dx <= R; ++dx) {
-                    acc += kw[dx + R] * to_f(image(y, x + dx));
-                }
-                tmp[row + static_cast<size_t>(x)] = acc;
-            }
-        }
+// values[k] = lround(clamp(values[k], 0, 255)), for k in [from, n)
+void round_to_u8_scalar(float* values, int from, int n) {
+    for (int k = from; k < n; ++k) {
+        values[k] = static_cast<float>(from_f<std::uint8_t>(values[k]));
+    }
+}
 
-        const int rightBegin = std::max(leftEnd, midEnd);
-        for (int x = rightBegin; x < W; ++x) {
-            float acc = 0.0f;
-            for (int dx = -R; dx <= R; ++dx) {
-                const int sx = clampi(x + dx, 0, W - 1);
-                acc += kw[dx + R] * to_f(image(y, sx));
-            }
-            tmp[row + static_cast<size_t>(x)] = acc;
+#ifdef LIBBASE_X86_SIMD
+
+__attribute__((target("sse4.1")))
+void convolve_rows_sse41(const float* const* rows, int taps, const float* kw, int n, float* dst) {
+    int k = 0;
+    for (; k + 8 <= n; k += 8) {
+        __m128 acc0 = _mm_setzero_ps();
+        __m128 acc1 = _mm_setzero_ps();
+        for (int t = 0; t < taps; ++t) {
+            const __m128 w = _mm_set1_ps(kw[t]);
+            acc0 = _mm_add_ps(acc0, _mm_mul_ps(w, _mm_loadu_ps(rows[t] + k)));
+            acc1 = _mm_add_ps(acc1, _mm_mul_ps(w, _mm_loadu_ps(rows[t] + k + 4)));
         }
+        _mm_storeu_ps(dst + k, acc0);
+        _mm_storeu_ps(dst + k + 4, acc1);
     }
+    convolve_rows_scalar(rows, taps, kw, k, n, dst);
+}
 
-    Image<T> out(W, H, 1);
-
-    #pragma omp parallel for
-    for (int y = 0; y < H; ++y) {
-        const bool midY = (y >= R && y < H - R);
+__attribute__((target("sse4.1")))
+void round_to_u8_sse41(float* values, int n) {
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 max = _mm_set1_ps(255.0f);
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 one = _mm_set1_ps(1.0f);
+    int k = 0;
+    for (; k + 4 <= n; k += 4) {
+        const __m128 v = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(values + k), zero), max);
+        // lround for non-negative values: round half away from zero (not to even as _mm_cvtps_epi32 does)
+        const __m128 truncated = _mm_round_ps(v, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+        const __m128 round_up = _mm_and_ps(_mm_cmpge_ps(_mm_sub_ps(v, truncated), half), one);
+        _mm_storeu_ps(values + k, _mm_add_ps(truncated, round_up));
+    }
+    round_to_u8_scalar(values, k, n);
+}
 
-        for (int x = 0; x < W; ++x) {
-            float acc = 0.0f;
+__attribute__((target("avx2")))
+void convolve_rows_avx2(const float* const* rows, int taps, const float* kw, int n, float* dst) {
+    int k = 0;
+    for (; k + 16 <= n; k += 16) {
+        __m256 acc0 = _mm256_setzero_ps();
+        __m256 acc1 = _mm256_setzero_ps();
+        for (int t = 0; t < taps; ++t) {
+            const __m256 w = _mm256_set1_ps(kw[t]);
+            acc0 = _mm256_add_ps(acc0, _mm256_mul_ps(w, _mm256_loadu_ps(rows[t] + k)));
+            acc1 = _mm256_add_ps(acc1, _mm256_mul_ps(w, _mm256_loadu_ps(rows[t] + k + 8)));
+        }
+        _mm256_storeu_ps(dst + k, acc0);
+        _mm256_storeu_ps(dst + k + 8, acc1);
+    }
+    convolve_rows_scalar(rows, taps, kw, k, n, dst);
+}
 
-            if (midY) {
-                for (int dy = -R; dy <= R; ++dy) {
-                    const int sy = y + dy;
-                    acc += kw[dy + R] * tmp[static_cast<size_t>(sy) * static_cast<size_t>(W) + static_cast<size_t>(x)];
-                }
-            } else {
-                for (int dy = -R; dy <= R; ++dy) {
-                    const int sy = clampi(y + dy, 0, H - 1);
-                    acc += kw[dy + R] * tmp[static_cast<size_t>(sy) * static_cast<size_t>(W) + static_cast<size_t>(x)];
-                }
-            }
+__attribute__((target("avx2")))
+void round_to_u8_avx2(float* values, int n) {
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 max = _mm256_set1_ps(255.0f);
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256 one = _mm256_set1_ps(1.0f);
+    int k = 0;
+    for (; k + 8 <= n; k += 8) {
+        const __m256 v = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(values + k), zero), max);
+        const __m256 truncated = _mm256_round_ps(v, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+        const __m256 round_up = _mm256_and_ps(_mm256_cmp_ps(_mm256_sub_ps(v, truncated), half, _CMP_GE_OQ), one);
+        _mm256_storeu_ps(values + k, _mm256_add_ps(truncated, round_up));
+    }
+    round_to_u8_scalar(values, k, n);
+}
 
-            out(y, x) = from_f<T>(acc);
-        }
+#endif
+
+void convolve_rows(SimdLevel level, const float* const* rows, int taps, const float* kw, int n, float* dst) {
+    switch (level) {
+#ifdef LIBBASE_X86_SIMD
+    case SimdLevel::AVX2:
+        convolve_rows_avx2(rows, taps, kw, n, dst);
+        return;
+    case SimdLevel::SSE41:
+        convolve_rows_sse41(rows, taps, kw, n, dst);
+        return;
+#endif
+    default:
+        convolve_rows_scalar(rows, taps, kw, 0, n, dst);
+        return;
     }
+}
 
-    return out;
+void round_to_u8(SimdLevel level, float* values, int n) {
+    switch (level) {
+#ifdef LIBBASE_X86_SIMD
+    case SimdLevel::AVX2:
+        round_to_u8_avx2(values, n);
+        return;
+    case SimdLevel::SSE41:
+        round_to_u8_sse41(values, n);
+        return;
+#endif
+    default:
+        round_to_u8_scalar(values, 0, n);
+        return;
+    }
 }
 
-// --------------------- Image blur: 3 channels ---------------------
+// --------------------- Image blur ---------------------
 
+// Separable blur of interleaved rows (W pixels * C channels), clamp-to-edge border.
+// Rows are processed in horizontal bands (one per thread): each source row is converted to float once
+// (with R replicated pixels on both sides), blurred horizontally into a ring buffer of 2R+1 rows,
+// and each output row is blurred vertically from the ring buffer rows.
 template <typename T>
-Image<T> blur_rgb(const Image<T>& image, const Kernel1D& k) {
+Image<T> blur_separable(const Image<T>& image, const Kernel1D& k, SimdLevel level) {
     const int W = image.width();
     const int H = image.height();
+    const int C = image.channels();
     const int R = k.r;
+    const int taps = 2 * R + 1;
     const float* kw = k.w.data();
-
-    std::vector<float> tmp(static_cast<size_t>(W) * static_cast<size_t>(H) * 3u, 0.0f);
-
-    auto idx3 = [&](int x, int y) -> size_t {
-        return (static_cast<size_t>(y) * static_cast<size_t>(W) + static_cast<size_t>(x)) * 3u;
-    };
-
-    #pragma omp parallel for
-    for (int y = 0; y < H; ++y) {
-        const int leftEnd = std::min(R, W);
-        for (int x = 0; x < leftEnd; ++x) {
-            float a0 = 0, a1 = 0, a2 = 0;
-            for (int dx = -R; dx <= R; ++dx) {
-                const int sx = clampi(x + dx, 0, W - 1);
-                const float w = kw[dx + R];
-                a0 += w * to_f(image(y, sx, 0));
-                a1 += w * to_f(image(y, sx, 1));
-                a2 += w * to_f(image(y, sx, 2));
-            }
-            const size_t o = idx3(x, y);
-            tmp[o + 0] = a0; tmp[o + 1] = a1; tmp[o + 2] = a2;
-        }
-
-        const int midBegin = R;
-        const int midEnd = W - R;
-        if (midBegin < midEnd) {
-            for (int x = midBegin; x < midEnd; ++x) {
-                float a0 = 0, a1 = 0, a2 = 0;
-                for (int dx = -R; dx <= R; ++dx) {
-                    const int sx = x + dx;
-                    const float w = kw[dx + R];
-                    a0 += w * to_f(image(y, sx, 0));
-                    a1 += w * to_f(image(y, sx, 1));
-                    a2 += w * to_f(image(y, sx, 2));
+    const int rowSize = W * C;
+
+    Image<T> out(W, H, C, ImageInit::Uninitialized);
+
+    int bands = 1;
+#ifdef _OPENMP
+    bands = std::max(1, std::min(H, omp_get_max_threads()));
+#endif
+
+    #pragma omp parallel for schedule(static)
+    for (int band = 0; band < bands; ++band) {
+        const int y0 = static_cast<int>(static_cast<long long>(H) * band / bands);
+        const int y1 = static_cast<int>(static_cast<long long>(H) * (band + 1) / bands);
+
+        std::vector<float> padded(static_cast<std::size_t>(W + 2 * R) * C);
+        std::vector<float> ring(static_cast<std::size_t>(taps) * rowSize);
+        std::vector<float> acc(rowSize);
+        std::vector<const float*> rows(taps);
+
+        auto ringRow = [&](int sy) -> float* { return ring.data() + static_cast<std::size_t>(sy % taps) * rowSize; };
+
+        // horizontal pass of source row sy into its ring buffer slot
+        auto blurRow = [&](int sy) {
+            const T* srcRow = image.row(sy);
+            for (int x = -R; x < W + R; ++x) {
+                const int sx = clampi(x, 0, W - 1);
+                for (int c = 0; c < C; ++c) {
+                    padded[static_cast<std::size_t>(x + R) * C + c] = to_f(srcRow[static_cast<std::size_t>(sx) * C + c]);
                 }
-                const size_t o = idx3(x, y);
-                tmp[o + 0] = a0; tmp[o + 1] = a1; tmp[o + 2] = a2;
             }
-        }
-
-        const int rightBegin = std::max(leftEnd, midEnd);
-        for (int x = rightBegin; x < W; ++x) {
-            float a0 = 0, a1 = 0, a2 = 0;
-            for (int dx = -R; dx <= R; ++dx) {
-                const int sx = clampi(x + dx, 0, W - 1);
-                const float w = kw[dx + R];
-                a0 += w * to_f(image(y, sx, 0));
-                a1 += w * to_f(image(y, sx, 1));
-                a2 += w * to_f(image(y, sx, 2));
+            for (int t = 0; t < taps; ++t) {
+                rows[t] = padded.data() + static_cast<std::size_t>(t) * C;
+            }
+            convolve_rows(level, rows.data(), taps, kw, rowSize, ringRow(sy));
+        };
+
+        // rows in the ring buffer are [max(0, y - R), min(H - 1, y + R)] - at most taps consecutive rows, so slots sy % taps don't collide
+        int nextRow = std::max(0, y0 - R);
+        for (int y = y0; y < y1; ++y) {
+            for (; nextRow <= std::min(H - 1, y + R); ++nextRow) {
+                blurRow(nextRow);
+            }
+            for (int t = 0; t < taps; ++t) {
+                rows[t] = ringRow(clampi(y + t - R, 0, H - 1));
             }
-            const size_t o = idx3(x, y);
-            tmp[o + 0] = a0; tmp[o + 1] = a1; tmp[o + 2] = a2;
-        }
-    }
-
-    Image<T> out(W, H, 3);
-
-    #pragma omp parallel for
-    for (int y = 0; y < H; ++y) {
-        const bool midY = (y >= R && y < H - R);
-
-        for (int x = 0; x < W; ++x) {
-            float a0 = 0, a1 = 0, a2 = 0;
 
-            if (midY) {
-                for (int dy = -R; dy <= R; ++dy) {
-                    const int sy = y + dy;
-                    const float w = kw[dy + R];
-                    const size_t o = idx3(x, sy);
-                    a0 += w * tmp[o + 0];
-                    a1 += w * tmp[o + 1];
-                    a2 += w * tmp[o + 2];
-                }
+            T* dstRow = out.row(y);
+            if constexpr (std::is_same_v<T, float>) {
+                convolve_rows(level, rows.data(), taps, kw, rowSize, dstRow);
             } else {
-                for (int dy = -R; dy <= R; ++dy) {
-                    const int sy = clampi(y + dy, 0, H - 1);
-                    const float w = kw[dy + R];
-                    const size_t o = idx3(x, sy);
-                    a0 += w * tmp[o + 0];
-                    a1 += w * tmp[o + 1];
-                    a2 += w * tmp[o + 2];
+                convolve_rows(level, rows.data(), taps, kw, rowSize, acc.data());
+                if constexpr (std::is_same_v<T, std::uint8_t>) {
+                    round_to_u8(level, acc.data(), rowSize);
+                    for (int i = 0; i < rowSize; ++i) {
+                        dstRow[i] = static_cast<std::uint8_t>(acc[i]);
+                    }
+                } else {
+                    for (int i = 0; i < rowSize; ++i) {
+                        dstRow[i] = from_f<T>(acc[i]);
+                    }
                 }
             }
-
-            out(y, x, 0) = from_f<T>(a0);
-            out(y, x, 1) = from_f<T>(a1);
-            out(y, x, 2) = from_f<T>(a2);
         }
     }
 
@@ -246,7 +285,7 @@ Image<T> blur_rgb(const Image<T>& image, const Kernel1D& k) {
 } // namespace
 
 template <typename T>
-Image<T> blur(const Image<T> &image, float strength) {
+Image<T> blur(const Image<T> &image, float strength, SimdLevel level) {
     if (!(strength > 0.0f)) return image;
 
     const int W = image.width();
@@ -258,99 +297,69 @@ Image<T> blur(const Image<T> &image, float strength) {
     const Kernel1D k = makeGaussianKernel(strength);
     if (k.r == 0) return image;
 
-    return (C == 1) ? blur_gray(image, k) : blur_rgb(image, k);
+    return blur_separable(image, k, supportedSimdLevel(level));
 }
 
 template <typename T>
-std::vector<Color<T>> blur(const std::vector<Color<T>> &colors, float strength) {
+ColorStrip<T> blur(const ColorStrip<T> &colors, float strength) {
     if (!(strength > 0.0f)) return colors;
-    if (colors.empty()) return {};
+    if (colors.empty()) return colors;
 
     const Kernel1D k = makeGaussianKernel(strength);
     if (k.r == 0) return colors;
 
     const int R = k.r;
     const float* kw = k.w.data();
-    const int n = static_cast<int>(colors.size());
-    const int C = colors[0].channels();
-    rassert(C == 1 || C == 3, 981234003, C);
-
-    // flat tmp: [c*n + i]
-    std::vector<float> tmp(static_cast<size_t>(n) * static_cast<size_t>(C), 0.0f);
-
-    auto t = [&](int c, int i) -> float& {
-        return tmp[static_cast<size_t>(c) * static_cast<size_t>(n) + static_cast<size_t>(i)];
-    };
+    const int n = colors.length();
+    const int C = colors.channels();
 
-    for (int i = 0; i < n; ++i) {
-        const bool mid = (i >= R && i < n - R);
+    ColorStrip<T> out(n, C);
+    // each channel is a separate contiguous plane - blur them independently
+    for (int c = 0; c < C; ++c) {
+        const T* src = colors.channel(c);
+        T* dst = out.channel(c);
 
-        if (C == 1) {
+        const int leftEnd = std::min(R, n);
+        const int midEnd = n - R;
+        const int rightBegin = std::max(leftEnd, midEnd);
+        for (int i = 0; i < leftEnd; ++i) {
             float acc = 0.0f;
-            if (mid) {
-                for (int d = -R; d <= R; ++d) {
-                    const float w = kw[d + R];
-                    const auto& col = colors[i + d];
-                    acc += w * to_f(col(0));
-                }
-            } else {
-                for (int d = -R; d <= R; ++d) {
-                    const int si = clampi(i + d, 0, n - 1);
-                    const float w = kw[d + R];
-                    const auto& col = colors[si];
-                    acc += w * to_f(col(0));
-                }
-            }
-            t(0, i) = acc;
-        } else {
-            float a0 = 0, a1 = 0, a2 = 0;
-            if (mid) {
-                for (int d = -R; d <= R; ++d) {
-                    const float w = kw[d + R];
-                    const auto& col = colors[static_cast<size_t>(i + d)];
-                    a0 += w * to_f(col(0));
-                    a1 += w * to_f(col(1));
-                    a2 += w * to_f(col(2));
-                }
-            } else {
-                for (int d = -R; d <= R; ++d) {
-                    const int si = clampi(i + d, 0, n - 1);
-                    const float w = kw[d + R];
-                    const auto& col = colors[static_cast<size_t>(si)];
-                    a0 += w * to_f(col(0));
-                    a1 += w * to_f(col(1));
-                    a2 += w * to_f(col(2));
-                }
+            for (int d = -R; d <= R; ++d) {
+                acc += kw[d + R] * to_f(src[clampi(i + d, 0, n - 1)]);
             }
-            t(0, i) = a0;
-            t(1, i) = a1;
-            t(2, i) = a2;
+            dst[i] = from_f<T>(acc);
         }
-    }
-
-    std::vector<Color<T>> out;
-    out.reserve(static_cast<size_t>(n));
-
-    if (C == 1) {
-        for (int i = 0; i < n; ++i) {
-            out.emplace_back(from_f<T>(t(0, i)));
+        for (int i = leftEnd; i < midEnd; ++i) {
+            float acc = 0.0f;
+            for (int d = -R; d <= R; ++d) {
+                acc += kw[d + R] * to_f(src[i + d]);
+            }
+            dst[i] = from_f<T>(acc);
         }
-    } else {
-        for (int i = 0; i < n; ++i) {
-            out.emplace_back(
-                from_f<T>(t(0, i)),
-                from_f<T>(t(1, i)),
-                from_f<T>(t(2, i))
-            );
+        for (int i = rightBegin; i < n; ++i) {
+            float acc = 0.0f;
+            for (int d = -R; d <= R; ++d) {
+                acc += kw[d + R] * to_f(src[clampi(i + d, 0, n - 1)]);
+            }
+            dst[i] = from_f<T>(acc);
         }
     }
 
     return out;
 }
 
+template <typename T>
+std::vector<Color<T>> blur(const std::vector<Color<T>> &colors, float strength) {
+    if (colors.empty()) return {};
+    return blur(ColorStrip<T>(colors), strength).toColors();
+}
+
 // explicit instantiations
-template Image<std::uint8_t> blur(const Image<std::uint8_t>& image, float strength);
-template Image<float>        blur(const Image<float>& image, float strength);
+template Image<std::uint8_t> blur(const Image<std::uint8_t>& image, float strength, SimdLevel level);
+template Image<float>        blur(const Image<float>& image, float strength, SimdLevel level);
+
+template ColorStrip<std::uint8_t> blur(const ColorStrip<std::uint8_t>& colors, float strength);
+template ColorStrip<float>        blur(const ColorStrip<float>& colors, float strength);
 
 template std::vector<Color<std::uint8_t>> blur(const std::vector<Color<std::uint8_t>>& colors, float strength);
 template std::vector<Color<float>>        blur(const std::vector<Color<float>>& colors, float strength);
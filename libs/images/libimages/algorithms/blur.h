@@ -2,11 +2,19 @@
 
 #include <vector>
 
+#include <libbase/cpu_features.h>
 #include <libimages/color.h>
+#include <libimages/color_strip.h>
 #include <libimages/image.h>
 
+// Gaussian blur with sigma = strength (clamp-to-edge border), separable and vectorized
+// with the strongest supported SIMD instructions up to level - all levels give the same result.
 template <typename T>
-Image<T> blur(const Image<T> &image, float strength);
+Image<T> blur(const Image<T> &image, float strength, SimdLevel level = SimdLevel::AVX2);
 
+template <typename T>
+ColorStrip<T> blur(const ColorStrip<T> &colors, float strength);
+
+// the same as blur(ColorStrip) - kept for convenience, prefer strips in hot loops
 template <typename T>
 std::vector<Color<T>> blur(const std::vector<Color<T>> &colors, float strength);
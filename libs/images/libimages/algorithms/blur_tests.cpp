@@ -3,12 +3,16 @@
 #include <gtest/gtest.h>
 
 #include <libbase/configure_working_directory.h>
+#include <libbase/fast_random.h>
+#include <libbase/timer.h>
 #include <libimages/debug_io.h>
 #include <libimages/image.h>
 
 #include <algorithm>
 #include <cmath>
 #include <cstdint>
+#include <iostream>
+#include <type_traits>
 #include <vector>
 #include <libimages/tests_utils.h>
 
@@ -51,6 +55,95 @@ static image8u visualizeLines(const std::vector<color8u>& a, const std::vector<c
     return img;
 }
 
+// Reference: previous implementation of Image blur - per-pixel loops through checked accessors
+// (its separate branches for the middle and the borders of the image gave the same values, so they are merged).
+// The vectorized blur must give exactly the same result.
+static std::vector<float> referenceGaussianKernel(float sigma, int &r) {
+    const float s = std::max(0.001f, sigma);
+    r = std::max(0, static_cast<int>(std::ceil(3.0f * s)));
+    std::vector<float> w(static_cast<size_t>(2 * r + 1), 0.0f);
+    const float inv2s2 = 1.0f / (2.0f * s * s);
+    float sum = 0.0f;
+    for (int i = 0; i <= r; ++i) {
+        const float v = std::exp(-(float)(i * i) * inv2s2);
+        w[static_cast<size_t>(r + i)] = v;
+        w[static_cast<size_t>(r - i)] = v;
+        sum += (i == 0) ? v : (2.0f * v);
+    }
+    const float invSum = (sum > 0.0f) ? (1.0f / sum) : 1.0f;
+    for (float& v : w) v *= invSum;
+    return w;
+}
+
+template <typename T>
+static Image<T> referenceBlur(const Image<T>& image, float sigma) {
+    int R = 0;
+    const std::vector<float> kw = referenceGaussianKernel(sigma, R);
+    const int W = image.width();
+    const int H = image.height();
+    const int C = image.channels();
+
+    Image<float> tmp(W, H, C);
+    #pragma omp parallel for
+    for (int y = 0; y < H; ++y) {
+        for (int x = 0; x < W; ++x) {
+            for (int c = 0; c < C; ++c) {
+                float acc = 0.0f;
+                for (int dx = -R; dx <= R; ++dx) {
+                    const int sx = std::clamp(x + dx, 0, W - 1);
+                    acc += kw[dx + R] * static_cast<float>(image(y, sx, c));
+                }
+                tmp(y, x, c) = acc;
+            }
+        }
+    }
+
+    Image<T> out(W, H, C);
+    #pragma omp parallel for
+    for (int y = 0; y < H; ++y) {
+        for (int x = 0; x < W; ++x) {
+            for (int c = 0; c < C; ++c) {
+                float acc = 0.0f;
+                for (int dy = -R; dy <= R; ++dy) {
+                    const int sy = std::clamp(y + dy, 0, H - 1);
+                    acc += kw[dy + R] * tmp(sy, x, c);
+                }
+                if constexpr (std::is_same_v<T, float>) {
+                    out(y, x, c) = acc;
+                } else {
+                    out(y, x, c) = static_cast<T>(std::lround(std::clamp(acc, 0.0f, 255.0f)));
+                }
+            }
+        }
+    }
+    return out;
+}
+
+template <typename T>
+static Image<T> makeRandomImage(int w, int h, int c, FastRandom &r) {
+    Image<T> img(w, h, c);
+    T* data = img.data();
+    for (size_t k = 0; k < img.stride_elements() * h; ++k) {
+        if constexpr (std::is_same_v<T, float>) {
+            data[k] = r.nextFloat() * 255.0f;
+        } else {
+            data[k] = static_cast<T>(r.nextInt(0, 255));
+        }
+    }
+    return img;
+}
+
+template <typename T>
+static void expectEqualImages(const Image<T>& a, const Image<T>& b) {
+    ASSERT_EQ(a.size(), b.size());
+    const size_t n = a.stride_elements() * a.height();
+    size_t mismatches = 0;
+    for (size_t k = 0; k < n; ++k) {
+        mismatches += (a.data()[k] != b.data()[k]);
+    }
+    EXPECT_EQ(mismatches, 0u);
+}
+
 } // namespace
 
 TEST(blur, colors_strength0_identity) {
@@ -146,3 +239,82 @@ TEST(blur, image_rgb_edge_smooths) {
     debug_io::dump_image(getUnitCaseDebugDir() + "00_src.png", src);
     debug_io::dump_image(getUnitCaseDebugDir() + "01_blur.png", dst);
 }
+
+TEST(blur, strip_matches_colors) {
+    configureWorkingDirectory();
+
+    const int n = 200;
+    std::vector<color8u> src;
+    for (int i = 0; i < n; ++i) {
+        src.emplace_back((uint8_t) (i * 7 % 256), (uint8_t) (i * i % 256), (uint8_t) (255 - i));
+    }
+    const color_strip8u strip(src);
+
+    for (float strength: {0.0f, 0.5f, 4.0f, 100.0f}) {
+        const std::vector<color8u> expected = blur(src, strength);
+        const color_strip8u dst = blur(strip, strength);
+        ASSERT_EQ(dst.length(), n);
+        for (int i = 0; i < n; ++i) {
+            EXPECT_EQ(dst.color(i), expected[i]);
+        }
+    }
+
+    debug_io::dump_image(getUnitCaseDebugDir() + "00_src_vs_dst.png", visualizeLines(src, blur(strip, 4.0f).toColors()));
+}
+
+TEST(blur, image_equals_reference_for_all_simd_levels) {
+    FastRandom r(239);
+    const std::vector<std::tuple<int, int, int>> sizes = {{1, 1, 1}, {7, 3, 3}, {40, 33, 1}, {61, 45, 3}, {5, 120, 3}};
+    for (auto [w, h, c]: sizes) {
+        image8u src8u = makeRandomImage<std::uint8_t>(w, h, c, r);
+        image32f src32f = makeRandomImage<float>(w, h, c, r);
+        for (float sigma: {0.3f, 1.0f, 2.5f, 7.0f}) {
+            image8u expected8u = referenceBlur(src8u, sigma);
+            image32f expected32f = referenceBlur(src32f, sigma);
+            for (SimdLevel level: {SimdLevel::Scalar, SimdLevel::SSE41, SimdLevel::AVX2}) {
+                SCOPED_TRACE(std::string(simdLevelName(supportedSimdLevel(level))) + " " + std::to_string(w) + "x" + std::to_string(h) + "x" + std::to_string(c) + " sigma=" + std::to_string(sigma));
+                expectEqualImages(blur(src8u, sigma, level), expected8u);
+                expectEqualImages(blur(src32f, sigma, level), expected32f);
+            }
+        }
+    }
+}
+
+// rounding of exact halves must be the same as std::lround (away from zero), not to even
+TEST(blur, image_u8_rounds_halves_as_lround) {
+    image8u src(64, 1, 1);
+    for (int x = 0; x < src.width(); ++x) {
+        src(0, x) = static_cast<std::uint8_t>(x % 2 == 0 ? 0 : 1);
+    }
+    for (SimdLevel level: {SimdLevel::Scalar, SimdLevel::SSE41, SimdLevel::AVX2}) {
+        expectEqualImages(blur(src, 0.5f, level), referenceBlur(src, 0.5f));
+    }
+}
+
+static void benchmarkBlur(int w, int h, const std::vector<float> &sigmas) {
+    FastRandom r(2391);
+    image8u src = makeRandomImage<std::uint8_t>(w, h, 3, r);
+    std::cout << "blur " << w << "x" << h << " RGB (" << simdLevelName(maxSimdLevel()) << "):" << std::endl;
+    for (float sigma: sigmas) {
+        Timer t;
+        image8u expected = referenceBlur(src, sigma);
+        const double reference_seconds = t.elapsed();
+        t.restart();
+        image8u blurred = blur(src, sigma);
+        const double seconds = t.elapsed();
+        std::cout << "  sigma=" << sigma << ": reference " << reference_seconds << " sec, vectorized " << seconds
+                  << " sec (x" << reference_seconds / seconds << ")" << std::endl;
+        expectEqualImages(blurred, expected);
+    }
+}
+
+TEST(blur, benchmark_small) {
+    benchmarkBlur(640, 480, {1.0f, 5.0f});
+}
+
+// 4K and 8K take a while with the reference implementation, run with --gtest_also_run_disabled_tests
+TEST(blur, DISABLED_benchmark_4k_8k) {
+    const std::vector<float> sigmas = {1.0f, 2.0f, 5.0f, 10.0f, 20.0f};
+    benchmarkBlur(3840, 2160, sigmas);
+    benchmarkBlur(7680, 4320, sigmas);
+}
@@ -0,0 +1,87 @@
+#include "color_difference.h"
+
+#include <libbase/runtime_assert.h>
+
+#include <cstdlib>
+
+#ifdef LIBBASE_X86_SIMD
+#include <immintrin.h>
+#endif
+
+namespace {
+
+void l1_scalar(const std::uint8_t *const *a, const std::uint8_t *const *b, int channels, int from, int n,
+               std::uint16_t *differences) {
+    for (int i = from; i < n; ++i) {
+        int d = 0;
+        for (int c = 0; c < channels; ++c) {
+            d += std::abs((int) a[c][i] - (int) b[c][i]);
+        }
+        differences[i] = static_cast<std::uint16_t>(d);
+    }
+}
+
+#ifdef LIBBASE_X86_SIMD
+
+__attribute__((target("sse4.1"))) void l1_sse41(const std::uint8_t *const *a, const std::uint8_t *const *b,
+                                                 int channels, int n, std::uint16_t *differences) {
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i lo = _mm_setzero_si128();
+        __m128i hi = _mm_setzero_si128();
+        for (int c = 0; c < channels; ++c) {
+            const __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a[c] + i));
+            const __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b[c] + i));
+            // |a - b| for unsigned bytes: one of saturated differences is zero
+            const __m128i d = _mm_or_si128(_mm_subs_epu8(va, vb), _mm_subs_epu8(vb, va));
+            lo = _mm_add_epi16(lo, _mm_cvtepu8_epi16(d));
+            hi = _mm_add_epi16(hi, _mm_cvtepu8_epi16(_mm_srli_si128(d, 8)));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(differences + i), lo);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(differences + i + 8), hi);
+    }
+    l1_scalar(a, b, channels, i, n, differences);
+}
+
+__attribute__((target("avx2"))) void l1_avx2(const std::uint8_t *const *a, const std::uint8_t *const *b,
+                                              int channels, int n, std::uint16_t *differences) {
+    int i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i lo = _mm256_setzero_si256();
+        __m256i hi = _mm256_setzero_si256();
+        for (int c = 0; c < channels; ++c) {
+            const __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a[c] + i));
+            const __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b[c] + i));
+            const __m256i d = _mm256_or_si256(_mm256_subs_epu8(va, vb), _mm256_subs_epu8(vb, va));
+            lo = _mm256_add_epi16(lo, _mm256_cvtepu8_epi16(_mm256_castsi256_si128(d)));
+            hi = _mm256_add_epi16(hi, _mm256_cvtepu8_epi16(_mm256_extracti128_si256(d, 1)));
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(differences + i), lo);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(differences + i + 16), hi);
+    }
+    l1_scalar(a, b, channels, i, n, differences);
+}
+
+#endif
+
+} // namespace
+
+void colorsL1Differences(const std::uint8_t *const *a, const std::uint8_t *const *b, int channels, int n,
+                         std::uint16_t *differences, SimdLevel level) {
+    rassert(channels >= 1 && channels <= 3, 5612309812301, channels);
+    rassert(n >= 0, 5612309812302, n);
+
+    switch (supportedSimdLevel(level)) {
+#ifdef LIBBASE_X86_SIMD
+    case SimdLevel::AVX2:
+        l1_avx2(a, b, channels, n, differences);
+        return;
+    case SimdLevel::SSE41:
+        l1_sse41(a, b, channels, n, differences);
+        return;
+#endif
+    default:
+        l1_scalar(a, b, channels, 0, n, differences);
+        return;
+    }
+}
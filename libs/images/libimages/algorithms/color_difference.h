@@ -0,0 +1,11 @@
+#pragma once
+
+#include <cstdint>
+
+#include <libbase/cpu_features.h>
+
+// differences[i] = sum over channels c of |a[c][i] - b[c][i]|, i in [0, n)
+// a[c] and b[c] are contiguous planes of channel c (f.e. ColorStrip::channel(c)), 1 <= channels <= 3.
+// Uses the strongest supported SIMD instructions up to level (see maxSimdLevel()), all levels give the same result.
+void colorsL1Differences(const std::uint8_t *const *a, const std::uint8_t *const *b, int channels, int n,
+                         std::uint16_t *differences, SimdLevel level = SimdLevel::AVX2);
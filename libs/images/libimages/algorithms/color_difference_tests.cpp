@@ -0,0 +1,44 @@
+#include "color_difference.h"
+
+#include <gtest/gtest.h>
+
+#include <libbase/fast_random.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+TEST(color_difference, allSimdLevelsEqualScalar) {
+    FastRandom r(239);
+    for (int channels = 1; channels <= 3; ++channels) {
+        for (int n: {0, 1, 15, 16, 17, 31, 32, 33, 100, 1000}) {
+            std::vector<std::uint8_t> a(3 * n), b(3 * n);
+            for (int k = 0; k < 3 * n; ++k) {
+                a[k] = (std::uint8_t) r.nextInt(0, 255);
+                b[k] = (std::uint8_t) r.nextInt(0, 255);
+            }
+            // extreme values - to check that nothing overflows
+            if (n > 0) {
+                a[0] = 255;
+                b[0] = 0;
+            }
+            const std::uint8_t *pa[3] = {a.data(), a.data() + n, a.data() + 2 * n};
+            const std::uint8_t *pb[3] = {b.data(), b.data() + n, b.data() + 2 * n};
+
+            std::vector<std::uint16_t> expected(n);
+            for (int i = 0; i < n; ++i) {
+                int d = 0;
+                for (int c = 0; c < channels; ++c) {
+                    d += std::abs((int) pa[c][i] - (int) pb[c][i]);
+                }
+                expected[i] = (std::uint16_t) d;
+            }
+
+            for (SimdLevel level: {SimdLevel::Scalar, SimdLevel::SSE41, SimdLevel::AVX2}) {
+                std::vector<std::uint16_t> differences(n, 12345);
+                colorsL1Differences(pa, pb, channels, n, differences.data(), level);
+                EXPECT_EQ(differences, expected) << simdLevelName(supportedSimdLevel(level)) << " n=" << n;
+            }
+        }
+    }
+}
@@ -0,0 +1,157 @@
+#include "connected_components.h"
+
+#include <libbase/disjoint_set.h>
+#include <libbase/runtime_assert.h>
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace {
+
+// First x >= from with pixel equal to value (or width if there is no such pixel)
+int findPixel(const std::uint64_t *row, int words, int width, int from, bool value) {
+    if (from >= width) return width;
+    int k = from / BinaryMask::WORD_BITS;
+    std::uint64_t bits = (value ? row[k] : ~row[k]) & (~std::uint64_t(0) << (from % BinaryMask::WORD_BITS));
+    while (bits == 0) {
+        if (++k == words) return width;
+        bits = value ? row[k] : ~row[k];
+    }
+    return std::min(width, k * BinaryMask::WORD_BITS + std::countr_zero(bits));
+}
+
+void appendRowRuns(const BinaryMask &mask, int y, std::vector<PixelRun> &runs) {
+    const std::uint64_t *row = mask.row(y);
+    const int words = mask.words_per_row();
+    const int w = mask.width();
+    int x = 0;
+    while (true) {
+        const int x0 = findPixel(row, words, w, x, true);
+        if (x0 == w) break;
+        const int x1 = findPixel(row, words, w, x0, false);
+        runs.push_back({y, x0, x1});
+        x = x1;
+    }
+}
+
+// Runs [a0, a1) and [b0, b1) of neighbouring rows are 8-connected iff a0 <= b1 && b0 <= a1
+void uniteRows(const std::vector<PixelRun> &runs, std::size_t prev_begin, std::size_t row_begin, std::size_t row_end,
+               ConcurrentDisjointSetUnion &dsu) {
+    std::size_t p = prev_begin;
+    for (std::size_t c = row_begin; c < row_end; ++c) {
+        // skip previous row runs that end too far to the left (they can't touch next runs of this row either)
+        while (p < row_begin && runs[p].x1 < runs[c].x0) ++p;
+        for (std::size_t q = p; q < row_begin && runs[q].x0 <= runs[c].x1; ++q) {
+            dsu.unite(c, q);
+        }
+    }
+}
+
+} // namespace
+
+ConnectedComponents labelConnectedComponents(const BinaryMask &mask, bool with_openmp, int strips) {
+    rassert(strips >= 0, 7812390128402, strips);
+    const int h = mask.height();
+
+    if (strips == 0) {
+        strips = 1;
+#ifdef _OPENMP
+        if (with_openmp) strips = omp_get_max_threads();
+#endif
+    }
+    strips = std::max(1, std::min(strips, h));
+    // strip s has rows [strip_begin[s], strip_begin[s + 1])
+    std::vector<int> strip_begin(strips + 1);
+    for (int s = 0; s <= strips; ++s) {
+        strip_begin[s] = static_cast<int>(static_cast<long long>(h) * s / strips);
+    }
+
+    // 1) runs of each strip are found independently, then concatenated in raster order
+    std::vector<std::vector<PixelRun>> strip_runs(strips);
+    #pragma omp parallel for schedule(dynamic) if(with_openmp)
+    for (int s = 0; s < strips; ++s) {
+        for (int y = strip_begin[s]; y < strip_begin[s + 1]; ++y) {
+            appendRowRuns(mask, y, strip_runs[s]);
+        }
+    }
+    std::vector<std::size_t> strip_first_run(strips + 1, 0);
+    for (int s = 0; s < strips; ++s) {
+        strip_first_run[s + 1] = strip_first_run[s] + strip_runs[s].size();
+    }
+
+    ConnectedComponents result;
+    const std::size_t n = strip_first_run[strips];
+    result.runs.resize(n);
+    #pragma omp parallel for if(with_openmp)
+    for (int s = 0; s < strips; ++s) {
+        std::copy(strip_runs[s].begin(), strip_runs[s].end(), result.runs.begin() + strip_first_run[s]);
+    }
+    strip_runs.clear();
+
+    const std::vector<PixelRun> &runs = result.runs;
+    std::vector<std::size_t> row_begin(h + 1, n);
+    for (std::size_t k = n; k-- > 0;) {
+        row_begin[runs[k].y] = k;
+    }
+    for (int y = h - 1; y >= 0; --y) {
+        row_begin[y] = std::min(row_begin[y], row_begin[y + 1]);
+    }
+
+    // 2) rows inside of each strip are united in parallel, 3) then rows across strip boundaries are merged.
+    // Union-find links by run index, so roots (the first run of each component) don't depend on threads.
+    ConcurrentDisjointSetUnion dsu(n);
+    #pragma omp parallel for schedule(dynamic) if(with_openmp)
+    for (int s = 0; s < strips; ++s) {
+        for (int y = strip_begin[s] + 1; y < strip_begin[s + 1]; ++y) {
+            uniteRows(runs, row_begin[y - 1], row_begin[y], row_begin[y + 1], dsu);
+        }
+    }
+    #pragma omp parallel for if(with_openmp)
+    for (int s = 1; s < strips; ++s) {
+        const int y = strip_begin[s];
+        uniteRows(runs, row_begin[y - 1], row_begin[y], row_begin[y + 1], dsu);
+    }
+
+    std::vector<std::size_t> root_of_run(n);
+    #pragma omp parallel for if(with_openmp)
+    for (std::ptrdiff_t k = 0; k < static_cast<std::ptrdiff_t>(n); ++k) {
+        root_of_run[k] = dsu.find(k);
+    }
+
+    // Bbox of each root, roots are collected in order of their first runs
+    std::vector<std::size_t> roots;
+    std::vector<bbox2i> root_boxes(n);
+    for (std::size_t k = 0; k < n; ++k) {
+        const std::size_t r = root_of_run[k];
+        if (r == k) roots.push_back(r); // root is the first run of the component
+        root_boxes[r].include_pixel(runs[k].x0, runs[k].y);
+        root_boxes[r].include_pixel(runs[k].x1 - 1, runs[k].y);
+    }
+
+    // Deterministic order: by bbox top-left (y, then x), roots are already in raster order of their first pixels
+    std::stable_sort(roots.begin(), roots.end(), [&](std::size_t a, std::size_t b) {
+        const bbox2i &A = root_boxes[a];
+        const bbox2i &B = root_boxes[b];
+        if (A.min.y != B.min.y) return A.min.y < B.min.y;
+        return A.min.x < B.min.x;
+    });
+
+    std::vector<int> label_of_root(n, -1);
+    result.boxes.reserve(roots.size());
+    for (std::size_t i = 0; i < roots.size(); ++i) {
+        label_of_root[roots[i]] = static_cast<int>(i);
+        result.boxes.push_back(root_boxes[roots[i]]);
+    }
+    result.run_labels.resize(n);
+    #pragma omp parallel for if(with_openmp)
+    for (std::ptrdiff_t k = 0; k < static_cast<std::ptrdiff_t>(n); ++k) {
+        result.run_labels[k] = label_of_root[root_of_run[k]];
+    }
+    return result;
+}
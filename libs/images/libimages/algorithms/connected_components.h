@@ -0,0 +1,30 @@
+#pragma once
+
+#include <vector>
+
+#include <libbase/bbox2.h>
+#include <libimages/binary_mask.h>
+
+// Horizontal run of object pixels [x0, x1) in row y
+struct PixelRun final {
+    int y = 0;
+    int x0 = 0;
+    int x1 = 0;
+};
+
+// 8-connected components of a mask, described by runs (not per pixel - so memory is proportional to the number of runs)
+struct ConnectedComponents final {
+    std::vector<PixelRun> runs;  // all runs of the mask in raster order (y, then x)
+    std::vector<int> run_labels; // component of each run
+    std::vector<bbox2i> boxes;   // bbox of each component
+
+    int count() const noexcept { return static_cast<int>(boxes.size()); }
+};
+
+// Run-based labeling: runs of each row are found with word scans of the bit-packed mask, runs are united with
+// overlapping (8-connected) runs of the previous row. Components are sorted by bbox top-left (y, then x),
+// ties are resolved by the first pixel of a component in raster order.
+//
+// Rows are split into horizontal strips (strips == 0 - one per OpenMP thread) that are labeled in parallel,
+// then strip boundaries are merged with a concurrent union-find. Result doesn't depend on the number of strips/threads.
+ConnectedComponents labelConnectedComponents(const BinaryMask &mask, bool with_openmp = true, int strips = 0);
@@ -0,0 +1,145 @@
+#include "connected_components.h"
+
+#include <gtest/gtest.h>
+
+#include <libbase/fast_random.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace {
+
+BinaryMask makeRandomMask(int w, int h, int white_percent, uint32_t seed) {
+    FastRandom r(seed);
+    BinaryMask mask(w, h);
+    for (int j = 0; j < h; ++j)
+        for (int i = 0; i < w; ++i)
+            mask.set(j, i, r.nextInt(0, 99) < white_percent);
+    return mask;
+}
+
+// Label of each pixel (-1 for background) built from runs
+std::vector<int> labelsFromRuns(const ConnectedComponents &components, int w, int h) {
+    std::vector<int> labels((size_t) w * h, -1);
+    for (size_t k = 0; k < components.runs.size(); ++k) {
+        const PixelRun &run = components.runs[k];
+        for (int x = run.x0; x < run.x1; ++x) {
+            labels[(size_t) run.y * w + x] = components.run_labels[k];
+        }
+    }
+    return labels;
+}
+
+// Straightforward flood fill (8-connectivity) with components ordered by bbox top-left and then by the first pixel
+std::vector<int> referenceLabels(const BinaryMask &mask, std::vector<bbox2i> &boxes) {
+    const int w = mask.width();
+    const int h = mask.height();
+    std::vector<int> labels((size_t) w * h, -1);
+    boxes.clear();
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            if (!mask(y, x) || labels[(size_t) y * w + x] != -1) continue;
+            const int label = (int) boxes.size();
+            boxes.push_back(bbox2i::make_empty());
+            std::vector<point2i> stack = {{x, y}};
+            labels[(size_t) y * w + x] = label;
+            while (!stack.empty()) {
+                const point2i p = stack.back();
+                stack.pop_back();
+                boxes[label].include_pixel(p.x, p.y);
+                for (int dy = -1; dy <= 1; ++dy) {
+                    for (int dx = -1; dx <= 1; ++dx) {
+                        const int nx = p.x + dx;
+                        const int ny = p.y + dy;
+                        if (nx < 0 || nx >= w || ny < 0 || ny >= h || !mask(ny, nx)) continue;
+                        if (labels[(size_t) ny * w + nx] != -1) continue;
+                        labels[(size_t) ny * w + nx] = label;
+                        stack.push_back({nx, ny});
+                    }
+                }
+            }
+        }
+    }
+
+    std::vector<int> order(boxes.size());
+    for (size_t i = 0; i < order.size(); ++i) order[i] = (int) i;
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+        if (boxes[a].min.y != boxes[b].min.y) return boxes[a].min.y < boxes[b].min.y;
+        return boxes[a].min.x < boxes[b].min.x;
+    });
+    std::vector<int> new_label(order.size());
+    std::vector<bbox2i> sorted_boxes;
+    for (size_t i = 0; i < order.size(); ++i) {
+        new_label[order[i]] = (int) i;
+        sorted_boxes.push_back(boxes[order[i]]);
+    }
+    for (int &label : labels) {
+        if (label != -1) label = new_label[label];
+    }
+    boxes = sorted_boxes;
+    return labels;
+}
+
+} // namespace
+
+TEST(connected_components, equalsFloodFill) {
+    const int sizes[][2] = {{1, 1}, {63, 5}, {64, 64}, {130, 77}, {5, 200}};
+    uint32_t seed = 239;
+    for (const auto &size : sizes) {
+        for (int white_percent : {5, 30, 50, 70, 100}) {
+            SCOPED_TRACE(std::to_string(size[0]) + "x" + std::to_string(size[1]) + " white=" + std::to_string(white_percent));
+            const BinaryMask mask = makeRandomMask(size[0], size[1], white_percent, seed++);
+            const ConnectedComponents components = labelConnectedComponents(mask, true, 3);
+
+            std::vector<bbox2i> expected_boxes;
+            const std::vector<int> expected = referenceLabels(mask, expected_boxes);
+            ASSERT_EQ(components.count(), (int) expected_boxes.size());
+            for (int i = 0; i < components.count(); ++i) {
+                EXPECT_EQ(components.boxes[i].min, expected_boxes[i].min);
+                EXPECT_EQ(components.boxes[i].max, expected_boxes[i].max);
+            }
+            EXPECT_EQ(labelsFromRuns(components, size[0], size[1]), expected);
+        }
+    }
+}
+
+TEST(connected_components, stripsDontChangeResult) {
+    const BinaryMask mask = makeRandomMask(150, 203, 55, 2391);
+    const ConnectedComponents expected = labelConnectedComponents(mask, false, 1);
+    for (int strips : {2, 3, 7, 64, 203, 1000}) {
+        for (bool with_openmp : {false, true}) {
+            SCOPED_TRACE("strips=" + std::to_string(strips));
+            const ConnectedComponents components = labelConnectedComponents(mask, with_openmp, strips);
+            ASSERT_EQ(components.count(), expected.count());
+            for (int i = 0; i < components.count(); ++i) {
+                EXPECT_EQ(components.boxes[i].min, expected.boxes[i].min);
+                EXPECT_EQ(components.boxes[i].max, expected.boxes[i].max);
+            }
+            EXPECT_EQ(labelsFromRuns(components, 150, 203), labelsFromRuns(expected, 150, 203));
+        }
+    }
+}
+
+TEST(connected_components, diagonalNeighboursAreConnected) {
+    BinaryMask mask(6, 4);
+    mask.set(0, 0, true);
+    mask.set(1, 1, true);
+    mask.set(2, 0, true);
+    mask.set(0, 5, true); // separate component, its bbox top-left is to the right of the first one
+    mask.set(3, 3, true); // not connected: (2, 2) is empty
+
+    const ConnectedComponents components = labelConnectedComponents(mask);
+    ASSERT_EQ(components.count(), 3);
+    EXPECT_EQ(components.boxes[0].min, point2i(0, 0));
+    EXPECT_EQ(components.boxes[0].max, point2i(2, 3));
+    EXPECT_EQ(components.boxes[1].min, point2i(5, 0));
+    EXPECT_EQ(components.boxes[2].min, point2i(3, 3));
+    ASSERT_EQ(components.runs.size(), 5);
+}
+
+TEST(connected_components, empty) {
+    EXPECT_EQ(labelConnectedComponents(BinaryMask(10, 10)).count(), 0);
+    EXPECT_EQ(labelConnectedComponents(BinaryMask()).count(), 0);
+}
@@ -6,8 +6,13 @@
 #include <algorithm>
 #include <cmath>
 #include <cstdint>
+#include <type_traits>
 #include <vector>
 
+#ifdef LIBBASE_X86_SIMD
+#include <immintrin.h>
+#endif
+
 namespace {
 
 inline int clampi(int v, int lo, int hi) noexcept {
@@ -27,6 +32,81 @@ inline int safe_mid_index(int m) {
     return (m <= 0) ? 0 : (m / 2);
 }
 
+// --------------------- SIMD kernels of downsample2x ---------------------
+// Vertical pass: sum[k] = a[k] + b[k] for k in [from, n), 8-bit values are summed into 16-bit ones.
+// All levels give bit-identical results.
+
+template <typename T>
+using RowSum = std::conditional_t<std::is_same_v<T, std::uint8_t>, std::uint16_t, float>;
+
+template <typename T>
+void sum_rows_scalar(const T* a, const T* b, int from, int n, RowSum<T>* sum) {
+    for (int k = from; k < n; ++k) {
+        sum[k] = static_cast<RowSum<T>>(a[k] + b[k]);
+    }
+}
+
+#ifdef LIBBASE_X86_SIMD
+
+__attribute__((target("sse4.1")))
+void sum_rows_sse41(const std::uint8_t* a, const std::uint8_t* b, int n, std::uint16_t* sum) {
+    int k = 0;
+    for (; k + 8 <= n; k += 8) {
+        const __m128i va = _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(a + k)));
+        const __m128i vb = _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(b + k)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(sum + k), _mm_add_epi16(va, vb));
+    }
+    sum_rows_scalar(a, b, k, n, sum);
+}
+
+__attribute__((target("sse4.1")))
+void sum_rows_sse41(const float* a, const float* b, int n, float* sum) {
+    int k = 0;
+    for (; k + 4 <= n; k += 4) {
+        _mm_storeu_ps(sum + k, _mm_add_ps(_mm_loadu_ps(a + k), _mm_loadu_ps(b + k)));
+    }
+    sum_rows_scalar(a, b, k, n, sum);
+}
+
+__attribute__((target("avx2")))
+void sum_rows_avx2(const std::uint8_t* a, const std::uint8_t* b, int n, std::uint16_t* sum) {
+    int k = 0;
+    for (; k + 16 <= n; k += 16) {
+        const __m256i va = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + k)));
+        const __m256i vb = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(b + k)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(sum + k), _mm256_add_epi16(va, vb));
+    }
+    sum_rows_scalar(a, b, k, n, sum);
+}
+
+__attribute__((target("avx2")))
+void sum_rows_avx2(const float* a, const float* b, int n, float* sum) {
+    int k = 0;
+    for (; k + 8 <= n; k += 8) {
+        _mm256_storeu_ps(sum + k, _mm256_add_ps(_mm256_loadu_ps(a + k), _mm256_loadu_ps(b + k)));
+    }
+    sum_rows_scalar(a, b, k, n, sum);
+}
+
+#endif
+
+template <typename T>
+void sum_rows(SimdLevel level, const T* a, const T* b, int n, RowSum<T>* sum) {
+    switch (level) {
+#ifdef LIBBASE_X86_SIMD
+    case SimdLevel::AVX2:
+        sum_rows_avx2(a, b, n, sum);
+        return;
+    case SimdLevel::SSE41:
+        sum_rows_sse41(a, b, n, sum);
+        return;
+#endif
+    default:
+        sum_rows_scalar(a, b, 0, n, sum);
+        return;
+    }
+}
+
 } // namespace
 
 template <typename T>
@@ -39,23 +119,26 @@ Image<T> downsample(const Image<T> &image, int w, int h) {
     rassert(srcW > 0 && srcH > 0, 781234982);
     rassert(ch == 1 || ch == 3, 781234983, ch);
 
-    Image<T> out(w, h, ch);
+    Image<T> out(w, h, ch, ImageInit::Uninitialized);
 
     // Handle degenerate mappings (target size 1) by sampling center in that axis.
     const int sx_center = safe_mid_index<T>(srcW);
     const int sy_center = safe_mid_index<T>(srcH);
 
+    // source offset of each output column is the same for all rows - map them once
+    std::vector<std::size_t> srcOffsets(static_cast<std::size_t>(w));
+    for (int x = 0; x < w; ++x) {
+        const int sx = (w == 1) ? sx_center : map_index_round(x, w, srcW);
+        srcOffsets[x] = static_cast<std::size_t>(sx) * ch;
+    }
+
     for (int y = 0; y < h; ++y) {
         const int sy = (h == 1) ? sy_center : map_index_round(y, h, srcH);
+        const T* src = image.row(sy);
+        T* dst = out.row(y);
         for (int x = 0; x < w; ++x) {
-            const int sx = (w == 1) ? sx_center : map_index_round(x, w, srcW);
-
-            if (ch == 1) {
-                out(y, x) = image(sy, sx);
-            } else {
-                out(y, x, 0) = image(sy, sx, 0);
-                out(y, x, 1) = image(sy, sx, 1);
-                out(y, x, 2) = image(sy, sx, 2);
+            for (int c = 0; c < ch; ++c) {
+                dst[static_cast<std::size_t>(x) * ch + c] = src[srcOffsets[x] + c];
             }
         }
     }
@@ -63,6 +146,119 @@ Image<T> downsample(const Image<T> &image, int w, int h) {
     return out;
 }
 
+template <typename T>
+Image<T> downsample2x(ImageView<const T> image, SimdLevel level) {
+    const int srcW = image.width();
+    const int srcH = image.height();
+    const int ch = image.channels();
+    rassert(srcW > 0 && srcH > 0, 781234986, srcW, srcH);
+    const int w = (srcW + 1) / 2;
+    const int h = (srcH + 1) / 2;
+    const int srcRowSize = srcW * ch;
+    level = supportedSimdLevel(level);
+
+    Image<T> out(w, h, ch, ImageInit::Uninitialized);
+    #pragma omp parallel
+    {
+        std::vector<RowSum<T>> sums(static_cast<std::size_t>(srcRowSize));
+        #pragma omp for
+        for (int y = 0; y < h; ++y) {
+            // the last row/column of an odd-sized image is paired with itself, so every block is 2x2
+            const T* a = image.row(2 * y);
+            const T* b = image.row(std::min(2 * y + 1, srcH - 1));
+            sum_rows(level, a, b, srcRowSize, sums.data());
+
+            T* dst = out.row(y);
+            for (int x = 0; x < w; ++x) {
+                const RowSum<T>* left = sums.data() + static_cast<std::size_t>(2 * x) * ch;
+                const RowSum<T>* right = (2 * x + 1 < srcW) ? left + ch : left;
+                for (int c = 0; c < ch; ++c) {
+                    if constexpr (std::is_same_v<T, std::uint8_t>) {
+                        dst[static_cast<std::size_t>(x) * ch + c] = static_cast<std::uint8_t>((left[c] + right[c] + 2) >> 2);
+                    } else {
+                        dst[static_cast<std::size_t>(x) * ch + c] = (left[c] + right[c]) * 0.25f;
+                    }
+                }
+            }
+        }
+    }
+    return out;
+}
+
+image8u downsample_box(image8u_view image, int factor) {
+    rassert(factor >= 1, 781234985, factor);
+    const int srcW = image.width();
+    const int srcH = image.height();
+    const int ch = image.channels();
+    const int w = (srcW + factor - 1) / factor;
+    const int h = (srcH + factor - 1) / factor;
+
+    image8u out(w, h, ch, ImageInit::Uninitialized);
+    #pragma omp parallel
+    {
+        std::vector<std::uint32_t> sums(static_cast<std::size_t>(w) * ch);
+        #pragma omp for
+        for (int y = 0; y < h; ++y) {
+            std::fill(sums.begin(), sums.end(), 0);
+            const int sy0 = y * factor;
+            const int sy1 = std::min(srcH, sy0 + factor);
+            for (int sy = sy0; sy < sy1; ++sy) {
+                const std::uint8_t *src = image.row(sy);
+                for (int sx = 0; sx < srcW; ++sx) {
+                    std::uint32_t *sum = sums.data() + static_cast<std::size_t>(sx / factor) * ch;
+                    for (int c = 0; c < ch; ++c) {
+                        sum[c] += src[sx * ch + c];
+                    }
+                }
+            }
+            std::uint8_t *dst = out.row(y);
+            for (int x = 0; x < w; ++x) {
+                const std::uint32_t count = static_cast<std::uint32_t>((sy1 - sy0) * (std::min(srcW, (x + 1) * factor) - x * factor));
+                for (int c = 0; c < ch; ++c) {
+                    dst[x * ch + c] = static_cast<std::uint8_t>((sums[static_cast<std::size_t>(x) * ch + c] + count / 2) / count);
+                }
+            }
+        }
+    }
+    return out;
+}
+
+int downsampledIndex(int i, int n, int m) {
+    rassert(i >= 0 && i < n && n > 0 && m > 0, 781234984, i, n, m);
+    if (n >= m) return i;
+    if (n == 1) return m / 2;
+    return map_index_round(i, n, m);
+}
+
+template <typename T>
+ColorStrip<T> downsample(const ColorStrip<T> &colors, int n) {
+    if (n <= 0) return {};
+    if (colors.empty()) return {};
+
+    const int m = colors.length();
+    if (n >= m) return colors;
+
+    const int C = colors.channels();
+    ColorStrip<T> out(n, C);
+
+    if (n == 1) {
+        for (int c = 0; c < C; ++c) {
+            out.channel(c)[0] = colors.channel(c)[m / 2];
+        }
+        return out;
+    }
+
+    for (int c = 0; c < C; ++c) {
+        const T* src = colors.channel(c);
+        T* dst = out.channel(c);
+        for (int i = 0; i < n; ++i) {
+            dst[i] = src[map_index_round(i, n, m)];
+        }
+    }
+
+    return out;
+}
+
 template <typename T>
 std::vector<Color<T>> downsample(const std::vector<Color<T>> &colors, int n) {
     if (n <= 0) return {};
@@ -92,5 +288,11 @@ template Image<std::uint8_t> downsample(const Image<std::uint8_t>& image, int w,
 template Image<float>        downsample(const Image<float>& image, int w, int h);
 template Image<int>          downsample(const Image<int>& image, int w, int h);
 
+template Image<std::uint8_t> downsample2x(ImageView<const std::uint8_t> image, SimdLevel level);
+template Image<float>        downsample2x(ImageView<const float> image, SimdLevel level);
+
+template ColorStrip<std::uint8_t> downsample(const ColorStrip<std::uint8_t>& colors, int n);
+template ColorStrip<float>        downsample(const ColorStrip<float>& colors, int n);
+
 template std::vector<Color<std::uint8_t>> downsample(const std::vector<Color<std::uint8_t>>& colors, int n);
 template std::vector<Color<float>>        downsample(const std::vector<Color<float>>& colors, int n);
@@ -2,11 +2,30 @@
 
 #include <vector>
 
+#include <libbase/cpu_features.h>
 #include <libimages/color.h>
+#include <libimages/color_strip.h>
 #include <libimages/image.h>
 
 template <typename T>
 Image<T> downsample(const Image<T> &image, int w, int h);
 
+// Box filter (area averaging) by an integer factor: each output pixel is the rounded average of a factor x factor block.
+// Output is ceil(w / factor) x ceil(h / factor), blocks at the right and bottom borders can be smaller.
+image8u downsample_box(image8u_view image, int factor);
+
+// One pyramid step: ceil(w / 2) x ceil(h / 2) image of 2x2 block averages (8-bit values are rounded,
+// the last row/column of an odd-sized image is averaged with itself). For 8-bit images it is the same as downsample_box(image, 2).
+// Rows are summed with the strongest supported SIMD instructions up to level - all levels give the same result.
+template <typename T>
+Image<T> downsample2x(ImageView<const T> image, SimdLevel level = SimdLevel::AVX2);
+
+template <typename T>
+ColorStrip<T> downsample(const ColorStrip<T> &colors, int n);
+
+// Index of the source color which downsample(colors, n) takes as i-th, where m = colors.length()
+// (lets callers compare downsampled sequences without materializing them)
+int downsampledIndex(int i, int n, int m);
+
 template <typename T>
 std::vector<Color<T>> downsample(const std::vector<Color<T>> &colors, int n);
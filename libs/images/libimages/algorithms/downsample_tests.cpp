@@ -4,6 +4,7 @@
 #include <gtest/gtest.h>
 
 #include <libbase/configure_working_directory.h>
+#include <libbase/fast_random.h>
 #include <libimages/debug_io.h>
 #include <libimages/image.h>
 #include <libimages/tests_utils.h>
@@ -241,3 +242,53 @@ TEST(downsample, image_rgb_preserves_channels) {
     debug_io::dump_image(getUnitCaseDebugDir() + "00_src.png", src);
     debug_io::dump_image(getUnitCaseDebugDir() + "01_ds_2x2.png", ds);
 }
+
+TEST(downsample, strip_matches_colors) {
+    configureWorkingDirectory();
+
+    const int m = 37;
+    auto src = makeRedGradient(m);
+    const color_strip8u strip(src);
+
+    for (int n: {1, 2, 5, 36, 37, 50}) {
+        const std::vector<color8u> expected = downsample(src, n);
+        const color_strip8u ds = downsample(strip, n);
+        ASSERT_EQ(ds.length(), (int) expected.size());
+        for (int i = 0; i < ds.length(); ++i) {
+            EXPECT_EQ(ds.color(i), expected[i]);
+        }
+    }
+
+    debug_io::dump_image(getUnitCaseDebugDir() + "00_colors_src_vs_ds.png",
+                         visualizeColorDownsample(src, downsample(strip, 5).toColors()));
+}
+
+TEST(downsample, box_averages_blocks) {
+    FastRandom r(239);
+    for (int factor : {1, 2, 3, 4, 8}) {
+        image8u src(13, 10, 3);
+        for (int y = 0; y < src.height(); ++y)
+            for (int x = 0; x < src.width(); ++x)
+                for (int c = 0; c < 3; ++c)
+                    src(y, x, c) = static_cast<uint8_t>(r.nextInt(0, 255));
+
+        const image8u ds = downsample_box(src, factor);
+        ASSERT_EQ(ds.width(), (13 + factor - 1) / factor);
+        ASSERT_EQ(ds.height(), (10 + factor - 1) / factor);
+        for (int y = 0; y < ds.height(); ++y) {
+            for (int x = 0; x < ds.width(); ++x) {
+                for (int c = 0; c < 3; ++c) {
+                    int sum = 0;
+                    int count = 0;
+                    for (int sy = y * factor; sy < std::min(10, (y + 1) * factor); ++sy) {
+                        for (int sx = x * factor; sx < std::min(13, (x + 1) * factor); ++sx) {
+                            sum += src(sy, sx, c);
+                            ++count;
+                        }
+                    }
+                    EXPECT_EQ(ds(y, x, c), (sum + count / 2) / count);
+                }
+            }
+        }
+    }
+}
@@ -1,10 +1,12 @@
 #include "extract_contour.h"
 
 #include <libbase/runtime_assert.h>
+#include <libimages/algorithms/morphology.h>
 
 #include <algorithm>
 #include <cstddef>
 #include <limits>
+#include <vector>
 
 namespace {
 
@@ -14,9 +16,9 @@ inline bool inBounds(int x, int y, int w, int h) noexcept {
     return x >= 0 && x < w && y >= 0 && y < h;
 }
 
-inline bool isFg(const image8u& m, int x, int y) noexcept {
+inline bool isFg(image8u_view m, int x, int y) noexcept {
     if (!inBounds(x, y, m.width(), m.height())) return false;
-    return m(y, x) == kFg;
+    return m.at_unchecked(y, x) == kFg;
 }
 
 // Clockwise neighbor order in image coordinates (y down):
@@ -37,6 +39,17 @@ inline int dirFromDelta(int dx, int dy) {
     return -1;
 }
 
+inline double signedArea2_imageCoords(const std::vector<point2f>& poly) {
+    double a2 = 0.0;
+    const int n = static_cast<int>(poly.size());
+    for (int i = 0; i < n; ++i) {
+        const auto& p = poly[i];
+        const auto& q = poly[(i + 1) % n];
+        a2 += static_cast<double>(p.x) * q.y - static_cast<double>(q.x) * p.y;
+    }
+    return a2;
+}
+
 inline long long signedArea2_imageCoords(const std::vector<point2i>& poly) {
     if (poly.size() < 3) return 0;
     long long a2 = 0;
@@ -51,7 +64,8 @@ inline long long signedArea2_imageCoords(const std::vector<point2i>& poly) {
     return a2;
 }
 
-inline void rotateToMinYX(std::vector<point2i>& pts) {
+template <typename T>
+inline void rotateToMinYX(std::vector<point2<T>>& pts) {
     if (pts.empty()) return;
     int best = 0;
     for (int i = 1; i < static_cast<int>(pts.size()); ++i) {
@@ -62,9 +76,78 @@ inline void rotateToMinYX(std::vector<point2i>& pts) {
     std::rotate(pts.begin(), pts.begin() + best, pts.end());
 }
 
+// Moore neighbor tracing (8-connected) from start - the top-most, then left-most pixel of isFg(x, y),
+// using clockwise neighbor order. Backtrack starts at west of start (can be out of bounds; still treated as direction W).
+// The result is clockwise (image coords) and starts at min (y, x).
+template <typename IsFg>
+std::vector<point2i> mooreTrace(point2i start, int w, int h, IsFg isFg) {
+    // Degenerate: single pixel contour.
+    bool hasNeighbor = false;
+    for (int k = 0; k < 8; ++k) {
+        if (isFg(start.x + dx8[k], start.y + dy8[k])) {
+            hasNeighbor = true;
+            break;
+        }
+    }
+    if (!hasNeighbor) return {start};
+
+    // Finds the next contour pixel after p, dirBack is the direction from p to the backtrack pixel,
+    // the new backtrack pixel is the neighbor preceding the found one in clockwise order
+    auto step = [&](point2i p, int &dirBack) -> point2i {
+        const int startDir = (dirBack + 1) & 7;
+        for (int t = 0; t < 8; ++t) {
+            const int d = (startDir + t) & 7;
+            const int nx = p.x + dx8[d];
+            const int ny = p.y + dy8[d];
+            if (isFg(nx, ny)) {
+                const int prevd = (d + 7) & 7;
+                dirBack = dirFromDelta(dx8[prevd] - dx8[d], dy8[prevd] - dy8[d]);
+                return {nx, ny};
+            }
+        }
+        // Should not happen for a valid single contour
+        return p;
+    };
+
+    std::vector<point2i> contour;
+    contour.reserve(static_cast<std::size_t>(w) * static_cast<std::size_t>(h) / 4);
+
+    const point2i p0 = start;
+    contour.push_back(p0);
+
+    int dirBack = 4; // W by construction
+    const point2i p1 = step(p0, dirBack);
+    if (p1 == p0) return contour;
+
+    contour.push_back(p1);
+
+    point2i cur = p1;
+    const std::size_t safetyLimit = static_cast<std::size_t>(w) * static_cast<std::size_t>(h) + 8;
+
+    while (contour.size() < safetyLimit) {
+        const point2i nxt = step(cur, dirBack);
+
+        // Closed the loop: do not append start again.
+        if (nxt == p0) break;
+
+        contour.push_back(nxt);
+        cur = nxt;
+    }
+
+    // Enforce clockwise orientation in image coords.
+    if (signedArea2_imageCoords(contour) < 0) {
+        std::reverse(contour.begin(), contour.end());
+    }
+
+    // Deterministic start: rotate to min (y, x).
+    rotateToMinYX(contour);
+
+    return contour;
+}
+
 } // namespace
 
-image8u buildContourMask(const image8u &objectMask) {
+image8u buildContourMask(image8u_view objectMask) {
     rassert(objectMask.channels() == 1, 918273645);
 
     const int w = objectMask.width();
@@ -80,26 +163,32 @@ image8u buildContourMask(const image8u &objectMask) {
     // а вот если среди соседей есть и те и те - то мы на границе!
     // и в таком случае надо сохранить в нашем пикселе в contour(j, i) число 255
     for (int y = 0; y < h; ++y) {
+        const unsigned char *row = objectMask.row(y);
+        unsigned char *dst = contour.row(y);
         for (int x = 0; x < w; ++x) {
-            if (objectMask(y, x) != kFg) continue;
+            if (row[x] != kFg) continue;
 
             bool isBoundary = false;
             for (int k = 0; k < 8; ++k) {
                 const int nx = x + dx8[k];
                 const int ny = y + dy8[k];
-                if (!inBounds(nx, ny, w, h) || objectMask(ny, nx) != kFg) {
+                if (!inBounds(nx, ny, w, h) || objectMask.at_unchecked(ny, nx) != kFg) {
                     isBoundary = true;
                     break;
                 }
             }
-            if (isBoundary) contour(y, x) = kFg;
+            if (isBoundary) dst[x] = kFg;
         }
     }
 
     return contour;
 }
 
-std::vector<point2i> extractContour(const image8u &objectContourMask) {
+BinaryMask buildContourMask(const BinaryMask &objectMask) {
+    return objectMask & ~morphology::erode(objectMask, 1, false);
+}
+
+std::vector<point2i> extractContour(image8u_view objectContourMask) {
     rassert(objectContourMask.channels() == 1, 918273646);
 
     const int w = objectContourMask.width();
@@ -108,8 +197,9 @@ std::vector<point2i> extractContour(const image8u &objectContourMask) {
     // Find start: top-most, then left-most contour pixel.
     point2i start{-1, -1};
     for (int y = 0; y < h && start.x < 0; ++y) {
+        const unsigned char *row = objectContourMask.row(y);
         for (int x = 0; x < w; ++x) {
-            if (objectContourMask(y, x) == kFg) {
+            if (row[x] == kFg) {
                 start = {x, y};
                 break;
             }
@@ -117,79 +207,155 @@ std::vector<point2i> extractContour(const image8u &objectContourMask) {
     }
     if (start.x < 0) return {};
 
-    // Degenerate: single pixel contour.
-    bool hasNeighbor = false;
-    for (int k = 0; k < 8; ++k) {
-        if (isFg(objectContourMask, start.x + dx8[k], start.y + dy8[k])) {
-            hasNeighbor = true;
-            break;
-        }
-    }
-    if (!hasNeighbor) return {start};
-
-    // Moore neighbor tracing (8-connected), using clockwise neighbor order.
-    // backtrack starts at west of start (can be out-of-bounds; still treated as direction W).
-    point2i p0 = start;
-    point2i b = {p0.x - 1, p0.y}; // west
-    int dir_b = 4;                // W by construction
-
-    auto step = [&](const point2i& p, const point2i& back) -> std::pair<point2i, point2i> {
-        const int db = dirFromDelta(back.x - p.x, back.y - p.y);
-        const int dirBack = (db >= 0) ? db : dir_b;
+    std::vector<point2i> contour = mooreTrace(start, w, h, [&](int x, int y) { return isFg(objectContourMask, x, y); });
 
-        const int startDir = (dirBack + 1) & 7;
-        for (int t = 0; t < 8; ++t) {
-            const int d = (startDir + t) & 7;
-            const int nx = p.x + dx8[d];
-            const int ny = p.y + dy8[d];
-            if (isFg(objectContourMask, nx, ny)) {
-                // new backtrack is neighbor preceding d in clockwise order
-                const int prevd = (d + 7) & 7;
-                point2i newBack{p.x + dx8[prevd], p.y + dy8[prevd]};
-                return {point2i{nx, ny}, newBack};
-            }
-        }
-        // Should not happen for a valid single contour
-        return {p, back};
-    };
-
-    std::vector<point2i> contour;
-    contour.reserve(static_cast<std::size_t>(w) * static_cast<std::size_t>(h) / 4);
+    for (point2i p: contour) {
+        rassert(p.x >= 0 && p.x < w && p.y >= 0 && p.y < h, 2347823412);
+    }
 
-    contour.push_back(p0);
+    return contour;
+}
 
-    auto [p1, b1] = step(p0, b);
-    if (p1 == p0) return contour;
+std::vector<point2i> traceContour(image8u_view objectMask) {
+    rassert(objectMask.channels() == 1, 918273647);
 
-    contour.push_back(p1);
+    const int w = objectMask.width();
+    const int h = objectMask.height();
 
-    point2i cur = p1;
-    b = b1;
+    // Mask with a one pixel background border around it: neighbors of any pixel of the image (and of the border)
+    // are inside the buffer, so they are read without bounds checks
+    const int pw = w + 2;
+    std::vector<unsigned char> padded(static_cast<std::size_t>(pw) * (h + 2), 0);
+    point2i start{-1, -1};
+    for (int y = 0; y < h; ++y) {
+        const unsigned char *row = objectMask.row(y);
+        std::copy(row, row + w, padded.begin() + static_cast<std::ptrdiff_t>(y + 1) * pw + 1);
+        if (start.x < 0) {
+            // the top-most, then left-most object pixel has background above - so it is a contour pixel
+            const unsigned char *first = std::find(row, row + w, kFg);
+            if (first != row + w) start = {static_cast<int>(first - row), y};
+        }
+    }
+    if (start.x < 0) return {};
 
-    const std::size_t safetyLimit = static_cast<std::size_t>(w) * static_cast<std::size_t>(h) + 8;
+    std::ptrdiff_t offsets8[8];
+    for (int k = 0; k < 8; ++k) {
+        offsets8[k] = static_cast<std::ptrdiff_t>(dy8[k]) * pw + dx8[k];
+    }
+    // contour pixel (as in buildContourMask) - an object pixel with a background 8-neighbor,
+    // only pixels of the image and of the border are asked, and border pixels are background
+    auto isContour = [&](int x, int y) {
+        const unsigned char *p = padded.data() + static_cast<std::ptrdiff_t>(y + 1) * pw + (x + 1);
+        if (*p != kFg) return false;
+        for (int k = 0; k < 8; ++k) {
+            if (p[offsets8[k]] != kFg) return true;
+        }
+        return false;
+    };
+    return mooreTrace(start, w, h, isContour);
+}
 
-    while (contour.size() < safetyLimit) {
-        auto [nxt, nb] = step(cur, b);
+std::vector<point2f> extractContourSubpixel(image32f_view grayscale, const std::vector<point2i> &contour, float level, int radius) {
+    rassert(grayscale.channels() == 1, 918273648, grayscale.channels());
+    rassert(radius >= 1, 918273649, radius);
+
+    const int w = grayscale.width();
+    const int h = grayscale.height();
+    if (w < 2 || h < 2 || contour.empty()) return {};
+
+    // cells are squares between 4 neighboring pixel centers, cell (x, y) has top-left corner at pixel (x, y)
+    const int cw = w - 1;
+    const int ch = h - 1;
+    std::vector<unsigned char> band(static_cast<std::size_t>(cw) * ch, 0);
+    for (point2i p : contour) {
+        for (int y = std::max(0, p.y - radius); y <= std::min(ch - 1, p.y + radius); ++y) {
+            for (int x = std::max(0, p.x - radius); x <= std::min(cw - 1, p.x + radius); ++x) {
+                band[static_cast<std::size_t>(y) * cw + x] = 1;
+            }
+        }
+    }
 
-        // Closed the loop: do not append start again.
-        if (nxt == p0) break;
+    // iso-line crosses cell edges: horizontal edge (x, y)-(x + 1, y) has id y * cw + x,
+    // vertical edge (x, y)-(x, y + 1) has id horizontalEdges + y * w + x
+    const int horizontalEdges = cw * h;
+    const int edgesCount = horizontalEdges + w * ch;
+    auto horizontalEdge = [&](int x, int y) { return y * cw + x; };
+    auto verticalEdge = [&](int x, int y) { return horizontalEdges + y * w + x; };
+    auto value = [&](int x, int y) { return grayscale.at_unchecked(y, x); };
+
+    // crossing point of an edge, linearly interpolated between its pixel centers
+    auto crossing = [&](int edge) -> point2f {
+        int x0, y0, x1, y1;
+        if (edge < horizontalEdges) {
+            x0 = edge % cw; y0 = edge / cw; x1 = x0 + 1; y1 = y0;
+        } else {
+            x0 = (edge - horizontalEdges) % w; y0 = (edge - horizontalEdges) / w; x1 = x0; y1 = y0 + 1;
+        }
+        const float v0 = value(x0, y0);
+        const float v1 = value(x1, y1);
+        const float t = (level - v0) / (v1 - v0);
+        return {x0 + t * (x1 - x0), y0 + t * (y1 - y0)};
+    };
 
-        contour.push_back(nxt);
-        b = nb;
-        cur = nxt;
+    // each cell links the edge where the iso-line enters the object (walking around the cell clockwise)
+    // to the edge where it leaves it, so neighboring cells continue each other's segments
+    std::vector<int> next(edgesCount, -1);
+    for (int y = 0; y < ch; ++y) {
+        for (int x = 0; x < cw; ++x) {
+            if (!band[static_cast<std::size_t>(y) * cw + x]) continue;
+
+            // corners and edges clockwise: TL, TR, BR, BL and top, right, bottom, left
+            const float v[4] = {value(x, y), value(x + 1, y), value(x + 1, y + 1), value(x, y + 1)};
+            const int edges[4] = {horizontalEdge(x, y), verticalEdge(x + 1, y), horizontalEdge(x, y + 1), verticalEdge(x, y)};
+            bool inside[4];
+            for (int k = 0; k < 4; ++k) inside[k] = v[k] >= level;
+
+            int enters[2], leaves[2];
+            int entersCount = 0, leavesCount = 0;
+            for (int k = 0; k < 4; ++k) {
+                if (inside[k] == inside[(k + 1) & 3]) continue;
+                if (inside[(k + 1) & 3]) enters[entersCount++] = k;
+                else leaves[leavesCount++] = k;
+            }
+            if (entersCount == 1) {
+                next[edges[enters[0]]] = edges[leaves[0]];
+            } else if (entersCount == 2) {
+                // saddle: crossings alternate around the cell, the average of the corners decides whether
+                // the object connects through the center (then each entering edge continues to the preceding leaving edge)
+                const bool centerInside = (v[0] + v[1] + v[2] + v[3]) * 0.25f >= level;
+                for (int k = 0; k < 2; ++k) {
+                    next[edges[enters[k]]] = edges[(enters[k] + (centerInside ? 3 : 1)) & 3];
+                }
+            }
+        }
     }
 
-    // Enforce clockwise orientation in image coords.
-    if (signedArea2_imageCoords(contour) < 0) {
-        std::reverse(contour.begin(), contour.end());
+    // the longest closed chain of edges is the object's edge, chains that leave the band are dropped
+    std::vector<unsigned char> visited(edgesCount, 0);
+    std::vector<int> best;
+    std::vector<int> chain;
+    for (int start = 0; start < edgesCount; ++start) {
+        if (next[start] < 0 || visited[start]) continue;
+        chain.clear();
+        int e = start;
+        while (e >= 0 && !visited[e]) {
+            visited[e] = 1;
+            chain.push_back(e);
+            e = next[e];
+        }
+        if (e == start && chain.size() > best.size()) {
+            best = chain;
+        }
     }
 
-    // Deterministic start: rotate to min (y, x).
-    rotateToMinYX(contour);
-
-    for (point2i p: contour) {
-        rassert(p.x >= 0 && p.x < w && p.y >= 0 && p.y < h, 2347823412);
+    std::vector<point2f> result;
+    result.reserve(best.size());
+    for (int edge : best) {
+        result.push_back(crossing(edge));
     }
-
-    return contour;
+    if (signedArea2_imageCoords(result) < 0) {
+        std::reverse(result.begin(), result.end());
+    }
+    rotateToMinYX(result);
+    return result;
 }
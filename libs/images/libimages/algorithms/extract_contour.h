@@ -1,5 +1,6 @@
 #pragma once
 
+#include <libimages/binary_mask.h>
 #include <libimages/image.h>
 #include <libbase/point2.h>
 
@@ -7,8 +8,24 @@
 
 // Input: object mask (0 = background, 255 = object).
 // Output: contour mask (0 = not contour, 255 = contour pixel).
-image8u buildContourMask(const image8u &objectMask);
+image8u buildContourMask(image8u_view objectMask);
+
+// The same for a bit-packed mask: object pixels that have a background (or outside) 8-neighbor,
+// i.e. objectMask AND NOT erode(objectMask, 1).
+BinaryMask buildContourMask(const BinaryMask &objectMask);
 
 // Input: contour mask (0 = background, 255 = contour pixel).
 // Output: single closed loop of contour pixels in clockwise order (image coords: x right, y down).
-std::vector<point2i> extractContour(const image8u &objectContourMask);
+std::vector<point2i> extractContour(image8u_view objectContourMask);
+
+// The same contour as extractContour(buildContourMask(objectMask)), but traced straight from the object mask
+// (0 = background, 255 = object) without building the contour mask: contour pixels are recognized on the fly
+// in a copy of the mask padded with a background border, so neighbors are read without bounds checks.
+std::vector<point2i> traceContour(image8u_view objectMask);
+
+// Subpixel contour: iso-line grayscale == level (object is >= level) traced with marching squares, only in the cells
+// within radius pixels of an integer contour (f.e. from traceContour) in the same coordinates - so the mask is used
+// just to find where the edge is, and the edge itself is found on the (blurred) grayscale.
+// Pixel centers are at integer coordinates. Returns the longest closed iso-line in the band, clockwise and starting
+// at min (y, x), or an empty contour if the iso-line leaves the band everywhere.
+std::vector<point2f> extractContourSubpixel(image32f_view grayscale, const std::vector<point2i> &contour, float level, int radius);
@@ -3,10 +3,12 @@
 #include <gtest/gtest.h>
 
 #include <libbase/configure_working_directory.h>
+#include <libbase/fast_random.h>
 #include <libimages/debug_io.h>
 #include <libimages/tests_utils.h>
 
 #include <algorithm>
+#include <cmath>
 #include <cstdint>
 #include <vector>
 
@@ -97,6 +99,18 @@ TEST(extract_contour, buildContourMask_rectangle) {
     EXPECT_EQ(contour(7, 6), 255);        // bottom edge
 }
 
+TEST(extract_contour, buildContourMask_binaryMaskEqualsImage) {
+    image8u obj(70, 20, 1);
+    obj.fill(0);
+    fillRect(obj, point2i{0, 0}, point2i{30, 12}, kFg);
+    fillRect(obj, point2i{25, 8}, point2i{70, 20}, kFg);
+    obj(15, 10) = kFg; // isolated pixel
+    obj(5, 50) = kFg;
+
+    const BinaryMask contour = buildContourMask(BinaryMask(obj));
+    EXPECT_EQ(contour.toImage().toVector(), buildContourMask(obj).toVector());
+}
+
 TEST(extract_contour, extractContour_rectangle_clockwise_and_adjacent) {
     configureWorkingDirectory();
 
@@ -163,3 +177,70 @@ TEST(extract_contour, singlePixel) {
     ASSERT_EQ(contour.size(), 1u);
     EXPECT_EQ(contour[0], (point2i{4, 3}));
 }
+
+TEST(extract_contour, traceContourEqualsContourMaskTracing) {
+    // blobs of random discs touching the image border, with concave parts and one pixel wide bridges
+    FastRandom r(239);
+    for (int iter = 0; iter < 50; ++iter) {
+        const int w = r.nextInt(1, 40);
+        const int h = r.nextInt(1, 40);
+        image8u obj(w, h, 1);
+        const int cx = r.nextInt(0, w - 1);
+        const int cy = r.nextInt(0, h - 1);
+        obj(cy, cx) = kFg;
+        for (int disc = 0; disc < 4; ++disc) {
+            const int radius = r.nextInt(0, 8);
+            const int dx = r.nextInt(-radius, radius);
+            const int dy = r.nextInt(-radius, radius);
+            for (int y = 0; y < h; ++y) {
+                for (int x = 0; x < w; ++x) {
+                    const int ex = x - cx - dx;
+                    const int ey = y - cy - dy;
+                    if (ex * ex + ey * ey <= radius * radius) obj(y, x) = kFg;
+                }
+            }
+            // bridge from the center to the disc keeps the object connected
+            for (int t = 0; t <= std::max(std::abs(dx), std::abs(dy)); ++t) {
+                const int x = std::clamp(cx + (std::abs(dx) >= t ? (dx > 0 ? t : -t) : dx), 0, w - 1);
+                const int y = std::clamp(cy + (std::abs(dy) >= t ? (dy > 0 ? t : -t) : dy), 0, h - 1);
+                obj(y, x) = kFg;
+            }
+        }
+
+        EXPECT_EQ(traceContour(obj), extractContour(buildContourMask(obj))) << "iteration " << iter << ": " << w << "x" << h;
+    }
+
+    EXPECT_TRUE(traceContour(image8u(5, 4, 1)).empty());
+}
+
+TEST(extract_contour, subpixelContourOfDisc) {
+    // anti-aliased disc: intensity goes from 50 to 200 over one pixel around the true radius
+    const float cx = 20.4f, cy = 19.7f, radius = 12.3f;
+    image32f gray(41, 40, 1);
+    image8u mask(41, 40, 1);
+    for (int y = 0; y < gray.height(); ++y) {
+        for (int x = 0; x < gray.width(); ++x) {
+            const float d = std::hypot(x - cx, y - cy);
+            gray(y, x) = 50.0f + 150.0f * std::clamp(radius - d + 0.5f, 0.0f, 1.0f);
+            // the mask is eroded - its contour is a few pixels inside the true edge
+            if (d <= radius - 2.5f) mask(y, x) = kFg;
+        }
+    }
+
+    const std::vector<point2f> contour = extractContourSubpixel(gray, traceContour(mask), 125.0f, 5);
+    ASSERT_GT(contour.size(), 50u);
+    for (point2f p : contour) {
+        EXPECT_NEAR(std::hypot(p.x - cx, p.y - cy), radius, 0.1f) << p;
+    }
+
+    double a2 = 0.0;
+    for (std::size_t i = 0; i < contour.size(); ++i) {
+        const point2f p = contour[i];
+        const point2f q = contour[(i + 1) % contour.size()];
+        a2 += static_cast<double>(p.x) * q.y - static_cast<double>(q.x) * p.y;
+    }
+    EXPECT_GT(a2, 0.0); // clockwise
+
+    // the edge is out of a too narrow band - no closed iso-line
+    EXPECT_TRUE(extractContourSubpixel(gray, traceContour(mask), 125.0f, 1).empty());
+}
@@ -2,25 +2,41 @@
 
 #include <libbase/runtime_assert.h>
 
-image32f to_grayscale_float(const image8u& img) {
-    rassert(img.channels() == 1 || img.channels() == 3 || img.channels() == 4, "Unsupported channel count", img.channels());
-
-    image32f gray(img.width(), img.height(), 1);
+#include <vector>
 
-    if (img.channels() == 1) {
-        for (int j = 0; j < img.height(); ++j)
-            for (int i = 0; i < img.width(); ++i)
-                gray(j, i) = (float) img(j, i);
-        return gray;
+void to_grayscale_row(const std::uint8_t *src, int width, int channels, float *dst) {
+    if (channels == 1) {
+        for (int i = 0; i < width; ++i)
+            dst[i] = (float) src[i];
+        return;
+    }
+    for (int i = 0; i < width; ++i) {
+        const float r = (float) src[i * channels + 0];
+        const float g = (float) src[i * channels + 1];
+        const float b = (float) src[i * channels + 2];
+        dst[i] = 0.299f * r + 0.587f * g + 0.114f * b;
     }
+}
+
+image32f to_grayscale_float(image8u_view img) {
+    rassert(img.channels() == 1 || img.channels() == 3 || img.channels() == 4, "Unsupported channel count", img.channels());
 
+    image32f gray(img.width(), img.height(), 1, ImageInit::Uninitialized);
     for (int j = 0; j < img.height(); ++j) {
-        for (int i = 0; i < img.width(); ++i) {
-            const float r = (float) img(j, i, 0);
-            const float g = (float) img(j, i, 1);
-            const float b = (float) img(j, i, 2);
-            gray(j, i) = 0.299f * r + 0.587f * g + 0.114f * b;
-        }
+        to_grayscale_row(img.row(j), img.width(), img.channels(), gray.row(j));
+    }
+    return gray;
+}
+
+image32f to_grayscale_float(ImageRowReader &reader) {
+    rassert(reader.channels() == 1 || reader.channels() == 3 || reader.channels() == 4, 2317812937194, reader.channels());
+    rassert(reader.rows_read() == 0, 2317812937195, "Reader has already been used", reader.rows_read());
+
+    image32f gray(reader.width(), reader.height(), 1, ImageInit::Uninitialized);
+    std::vector<std::uint8_t> row(static_cast<std::size_t>(reader.width()) * reader.channels());
+    for (int j = 0; j < reader.height(); ++j) {
+        reader.read_row(row.data());
+        to_grayscale_row(row.data(), reader.width(), reader.channels(), gray.row(j));
     }
     return gray;
 }
@@ -1,5 +1,19 @@
 #pragma once
 
+#include <cstdint>
+
 #include <libimages/image.h>
+#include <libimages/image_io.h>
+
+image32f to_grayscale_float(image8u_view img);
+
+// grayscale of an image decoded row by row - only a single row of the source image is held in memory
+image32f to_grayscale_float(ImageRowReader &reader);
+
+// grayscale of a single row of width pixels with channels (1, 3 or 4) values each
+void to_grayscale_row(const std::uint8_t *src, int width, int channels, float *dst);
 
-image32f to_grayscale_float(const image8u& img);
+// 8-bit grayscale in fixed point: the same weights as to_grayscale_row rounded to 1/256 (77 + 150 + 29 = 256)
+inline std::uint8_t luma8(std::uint8_t r, std::uint8_t g, std::uint8_t b) {
+    return static_cast<std::uint8_t>((77 * r + 150 * g + 29 * b + 128) >> 8);
+}
@@ -15,3 +15,14 @@ TEST(grayscale, loadImageAndThresholdByConstant) {
     image32f grayscale = to_grayscale_float(img);
     debug_io::dump_image(getUnitCaseDebugDir() + "grayscale.jpg", grayscale);
 }
+
+TEST(grayscale, rowReaderEqualsDecodedImage) {
+    configureWorkingDirectory();
+
+    image8u img = load_image("data/00_photo_six_parts_downscaled_x4.jpg");
+    const std::string path = getUnitCaseDebugDir() + "input.png";
+    debug_io::dump_image(path, img);
+
+    ImageRowReader reader(path);
+    EXPECT_EQ(to_grayscale_float(reader).toVector(), to_grayscale_float(img).toVector());
+}
@@ -0,0 +1,43 @@
+#include "image_pyramid.h"
+
+#include "downsample.h"
+
+#include <libbase/runtime_assert.h>
+
+template <typename T>
+ImagePyramid<T>::ImagePyramid(ImageView<const T> base, SimdLevel simd_level) : base_(base), simd_level_(simd_level) {
+    rassert(base.width() > 0 && base.height() > 0, 561230981, base.width(), base.height());
+}
+
+template <typename T>
+int ImagePyramid<T>::levels_count() const noexcept {
+    int count = 1;
+    for (int w = base_.width(), h = base_.height(); w > 1 || h > 1; w = (w + 1) / 2, h = (h + 1) / 2) {
+        ++count;
+    }
+    return count;
+}
+
+template <typename T>
+ImageView<const T> ImagePyramid<T>::level(int k) {
+    rassert(k >= 0 && k < levels_count(), 561230982, k, levels_count());
+    if (k == 0) return base_;
+    while (static_cast<int>(levels_.size()) < k) {
+        const ImageView<const T> prev = levels_.empty() ? base_ : ImageView<const T>(levels_.back());
+        levels_.push_back(downsample2x<T>(prev, simd_level_));
+    }
+    return levels_[k - 1];
+}
+
+template <typename T>
+int ImagePyramid<T>::level_for_size(int width, int height) const noexcept {
+    int k = 0;
+    for (int w = base_.width(), h = base_.height(); (w + 1) / 2 >= width && (h + 1) / 2 >= height && (w > 1 || h > 1);
+         w = (w + 1) / 2, h = (h + 1) / 2) {
+        ++k;
+    }
+    return k;
+}
+
+template class ImagePyramid<std::uint8_t>;
+template class ImagePyramid<float>;
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <vector>
+
+#include <libbase/cpu_features.h>
+#include <libimages/image.h>
+
+// Levels of an image, each is 2x smaller than the previous one (see downsample2x): level 0 is the image itself,
+// level k is ceil(w / 2^k) x ceil(h / 2^k). Levels are built on first request and cached, so consumers which need
+// different scales (threshold estimation, segmentation, previews...) share them instead of downsampling again.
+// Level 0 is a view - the base image must outlive the pyramid. Not thread-safe: level() builds missing levels.
+template <typename T> class ImagePyramid final {
+  public:
+    ImagePyramid() = default;
+    explicit ImagePyramid(ImageView<const T> base, SimdLevel simd_level = SimdLevel::AVX2);
+
+    // Number of levels down to 1x1 (including level 0)
+    int levels_count() const noexcept;
+    // How many times level k is smaller than level 0
+    static int scale(int k) noexcept { return 1 << k; }
+    // Whether level k is already built
+    bool is_built(int k) const noexcept { return k == 0 || k <= static_cast<int>(levels_.size()); }
+
+    // Level k (0 <= k < levels_count()), builds it (and the levels before it) if needed
+    ImageView<const T> level(int k);
+    // The smallest level which is still at least width x height (level 0 if the image itself is smaller)
+    int level_for_size(int width, int height) const noexcept;
+
+  private:
+    ImageView<const T> base_;
+    std::vector<Image<T>> levels_; // levels 1, 2, ... built so far
+    SimdLevel simd_level_ = SimdLevel::AVX2;
+};
+
+extern template class ImagePyramid<std::uint8_t>;
+extern template class ImagePyramid<float>;
+
+using image8u_pyramid = ImagePyramid<std::uint8_t>;
+using image32f_pyramid = ImagePyramid<float>;
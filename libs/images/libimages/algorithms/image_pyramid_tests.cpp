@@ -0,0 +1,83 @@
+#include "image_pyramid.h"
+
+#include <gtest/gtest.h>
+
+#include <libbase/fast_random.h>
+#include <libimages/algorithms/downsample.h>
+#include <libimages/image.h>
+
+#include <cstdint>
+
+namespace {
+
+image8u randomImage(int w, int h, int c, int seed) {
+    FastRandom r(seed);
+    image8u image(w, h, c);
+    for (std::uint8_t &v : image.pixels()) {
+        v = static_cast<std::uint8_t>(r.nextInt(0, 255));
+    }
+    return image;
+}
+
+} // namespace
+
+TEST(image_pyramid, downsample2xMatchesBoxFilter) {
+    for (int c : {1, 3}) {
+        for (auto [w, h] : {std::pair{64, 48}, std::pair{37, 21}, std::pair{1, 5}, std::pair{2, 1}}) {
+            const image8u image = randomImage(w, h, c, 239 + w);
+            const image8u expected = downsample_box(image, 2);
+            for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::SSE41, SimdLevel::AVX2}) {
+                const image8u ds = downsample2x<std::uint8_t>(image, level);
+                ASSERT_EQ(ds.size(), expected.size());
+                EXPECT_EQ(ds.toVector(), expected.toVector()) << w << "x" << h << "x" << c << " " << simdLevelName(level);
+            }
+        }
+    }
+}
+
+TEST(image_pyramid, downsample2xFloatAverages) {
+    image32f image(5, 3, 1);
+    for (int j = 0; j < 3; ++j)
+        for (int i = 0; i < 5; ++i)
+            image(j, i) = 10.0f * j + i;
+
+    for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::SSE41, SimdLevel::AVX2}) {
+        const image32f ds = downsample2x<float>(image, level);
+        ASSERT_EQ(ds.size(), std::make_tuple(3, 2, 1));
+        EXPECT_FLOAT_EQ(ds(0, 0), 5.5f);
+        EXPECT_FLOAT_EQ(ds(0, 2), 9.0f);  // the last column is averaged with itself
+        EXPECT_FLOAT_EQ(ds(1, 1), 22.5f); // the last row too
+        EXPECT_FLOAT_EQ(ds(1, 2), 24.0f);
+    }
+}
+
+TEST(image_pyramid, levelsAreBuiltOnceAndCached) {
+    const image8u image = randomImage(100, 30, 3, 42);
+    image8u_pyramid pyramid(image);
+    EXPECT_EQ(pyramid.levels_count(), 8); // 100x30, 50x15, 25x8, 13x4, 7x2, 4x1, 2x1, 1x1
+    EXPECT_EQ(pyramid.level(0).data(), image.data());
+    EXPECT_FALSE(pyramid.is_built(1));
+
+    const image8u_view level2 = pyramid.level(2);
+    EXPECT_TRUE(pyramid.is_built(1));
+    EXPECT_FALSE(pyramid.is_built(3));
+    EXPECT_EQ(level2.size(), std::make_tuple(25, 8, 3));
+    EXPECT_EQ(level2.copy().toVector(), downsample_box(downsample_box(image, 2), 2).toVector());
+
+    // building further levels doesn't invalidate (or rebuild) the earlier ones
+    const image8u_view level7 = pyramid.level(7);
+    EXPECT_EQ(level7.size(), std::make_tuple(1, 1, 3));
+    EXPECT_EQ(pyramid.level(2).data(), level2.data());
+}
+
+TEST(image_pyramid, levelForSize) {
+    const image8u image(100, 30, 1);
+    const image8u_pyramid pyramid(image);
+    EXPECT_EQ(pyramid.level_for_size(100, 30), 0);
+    EXPECT_EQ(pyramid.level_for_size(200, 10), 0);
+    EXPECT_EQ(pyramid.level_for_size(50, 15), 1);
+    EXPECT_EQ(pyramid.level_for_size(40, 10), 1);
+    EXPECT_EQ(pyramid.level_for_size(25, 4), 2);
+    EXPECT_EQ(pyramid.level_for_size(13, 4), 3);
+    EXPECT_EQ(pyramid.level_for_size(1, 1), 7);
+}
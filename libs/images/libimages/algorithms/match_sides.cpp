@@ -0,0 +1,150 @@
+#include "match_sides.h"
+
+#include <libbase/runtime_assert.h>
+#include <libbase/stats.h>
+#include <libimages/algorithms/color_difference.h>
+#include <libimages/algorithms/downsample.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+
+namespace {
+
+constexpr int TILE_SIZE = 32;
+
+constexpr float NOT_COMPARED = std::numeric_limits<float>::infinity();
+
+// Reusable buffers (one set per thread), so that comparing a pair of sides doesn't allocate
+struct PairScratch {
+    std::vector<std::uint8_t> a, b; // planes of a side downsampled to the common length (if it is longer)
+    std::vector<std::uint16_t> differences;
+    stats::Histogram<3 * 255 + 1> histogram;
+};
+
+// Planes of colors downsampled to n colors (as downsample(colors, n)) - without copying if colors have exactly n colors
+void downsampledPlanes(const color_strip8u &colors, int n, std::vector<std::uint8_t> &buffer, const std::uint8_t *planes[3]) {
+    const int m = colors.length();
+    const int channels = colors.channels();
+    if (m == n) {
+        for (int c = 0; c < channels; ++c) {
+            planes[c] = colors.channel(c);
+        }
+        return;
+    }
+
+    buffer.resize((size_t) n * channels);
+    for (int c = 0; c < channels; ++c) {
+        planes[c] = buffer.data() + (size_t) c * n;
+    }
+    for (int i = 0; i < n; ++i) {
+        const int from = downsampledIndex(i, n, m);
+        for (int c = 0; c < channels; ++c) {
+            buffer[(size_t) c * n + i] = colors.channel(c)[from];
+        }
+    }
+}
+
+// Fills scratch.differences with per-pixel differences of two sides, returns their count
+int computeDifferences(const SideDescriptor &a, const SideDescriptor &b, PairScratch &scratch) {
+    const color_strip8u &colorsA = a.colors;
+    const color_strip8u &colorsB = b.colors_reversed;
+    rassert(colorsA.channels() == colorsB.channels(), 6712390128301, colorsA.channels(), colorsB.channels());
+    rassert(!colorsA.empty() && !colorsB.empty(), 6712390128302);
+
+    const int n = std::min(colorsA.length(), colorsB.length());
+    const std::uint8_t *planesA[3];
+    const std::uint8_t *planesB[3];
+    downsampledPlanes(colorsA, n, scratch.a, planesA);
+    downsampledPlanes(colorsB, n, scratch.b, planesB);
+
+    scratch.differences.resize(n);
+    colorsL1Differences(planesA, planesB, colorsA.channels(), n, scratch.differences.data());
+    return n;
+}
+
+float medianDifference(const SideDescriptor &a, const SideDescriptor &b, PairScratch &scratch) {
+    const int n = computeDifferences(a, b, scratch);
+    // differences are bounded by 3 * 255, so the median is selected by counting
+    scratch.histogram.clear();
+    scratch.histogram.add(scratch.differences.data(), n);
+    return scratch.histogram.median();
+}
+
+} // namespace
+
+void sidesDifferences(const SideDescriptor &a, const SideDescriptor &b, std::vector<float> &differences) {
+    PairScratch scratch;
+    const int n = computeDifferences(a, b, scratch);
+    differences.assign(scratch.differences.begin(), scratch.differences.begin() + n);
+}
+
+float sidesDifference(const SideDescriptor &a, const SideDescriptor &b) {
+    PairScratch scratch;
+    return medianDifference(a, b, scratch);
+}
+
+SidesDissimilarityMatrix::SidesDissimilarityMatrix(int sides_count)
+    : n_(sides_count), values_((size_t) sides_count * sides_count, NOT_COMPARED) {
+    rassert(sides_count >= 0, 6712390128303, sides_count);
+}
+
+float SidesDissimilarityMatrix::operator()(int a, int b) const {
+    rassert(a >= 0 && a < n_ && b >= 0 && b < n_, 6712390128304, a, b, n_);
+    return values_[(size_t) a * n_ + b];
+}
+
+float &SidesDissimilarityMatrix::operator()(int a, int b) {
+    rassert(a >= 0 && a < n_ && b >= 0 && b < n_, 6712390128305, a, b, n_);
+    return values_[(size_t) a * n_ + b];
+}
+
+bool SidesDissimilarityMatrix::compared(int a, int b) const { return (*this)(a, b) != NOT_COMPARED; }
+
+std::vector<SideCandidate> SidesDissimilarityMatrix::topK(int a, int k) const {
+    rassert(a >= 0 && a < n_, 6712390128306, a, n_);
+    rassert(k >= 0, 6712390128307, k);
+
+    std::vector<SideCandidate> candidates;
+    const float *row = values_.data() + (size_t) a * n_;
+    for (int b = 0; b < n_; ++b) {
+        if (row[b] != NOT_COMPARED) {
+            candidates.push_back({b, row[b]});
+        }
+    }
+
+    auto better = [](const SideCandidate &x, const SideCandidate &y) {
+        if (x.difference != y.difference)
+            return x.difference < y.difference;
+        return x.side > y.side;
+    };
+    const size_t top = std::min<size_t>(k, candidates.size());
+    std::partial_sort(candidates.begin(), candidates.begin() + top, candidates.end(), better);
+    candidates.resize(top);
+    return candidates;
+}
+
+SidesDissimilarityMatrix matchSides(const std::vector<SideDescriptor> &sides, bool with_openmp) {
+    const int n = static_cast<int>(sides.size());
+    SidesDissimilarityMatrix matrix(n);
+
+    const int tiles = (n + TILE_SIZE - 1) / TILE_SIZE;
+    // pairs of the same group and ignored sides are skipped, so tiles have very different cost - hence dynamic schedule
+    #pragma omp parallel for schedule(dynamic) if(with_openmp)
+    for (int tile = 0; tile < tiles * tiles; ++tile) {
+        const int a0 = (tile / tiles) * TILE_SIZE;
+        const int b0 = (tile % tiles) * TILE_SIZE;
+        PairScratch scratch;
+        for (int a = a0; a < std::min(n, a0 + TILE_SIZE); ++a) {
+            if (sides[a].ignored)
+                continue;
+            for (int b = b0; b < std::min(n, b0 + TILE_SIZE); ++b) {
+                if (a == b || sides[b].ignored || (sides[a].group >= 0 && sides[a].group == sides[b].group))
+                    continue;
+                matrix(a, b) = medianDifference(sides[a], sides[b], scratch);
+            }
+        }
+    }
+
+    return matrix;
+}
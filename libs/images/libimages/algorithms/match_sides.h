@@ -0,0 +1,51 @@
+#pragma once
+
+#include <vector>
+
+#include <libimages/color_strip.h>
+
+// Color profile of a puzzle piece side, built once per side and then compared with all other sides.
+struct SideDescriptor final {
+    color_strip8u colors;          // colors along the side (clockwise, as in the contour)
+    color_strip8u colors_reversed; // the same colors in the opposite direction (sides are compared as a zipper)
+    int group = -1;                // f.e. index of the piece - sides of the same group are not compared with each other (-1 - no group)
+    bool ignored = false;          // f.e. side on the border of the whole image - it is not compared with anything
+};
+
+// Per-pixel difference of two sides: a.colors and b.colors_reversed are downsampled to the common length
+// (as with downsample(strip, n)), then differences[i] = sum over channels of |a_i - b_i|
+void sidesDifferences(const SideDescriptor &a, const SideDescriptor &b, std::vector<float> &differences);
+
+// Median of sidesDifferences(a, b) - 0 means that sides match perfectly
+float sidesDifference(const SideDescriptor &a, const SideDescriptor &b);
+
+struct SideCandidate final {
+    int side = -1;
+    float difference = -1.0f;
+};
+
+// Dissimilarity of all pairs of sides: value(a, b) = sidesDifference(sides[a], sides[b]),
+// +infinity for pairs that were not compared (the same side, the same group or an ignored side).
+class SidesDissimilarityMatrix final {
+  public:
+    SidesDissimilarityMatrix() = default;
+    explicit SidesDissimilarityMatrix(int sides_count);
+
+    int sidesCount() const noexcept { return n_; }
+
+    float operator()(int a, int b) const;
+    float &operator()(int a, int b);
+    bool compared(int a, int b) const;
+
+    // Up to k best (smallest difference) compared candidates for side a, sorted from the best.
+    // Ties are resolved in favour of the larger side index.
+    std::vector<SideCandidate> topK(int a, int k) const;
+
+  private:
+    int n_ = 0;
+    std::vector<float> values_; // row-major n_ x n_
+};
+
+// Fills the full matrix. Work is split into square tiles of pairs, so that each thread
+// works on a small set of descriptors that stay in cache.
+SidesDissimilarityMatrix matchSides(const std::vector<SideDescriptor> &sides, bool with_openmp = true);
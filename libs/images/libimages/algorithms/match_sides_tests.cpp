@@ -0,0 +1,123 @@
+#include "match_sides.h"
+
+#include <gtest/gtest.h>
+
+#include <libbase/fast_random.h>
+#include <libbase/stats.h>
+#include <libimages/algorithms/downsample.h>
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace {
+
+SideDescriptor makeRandomSide(FastRandom &r, int group, int length) {
+    SideDescriptor side;
+    side.group = group;
+    side.colors = color_strip8u(length, 3);
+    for (int c = 0; c < 3; ++c) {
+        for (int i = 0; i < length; ++i) {
+            side.colors(i, c) = (uint8_t) r.nextInt(0, 255);
+        }
+    }
+    side.colors_reversed = side.colors.reversed();
+    return side;
+}
+
+std::vector<SideDescriptor> makeRandomSides(int pieces, int sides_per_piece) {
+    FastRandom r(239);
+    std::vector<SideDescriptor> sides;
+    for (int piece = 0; piece < pieces; ++piece) {
+        for (int side = 0; side < sides_per_piece; ++side) {
+            sides.push_back(makeRandomSide(r, piece, r.nextInt(20, 60)));
+        }
+    }
+    return sides;
+}
+
+// straightforward version: materialize downsampled strips and compare them pixel by pixel
+float naiveSidesDifference(const SideDescriptor &a, const SideDescriptor &b) {
+    const int n = std::min(a.colors.length(), b.colors.length());
+    const color_strip8u da = downsample(a.colors, n);
+    const color_strip8u db = downsample(b.colors_reversed, n);
+    std::vector<float> differences(n);
+    for (int i = 0; i < n; ++i) {
+        float d = 0;
+        for (int c = 0; c < 3; ++c) {
+            d += std::abs((int) da(i, c) - db(i, c));
+        }
+        differences[i] = d;
+    }
+    return stats::median(differences);
+}
+
+} // namespace
+
+TEST(match_sides, differenceMatchesNaive) {
+    std::vector<SideDescriptor> sides = makeRandomSides(3, 4);
+    for (const SideDescriptor &a: sides) {
+        for (const SideDescriptor &b: sides) {
+            EXPECT_EQ(sidesDifference(a, b), naiveSidesDifference(a, b));
+        }
+    }
+}
+
+TEST(match_sides, identicalSidesMatchPerfectly) {
+    FastRandom r(2391);
+    SideDescriptor a = makeRandomSide(r, 0, 50);
+    SideDescriptor b = a;
+    b.group = 1;
+    // B goes in the opposite direction, so its reversed colors are A's colors
+    std::swap(b.colors, b.colors_reversed);
+    EXPECT_EQ(sidesDifference(a, b), 0.0f);
+}
+
+TEST(match_sides, matrixSkipsSameGroupAndIgnored) {
+    std::vector<SideDescriptor> sides = makeRandomSides(3, 4);
+    sides[5].ignored = true;
+
+    SidesDissimilarityMatrix matrix = matchSides(sides);
+    ASSERT_EQ(matrix.sidesCount(), 12);
+    for (int a = 0; a < 12; ++a) {
+        for (int b = 0; b < 12; ++b) {
+            const bool expected = sides[a].group != sides[b].group && a != 5 && b != 5;
+            EXPECT_EQ(matrix.compared(a, b), expected);
+            if (expected) {
+                EXPECT_EQ(matrix(a, b), naiveSidesDifference(sides[a], sides[b]));
+            }
+        }
+    }
+    EXPECT_TRUE(matrix.topK(5, 3).empty());
+}
+
+TEST(match_sides, parallelEqualsSequential) {
+    // more sides than in one tile
+    std::vector<SideDescriptor> sides = makeRandomSides(25, 4);
+    SidesDissimilarityMatrix parallel = matchSides(sides, true);
+    SidesDissimilarityMatrix sequential = matchSides(sides, false);
+    for (int a = 0; a < parallel.sidesCount(); ++a) {
+        for (int b = 0; b < parallel.sidesCount(); ++b) {
+            EXPECT_EQ(parallel(a, b), sequential(a, b));
+        }
+    }
+}
+
+TEST(match_sides, topK) {
+    SidesDissimilarityMatrix matrix(5);
+    matrix(0, 1) = 7.0f;
+    matrix(0, 2) = 3.0f;
+    matrix(0, 3) = 5.0f;
+    matrix(0, 4) = 3.0f;
+
+    std::vector<SideCandidate> top = matrix.topK(0, 3);
+    ASSERT_EQ(top.size(), 3);
+    // ties are resolved in favour of the larger side index
+    EXPECT_EQ(top[0].side, 4);
+    EXPECT_EQ(top[1].side, 2);
+    EXPECT_EQ(top[2].side, 3);
+    EXPECT_EQ(top[2].difference, 5.0f);
+
+    EXPECT_EQ(matrix.topK(0, 10).size(), 4);
+    EXPECT_TRUE(matrix.topK(1, 10).empty());
+}
@@ -1,96 +1,337 @@
 #include "morphology.h"
 
 #include <algorithm>
+#include <cstddef>
+#include <vector>
 
 #include <libbase/runtime_assert.h>
+#include <libbase/timer.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 namespace morphology {
 
 static void check_binary_01_255(const image8u& src) {
     rassert(src.channels() == 1, "morphology expects 1-channel image", src.channels());
     for (int j = 0; j < src.height(); ++j) {
+        const std::uint8_t* row = src.row(j);
         for (int i = 0; i < src.width(); ++i) {
-            const std::uint8_t v = src(j, i);
-            rassert(v == 0 || v == 255, "morphology expects binary pixels {0,255}", int(v), j, i);
+            rassert(row[i] == 0 || row[i] == 255, "morphology expects binary pixels {0,255}", int(row[i]), j, i);
         }
     }
 }
 
-image8u erode(const image8u& src, int strength, bool with_openmp) {
-    rassert(strength >= 0, "erode: strength must be >= 0", strength);
-    check_binary_01_255(src);
+// Columns are processed in blocks of this width, so that the vertical pass works on short contiguous row segments
+static constexpr int COLUMNS_BLOCK = 256;
+
+// Running min/max (van Herk/Gil-Werman) with window 2r+1 along a sequence of n elements,
+// each element is a segment of `width` values (element e starts at src + e * src_step),
+// elements outside of [0, n) are zero (zero padding). Result for element e is written to dst + e * dst_step.
+// Sequence is split into blocks of 2r+1 elements with prefix (g) and suffix (h) extremums inside each block,
+// then any window is op(h[start], g[end]) - so it is 3 operations per element regardless of r.
+template <typename T, typename Op>
+static void running_extremum(const T* src, std::ptrdiff_t src_step, T* dst, std::ptrdiff_t dst_step,
+                             int n, int width, int r, Op op, std::vector<T>& g, std::vector<T>& h) {
+    const int k = 2 * r + 1;
+    const int padded = ((n + 2 * r + k - 1) / k) * k;
+    g.resize(static_cast<std::size_t>(padded) * width);
+    h.resize(static_cast<std::size_t>(padded) * width);
+
+    auto value = [&](int q) -> const T* {
+        const int e = q - r;
+        return (e >= 0 && e < n) ? src + e * src_step : nullptr;
+    };
 
+    for (int q = 0; q < padded; ++q) {
+        const T* v = value(q);
+        T* gq = g.data() + static_cast<std::size_t>(q) * width;
+        if (q % k == 0) {
+            for (int x = 0; x < width; ++x) gq[x] = v ? v[x] : 0;
+        } else {
+            const T* gp = gq - width;
+            for (int x = 0; x < width; ++x) gq[x] = op(gp[x], v ? v[x] : T(0));
+        }
+    }
+    for (int q = padded - 1; q >= 0; --q) {
+        const T* v = value(q);
+        T* hq = h.data() + static_cast<std::size_t>(q) * width;
+        if (q % k == k - 1) {
+            for (int x = 0; x < width; ++x) hq[x] = v ? v[x] : 0;
+        } else {
+            const T* hn = hq + width;
+            for (int x = 0; x < width; ++x) hq[x] = op(hn[x], v ? v[x] : T(0));
+        }
+    }
+
+    // window of element e in padded coordinates is [e, e + 2r]
+    for (int e = 0; e < n; ++e) {
+        const T* he = h.data() + static_cast<std::size_t>(e) * width;
+        const T* ge = g.data() + static_cast<std::size_t>(e + 2 * r) * width;
+        T* out = dst + e * dst_step;
+        for (int x = 0; x < width; ++x) out[x] = op(he[x], ge[x]);
+    }
+}
+
+// Square (2r+1)x(2r+1) min/max filter with zero padding - separable: rows first, then columns
+template <typename Op>
+static image8u square_extremum(const image8u& src, int r, Op op, bool with_openmp) {
     const int w = src.width();
     const int h = src.height();
+    const std::ptrdiff_t stride = static_cast<std::ptrdiff_t>(src.stride_elements());
 
-    image8u dst(w, h, 1);
+    image8u tmp(w, h, 1, ImageInit::Uninitialized);
+    #pragma omp parallel if(with_openmp)
+    {
+        std::vector<std::uint8_t> g, hb;
+        #pragma omp for
+        for (int j = 0; j < h; ++j) {
+            running_extremum(src.row(j), 1, tmp.row(j), 1, w, 1, r, op, g, hb);
+        }
+    }
 
-    if (strength == 0) {
-        dst = src;
-        return dst;
+    image8u dst(w, h, 1, ImageInit::Uninitialized);
+    const int blocks = (w + COLUMNS_BLOCK - 1) / COLUMNS_BLOCK;
+    #pragma omp parallel if(with_openmp)
+    {
+        std::vector<std::uint8_t> g, hb;
+        #pragma omp for
+        for (int block = 0; block < blocks; ++block) {
+            const int x0 = block * COLUMNS_BLOCK;
+            const int bw = std::min(COLUMNS_BLOCK, w - x0);
+            running_extremum(tmp.data() + x0, stride, dst.data() + x0, stride, h, bw, r, op, g, hb);
+        }
     }
+    return dst;
+}
 
-    #pragma omp parallel for if(with_openmp)
-    for (int j = 0; j < h; ++j) {
-        for (int i = 0; i < w; ++i) {
-            // Zero padding: if the neighborhood goes outside, erosion must be 0.
-            if (j - strength < 0 || j + strength >= h || i - strength < 0 || i + strength >= w) {
-                dst(j, i) = 0;
-                continue;
-            }
+static std::uint8_t min_u8(std::uint8_t a, std::uint8_t b) { return std::min(a, b); }
+static std::uint8_t max_u8(std::uint8_t a, std::uint8_t b) { return std::max(a, b); }
+
+static std::uint64_t and_u64(std::uint64_t a, std::uint64_t b) { return a & b; }
+static std::uint64_t or_u64(std::uint64_t a, std::uint64_t b) { return a | b; }
 
-            bool all_on = true;
-            for (int y = j - strength; y <= j + strength && all_on; ++y) {
-                for (int x = i - strength; x <= i + strength; ++x) {
-                    if (src(y, x) == 0) {
-                        all_on = false;
-                        break;
-                    }
-                }
+// dst[x] = src[x + s] - bits move towards smaller x, zeros come from the right
+static void shift_towards_smaller_x(const std::uint64_t* src, std::uint64_t* dst, int words, int s) {
+    const int ws = s / BinaryMask::WORD_BITS;
+    const int bs = s % BinaryMask::WORD_BITS;
+    for (int k = 0; k < words; ++k) {
+        const std::uint64_t lo = (k + ws < words) ? src[k + ws] : 0;
+        const std::uint64_t hi = (k + ws + 1 < words) ? src[k + ws + 1] : 0;
+        dst[k] = bs == 0 ? lo : ((lo >> bs) | (hi << (BinaryMask::WORD_BITS - bs)));
+    }
+}
+
+// dst[x] = src[x - s] - bits move towards larger x, zeros come from the left
+static void shift_towards_larger_x(const std::uint64_t* src, std::uint64_t* dst, int words, int s) {
+    const int ws = s / BinaryMask::WORD_BITS;
+    const int bs = s % BinaryMask::WORD_BITS;
+    for (int k = 0; k < words; ++k) {
+        const std::uint64_t hi = (k - ws >= 0) ? src[k - ws] : 0;
+        const std::uint64_t lo = (k - ws - 1 >= 0) ? src[k - ws - 1] : 0;
+        dst[k] = bs == 0 ? hi : ((hi << bs) | (lo >> (BinaryMask::WORD_BITS - bs)));
+    }
+}
+
+// window[x] = op over row[x], row[x +- 1], ..., row[x +- (len - 1)] (sign is given by the shift), zero padding.
+// Windows are doubled (len 1, 2, 4, ...) and the last one is covered by two overlapping windows,
+// so it is O(log len) word operations per word.
+template <typename Op, typename Shift>
+static void row_window(const std::uint64_t* row, std::uint64_t* window, std::uint64_t* tmp, int words, int len, Op op, Shift shift) {
+    std::copy(row, row + words, window);
+    int covered = 1;
+    while (2 * covered <= len) {
+        shift(window, tmp, words, covered);
+        for (int k = 0; k < words; ++k) window[k] = op(window[k], tmp[k]);
+        covered *= 2;
+    }
+    if (covered < len) {
+        shift(window, tmp, words, len - covered);
+        for (int k = 0; k < words; ++k) window[k] = op(window[k], tmp[k]);
+    }
+}
+
+// Rows of a strip: op of backward window [x - r, x] and forward window [x, x + r], src may be equal to dst
+template <typename Op>
+static void horizontal_pass(const std::uint64_t* src, std::uint64_t* dst, int rows, int words, int r, std::uint64_t tail, Op op,
+                            std::vector<std::uint64_t>& forward, std::vector<std::uint64_t>& backward, std::vector<std::uint64_t>& tmp) {
+    forward.resize(words);
+    backward.resize(words);
+    tmp.resize(words);
+    for (int j = 0; j < rows; ++j) {
+        const std::uint64_t* row = src + static_cast<std::size_t>(j) * words;
+        row_window(row, forward.data(), tmp.data(), words, r + 1, op, shift_towards_smaller_x);
+        row_window(row, backward.data(), tmp.data(), words, r + 1, op, shift_towards_larger_x);
+        std::uint64_t* out = dst + static_cast<std::size_t>(j) * words;
+        for (int k = 0; k < words; ++k) out[k] = op(forward[k], backward[k]);
+        out[words - 1] &= tail;
+    }
+}
+
+// Columns of a strip: the same running extremum as for image8u, but over words
+template <typename Op>
+static void vertical_pass(const std::uint64_t* src, std::uint64_t* dst, int rows, int words, int r, Op op,
+                          std::vector<std::uint64_t>& g, std::vector<std::uint64_t>& h) {
+    const int words_block = std::max(1, COLUMNS_BLOCK / BinaryMask::WORD_BITS);
+    for (int k0 = 0; k0 < words; k0 += words_block) {
+        const int bw = std::min(words_block, words - k0);
+        running_extremum(src + k0, words, dst + k0, words, rows, bw, r, op, g, h);
+    }
+}
+
+// One strip buffer (with halo) should stay in L2 cache
+static constexpr std::size_t STRIP_BYTES = 256 * 1024;
+static constexpr int STRIP_MIN_ROWS = 16;
+
+// Per-thread buffers of the pipeline: two strips (horizontal pass result and vertical pass result) + row/column temporaries
+struct StripScratch {
+    std::vector<std::uint64_t> horizontal, vertical;
+    std::vector<std::uint64_t> forward, backward, tmp, g, h;
+};
+
+// Computes rows [y0, y1) of the pipeline result. Strip starts with rows [y0 - halo, y1 + halo) of the source,
+// each stage with strength r makes r rows on both sides invalid (their windows leave the strip) - except the sides
+// that are on the image border, there zero padding is the correct answer.
+static void run_strip(const BinaryMask& src, BinaryMask& dst, int y0, int y1, const std::vector<Stage>& stages, int halo,
+                      StripScratch& s, std::vector<double>& stage_seconds) {
+    const int h = src.height();
+    const int words = src.words_per_row();
+    const std::uint64_t tail = BinaryMask::tail_mask(src.width());
+
+    int a = std::max(0, y0 - halo);
+    int b = std::min(h, y1 + halo);
+    s.horizontal.resize(static_cast<std::size_t>(b - a) * words);
+    s.vertical.resize(static_cast<std::size_t>(b - a) * words);
+
+    const std::uint64_t* in = src.row(a);
+    for (std::size_t k = 0; k < stages.size(); ++k) {
+        const int r = stages[k].strength;
+        if (r == 0) continue;
+
+        Timer t;
+        const int rows = b - a;
+        if (stages[k].operation == Operation::Erode) {
+            horizontal_pass(in, s.horizontal.data(), rows, words, r, tail, and_u64, s.forward, s.backward, s.tmp);
+            vertical_pass(s.horizontal.data(), s.vertical.data(), rows, words, r, and_u64, s.g, s.h);
+        } else {
+            horizontal_pass(in, s.horizontal.data(), rows, words, r, tail, or_u64, s.forward, s.backward, s.tmp);
+            vertical_pass(s.horizontal.data(), s.vertical.data(), rows, words, r, or_u64, s.g, s.h);
+        }
+
+        const int valid_a = (a == 0) ? 0 : a + r;
+        const int valid_b = (b == h) ? h : b - r;
+        in = s.vertical.data() + static_cast<std::size_t>(valid_a - a) * words;
+        a = valid_a;
+        b = valid_b;
+        stage_seconds[k] += t.elapsed();
+    }
+    rassert(a <= y0 && y1 <= b, 8123749812301, a, b, y0, y1);
+
+    std::copy(in + static_cast<std::size_t>(y0 - a) * words, in + static_cast<std::size_t>(y1 - a) * words, dst.row(y0));
+}
+
+const char* operation_name(Operation operation) {
+    return operation == Operation::Erode ? "erode" : "dilate";
+}
+
+BinaryMask pipeline(const BinaryMask& src, const std::vector<Stage>& stages, PipelineTimings* timings, bool with_openmp) {
+    Timer total;
+    int halo = 0;
+    for (const Stage& stage : stages) {
+        rassert(stage.strength >= 0, 8123749812302, operation_name(stage.operation), stage.strength);
+        halo += stage.strength;
+    }
+
+    std::vector<double> stage_seconds(stages.size(), 0.0);
+    BinaryMask dst(src.width(), src.height());
+    const int h = src.height();
+    const int words = src.words_per_row();
+
+    if (halo == 0 || words == 0 || h == 0) {
+        dst = src;
+    } else {
+        int threads = 1;
+#ifdef _OPENMP
+        if (with_openmp) threads = omp_get_max_threads();
+#endif
+        // strips fit in cache, but there are at least as many strips as threads and strips are not much thinner than the halo
+        const int cache_rows = static_cast<int>(STRIP_BYTES / (static_cast<std::size_t>(words) * sizeof(std::uint64_t)));
+        const int rows_per_thread = (h + threads - 1) / threads;
+        const int strip_rows = std::max({STRIP_MIN_ROWS, 2 * halo, std::min(cache_rows, rows_per_thread)});
+        const int strips = (h + strip_rows - 1) / strip_rows;
+
+        #pragma omp parallel if(with_openmp)
+        {
+            StripScratch scratch;
+            std::vector<double> thread_stage_seconds(stages.size(), 0.0);
+            #pragma omp for schedule(dynamic)
+            for (int strip = 0; strip < strips; ++strip) {
+                const int y0 = strip * strip_rows;
+                const int y1 = std::min(h, y0 + strip_rows);
+                run_strip(src, dst, y0, y1, stages, halo, scratch, thread_stage_seconds);
+            }
+            #pragma omp critical
+            for (std::size_t k = 0; k < stages.size(); ++k) {
+                stage_seconds[k] += thread_stage_seconds[k];
             }
-            dst(j, i) = all_on ? 255 : 0;
         }
     }
 
+    if (timings) {
+        timings->stage_seconds = stage_seconds;
+        timings->total_seconds = total.elapsed();
+    }
     return dst;
 }
 
+image8u pipeline(const image8u& src, const std::vector<Stage>& stages, PipelineTimings* timings, bool with_openmp) {
+    rassert(src.channels() == 1, "morphology expects 1-channel image", src.channels());
+    // pixels are validated once - while packing
+    return pipeline(BinaryMask(src), stages, timings, with_openmp).toImage();
+}
+
+image8u erode(const image8u& src, int strength, bool with_openmp) {
+    rassert(strength >= 0, "erode: strength must be >= 0", strength);
+    check_binary_01_255(src);
+
+    if (strength == 0) {
+        return src;
+    }
+
+    // Zero padding: if the neighborhood goes outside, erosion is 0 (the minimum includes padded zeros)
+    return square_extremum(src, strength, min_u8, with_openmp);
+}
+
 image8u dilate(const image8u& src, int strength, bool with_openmp) {
     rassert(strength >= 0, "dilate: strength must be >= 0", strength);
     check_binary_01_255(src);
 
-    const int w = src.width();
-    const int h = src.height();
+    if (strength == 0) {
+        return src;
+    }
+
+    return square_extremum(src, strength, max_u8, with_openmp);
+}
+
+BinaryMask erode(const BinaryMask& src, int strength, bool with_openmp) {
+    rassert(strength >= 0, "erode: strength must be >= 0", strength);
+
+    if (strength == 0) {
+        return src;
+    }
 
-    image8u dst(w, h, 1);
+    return pipeline(src, {{Operation::Erode, strength}}, nullptr, with_openmp);
+}
+
+BinaryMask dilate(const BinaryMask& src, int strength, bool with_openmp) {
+    rassert(strength >= 0, "dilate: strength must be >= 0", strength);
 
     if (strength == 0) {
-        dst = src;
-        return dst;
-    }
-
-    #pragma omp parallel for if(with_openmp)
-    for (int j = 0; j < h; ++j) {
-        for (int i = 0; i < w; ++i) {
-            const int y0 = std::max(0, j - strength);
-            const int y1 = std::min(h - 1, j + strength);
-            const int x0 = std::max(0, i - strength);
-            const int x1 = std::min(w - 1, i + strength);
-
-            bool any_on = false;
-            for (int y = y0; y <= y1 && !any_on; ++y) {
-                for (int x = x0; x <= x1; ++x) {
-                    if (src(y, x) == 255) {
-                        any_on = true;
-                        break;
-                    }
-                }
-            }
-            dst(j, i) = any_on ? 255 : 0;
-        }
+        return src;
     }
 
-    return dst;
+    return pipeline(src, {{Operation::Dilate, strength}}, nullptr, with_openmp);
 }
 
-} // namespace morphology
\ No newline at end of file
+} // namespace morphology
@@ -1,7 +1,9 @@
 #pragma once
 
 #include <cstdint>
+#include <vector>
 
+#include <libimages/binary_mask.h>
 #include <libimages/image.h>
 
 namespace morphology {
@@ -11,8 +13,39 @@ namespace morphology {
     // Border handling: zero-padding outside the image.
     //
     // strength == 0 -> returns a copy.
+    //
+    // Implemented as separable running min/max (van Herk/Gil-Werman): cost per pixel doesn't depend on strength.
 
     image8u erode(const image8u& src, int strength, bool with_openmp=true);
     image8u dilate(const image8u& src, int strength, bool with_openmp=true);
 
+    // The same for bit-packed masks (no need to validate pixels): rows are processed with word-parallel
+    // shifts (O(log strength) word operations per 64 pixels), columns - with running AND/OR over words.
+    BinaryMask erode(const BinaryMask& src, int strength, bool with_openmp=true);
+    BinaryMask dilate(const BinaryMask& src, int strength, bool with_openmp=true);
+
+    enum class Operation { Erode, Dilate };
+
+    const char* operation_name(Operation operation);
+
+    struct Stage {
+        Operation operation;
+        int strength;
+    };
+
+    struct PipelineTimings {
+        std::vector<double> stage_seconds; // time of each stage summed over all strips (and threads)
+        double total_seconds = 0.0;        // wall time of the whole pipeline
+    };
+
+    // Applies stages one after another, f.e. {{Dilate, 6}, {Erode, 6}} is closing.
+    // Result is the same as of the sequence of erode/dilate calls, but the image is processed in horizontal strips
+    // (that fit in cache) with all stages fused: each strip is read with a halo of sum(strength) rows,
+    // then ping-pongs between two per-thread strip buffers - no full-size intermediate masks.
+    BinaryMask pipeline(const BinaryMask& src, const std::vector<Stage>& stages,
+                        PipelineTimings* timings=nullptr, bool with_openmp=true);
+    // The same for 0/255 image: it is validated and packed once
+    image8u pipeline(const image8u& src, const std::vector<Stage>& stages,
+                     PipelineTimings* timings=nullptr, bool with_openmp=true);
+
 } // namespace morphology
\ No newline at end of file
@@ -2,10 +2,12 @@
 
 #include <filesystem>
 #include <string>
+#include <vector>
 
 #include <gtest/gtest.h>
 
 #include <libbase/configure_working_directory.h>
+#include <libbase/fast_random.h>
 #include <libimages/debug_io.h>
 #include <libimages/image.h>
 #include <libimages/image_io.h>
@@ -35,6 +37,117 @@ static int count_white(const image8u& img) {
     return cnt;
 }
 
+static image8u make_random_mask(int w, int h, int white_percent, uint32_t seed) {
+    FastRandom r(seed);
+    image8u img(w, h, 1);
+    for (int j = 0; j < h; ++j)
+        for (int i = 0; i < w; ++i)
+            img(j, i) = r.nextInt(0, 99) < white_percent ? 255 : 0;
+    return img;
+}
+
+// Straightforward (2r+1)^2 window scan - the reference for the fast implementation
+static image8u reference_morphology(const image8u& src, int r, bool is_erode) {
+    const int w = src.width();
+    const int h = src.height();
+    image8u dst(w, h, 1);
+    for (int j = 0; j < h; ++j) {
+        for (int i = 0; i < w; ++i) {
+            bool all_white = true;
+            bool any_white = false;
+            for (int dj = -r; dj <= r; ++dj) {
+                for (int di = -r; di <= r; ++di) {
+                    const int y = j + dj;
+                    const int x = i + di;
+                    const bool white = x >= 0 && x < w && y >= 0 && y < h && src(y, x) == 255;
+                    all_white = all_white && white;
+                    any_white = any_white || white;
+                }
+            }
+            dst(j, i) = (is_erode ? all_white : any_white) ? 255 : 0;
+        }
+    }
+    return dst;
+}
+
+static void expect_equal_masks(const image8u& a, const image8u& b) {
+    ASSERT_EQ(a.width(), b.width());
+    ASSERT_EQ(a.height(), b.height());
+    for (int j = 0; j < a.height(); ++j)
+        for (int i = 0; i < a.width(); ++i)
+            ASSERT_EQ(a(j, i), b(j, i)) << "at (" << j << ", " << i << ")";
+}
+
+TEST(morphology, EqualsReference_RandomMasks) {
+    const int sizes[][2] = {{1, 1}, {7, 3}, {37, 29}, {300, 41}, {13, 290}};
+    const int white_percents[] = {10, 50, 95};
+    const int radii[] = {1, 2, 3, 6, 20};
+    uint32_t seed = 239;
+    for (const auto& size : sizes) {
+        for (int white_percent : white_percents) {
+            const image8u in = make_random_mask(size[0], size[1], white_percent, seed++);
+            for (int r : radii) {
+                for (bool with_openmp : {false, true}) {
+                    SCOPED_TRACE(std::to_string(size[0]) + "x" + std::to_string(size[1]) + " r=" + std::to_string(r));
+                    expect_equal_masks(morphology::erode(in, r, with_openmp), reference_morphology(in, r, true));
+                    expect_equal_masks(morphology::dilate(in, r, with_openmp), reference_morphology(in, r, false));
+                }
+            }
+        }
+    }
+}
+
+TEST(morphology, BinaryMaskEqualsImage) {
+    const int sizes[][2] = {{1, 1}, {64, 3}, {65, 40}, {200, 33}, {7, 150}};
+    const int radii[] = {1, 2, 6, 31, 32, 70};
+    uint32_t seed = 2391;
+    for (const auto& size : sizes) {
+        for (int white_percent : {10, 50, 95}) {
+            const image8u in = make_random_mask(size[0], size[1], white_percent, seed++);
+            const BinaryMask bits(in);
+            for (int r : radii) {
+                for (bool with_openmp : {false, true}) {
+                    SCOPED_TRACE(std::to_string(size[0]) + "x" + std::to_string(size[1]) + " r=" + std::to_string(r));
+                    expect_equal_masks(morphology::erode(bits, r, with_openmp).toImage(), morphology::erode(in, r, with_openmp));
+                    expect_equal_masks(morphology::dilate(bits, r, with_openmp).toImage(), morphology::dilate(in, r, with_openmp));
+                }
+            }
+        }
+    }
+}
+
+TEST(morphology, PipelineEqualsSequenceOfCalls) {
+    using morphology::Operation;
+    const std::vector<morphology::Stage> stages = {
+        {Operation::Dilate, 6}, {Operation::Erode, 6}, {Operation::Erode, 6}, {Operation::Dilate, 6}, {Operation::Erode, 2}};
+    // narrow and very wide images: the wide one doesn't fit in cache, so it is processed in many strips
+    const int sizes[][2] = {{1, 1}, {100, 90}, {300, 7}, {64 * 1024, 150}};
+    uint32_t seed = 17;
+    for (const auto& size : sizes) {
+        const image8u in = make_random_mask(size[0], size[1], 60, seed++);
+        image8u expected = in;
+        for (const auto& stage : stages) {
+            expected = stage.operation == Operation::Erode ? morphology::erode(expected, stage.strength)
+                                                           : morphology::dilate(expected, stage.strength);
+        }
+
+        for (bool with_openmp : {false, true}) {
+            SCOPED_TRACE(std::to_string(size[0]) + "x" + std::to_string(size[1]));
+            morphology::PipelineTimings timings;
+            const BinaryMask result = morphology::pipeline(BinaryMask(in), stages, &timings, with_openmp);
+            expect_equal_masks(result.toImage(), expected);
+            ASSERT_EQ(timings.stage_seconds.size(), stages.size());
+            for (double seconds : timings.stage_seconds) {
+                EXPECT_GE(seconds, 0.0);
+            }
+            EXPECT_GE(timings.total_seconds, 0.0);
+
+            expect_equal_masks(morphology::pipeline(in, stages, nullptr, with_openmp), expected);
+        }
+    }
+    EXPECT_EQ(morphology::pipeline(BinaryMask(make_random_mask(10, 10, 50, 1)), {}), BinaryMask(make_random_mask(10, 10, 50, 1)));
+}
+
 TEST(morphology, SquareErodeDilate_R2) {
     configureWorkingDirectory();
 
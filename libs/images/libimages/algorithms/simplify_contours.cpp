@@ -8,10 +8,26 @@
 #include <limits>
 #include <queue>
 #include <tuple>
+#include <utility>
 #include <vector>
 
 namespace {
 
+double dist2_point_to_line(point2f p, point2f a, point2f b) {
+    const double vx = static_cast<double>(b.x) - a.x;
+    const double vy = static_cast<double>(b.y) - a.y;
+    const double wx = static_cast<double>(p.x) - a.x;
+    const double wy = static_cast<double>(p.y) - a.y;
+
+    const double vv = vx * vx + vy * vy;
+    if (vv == 0.0) {
+        return wx * wx + wy * wy;
+    }
+
+    const double cross = vx * wy - vy * wx;
+    return cross * cross / vv;
+}
+
 double dist2_point_to_line(point2i p, point2i a, point2i b) {
     const long long vx = static_cast<long long>(b.x) - a.x;
     const long long vy = static_cast<long long>(b.y) - a.y;
@@ -39,11 +55,10 @@ struct HeapItem {
     }
 };
 
-} // namespace
-
-std::vector<point2i> simplifyContour(const std::vector<point2i> &contour, size_t targetVertexSize) {
+template <typename T>
+std::vector<int> simplifyContourIndicesImpl(const std::vector<point2<T>> &contour, size_t targetVertexSize) {
     const int n = contour.size();
-    std::vector<point2i> result;
+    std::vector<int> result;
 
     // DONE нам дан контур - это зацикленный обход границы объекта по пикселям
     // нам надо его упростить до targetVertexSize вершин (у нас это число будет всегда равно 4)
@@ -57,7 +72,11 @@ std::vector<point2i> simplifyContour(const std::vector<point2i> &contour, size_t
     // тогда в конечном итоге останутся вершины на углах
 
     if (targetVertexSize == 0 || contour.empty()) return {};
-    if (static_cast<size_t>(n) <= targetVertexSize) return contour;
+    if (static_cast<size_t>(n) <= targetVertexSize) {
+        result.resize(n);
+        for (int i = 0; i < n; ++i) result[i] = i;
+        return result;
+    }
 
     std::vector<int> prev(n), next(n);
     std::vector<bool> alive(n, true);
@@ -125,13 +144,189 @@ std::vector<point2i> simplifyContour(const std::vector<point2i> &contour, size_t
 
     int cur = start;
     do {
-        result.push_back(contour[cur]);
+        result.push_back(cur);
         cur = next[cur];
     } while (cur != start && static_cast<int>(result.size()) <= aliveCount + 1);
 
     return result;
 }
 
+double cross(point2f o, point2f a, point2f b) {
+    return (static_cast<double>(a.x) - o.x) * (static_cast<double>(b.y) - o.y)
+         - (static_cast<double>(a.y) - o.y) * (static_cast<double>(b.x) - o.x);
+}
+
+double cross(point2i o, point2i a, point2i b) {
+    return static_cast<double>((static_cast<long long>(a.x) - o.x) * (static_cast<long long>(b.y) - o.y)
+                             - (static_cast<long long>(a.y) - o.y) * (static_cast<long long>(b.x) - o.x));
+}
+
+// Indices of the contour points that can be convex hull vertices, sorted by (y, x).
+// For a pixel contour these are only the leftmost and the rightmost points of each row - a bucket pass instead of a sort.
+std::vector<int> hullCandidatesSortedByYX(const std::vector<point2i> &contour) {
+    int y0 = contour[0].y;
+    int y1 = contour[0].y;
+    for (point2i p: contour) {
+        y0 = std::min(y0, p.y);
+        y1 = std::max(y1, p.y);
+    }
+    std::vector<int> leftmost(y1 - y0 + 1, -1);
+    std::vector<int> rightmost(y1 - y0 + 1, -1);
+    for (int i = 0; i < static_cast<int>(contour.size()); ++i) {
+        const int row = contour[i].y - y0;
+        if (leftmost[row] == -1 || contour[i].x < contour[leftmost[row]].x) leftmost[row] = i;
+        if (rightmost[row] == -1 || contour[i].x > contour[rightmost[row]].x) rightmost[row] = i;
+    }
+    std::vector<int> candidates;
+    candidates.reserve(2 * leftmost.size());
+    for (std::size_t row = 0; row < leftmost.size(); ++row) {
+        if (leftmost[row] == -1) continue;
+        candidates.push_back(leftmost[row]);
+        if (contour[rightmost[row]].x != contour[leftmost[row]].x) candidates.push_back(rightmost[row]);
+    }
+    return candidates;
+}
+
+std::vector<int> hullCandidatesSortedByYX(const std::vector<point2f> &contour) {
+    std::vector<int> candidates(contour.size());
+    for (int i = 0; i < static_cast<int>(contour.size()); ++i) candidates[i] = i;
+    std::sort(candidates.begin(), candidates.end(), [&](int a, int b) {
+        return std::tie(contour[a].y, contour[a].x) < std::tie(contour[b].y, contour[b].x);
+    });
+    return candidates;
+}
+
+// Convex hull (monotone chain over the sorted candidates) as indices into the contour, collinear points are dropped.
+template <typename T>
+std::vector<int> convexHull(const std::vector<point2<T>> &contour) {
+    const std::vector<int> candidates = hullCandidatesSortedByYX(contour);
+    const int m = candidates.size();
+    if (m < 3) return candidates;
+
+    std::vector<int> hull(2 * m);
+    int k = 0;
+    for (int i = 0; i < m; ++i) {
+        while (k >= 2 && cross(contour[hull[k - 2]], contour[hull[k - 1]], contour[candidates[i]]) <= 0) --k;
+        hull[k++] = candidates[i];
+    }
+    for (int i = m - 2, lower = k + 1; i >= 0; --i) {
+        while (k >= lower && cross(contour[hull[k - 2]], contour[hull[k - 1]], contour[candidates[i]]) <= 0) --k;
+        hull[k++] = candidates[i];
+    }
+    hull.resize(k - 1);
+    return hull;
+}
+
+template <typename T>
+std::vector<int> findQuadCornerIndicesImpl(const std::vector<point2<T>> &contour) {
+    if (contour.size() <= 4) return simplifyContourIndicesImpl(contour, 4);
+
+    const std::vector<int> hull = convexHull(contour);
+    const int h = hull.size();
+    // Degenerate (f.e. a segment) contour: leave it to the general algorithm.
+    if (h < 4) return simplifyContourIndicesImpl(contour, 4);
+
+    // Doubled area of a triangle of hull vertices, indices are taken modulo h.
+    auto area2 = [&](int a, int b, int c) {
+        return std::abs(cross(contour[hull[a % h]], contour[hull[b % h]], contour[hull[c % h]]));
+    };
+
+    // Max-area quadrilateral inscribed in the hull: for a diagonal (i, k) the best vertices j between them
+    // and l after k only move forward while k grows (the area of a triangle over the diagonal is unimodal
+    // along a convex chain), so it is O(h^2) in total.
+    double best = -1.0;
+    int best_quad[4] = {0, 1, 2, 3};
+    for (int i = 0; i < h; ++i) {
+        int j = i + 1;
+        int l = i + 3;
+        for (int k = i + 2; k <= i + h - 2; ++k) {
+            while (j + 1 < k && area2(i, j + 1, k) >= area2(i, j, k)) ++j;
+            l = std::max(l, k + 1);
+            while (l + 1 < i + h && area2(i, k, l + 1) >= area2(i, k, l)) ++l;
+            const double area = area2(i, j, k) + area2(i, k, l);
+            if (area > best) {
+                best = area;
+                best_quad[0] = i;
+                best_quad[1] = j;
+                best_quad[2] = k;
+                best_quad[3] = l;
+            }
+        }
+    }
+
+    // Corners in contour order - as in simplifyContour.
+    std::vector<int> corner_idx(4);
+    for (int c = 0; c < 4; ++c) corner_idx[c] = hull[best_quad[c] % h];
+    std::sort(corner_idx.begin(), corner_idx.end());
+    return corner_idx;
+}
+
+template <typename T>
+std::vector<point2<T>> pointsAt(const std::vector<point2<T>> &contour, const std::vector<int> &indices) {
+    std::vector<point2<T>> points;
+    points.reserve(indices.size());
+    for (int idx: indices) points.push_back(contour[idx]);
+    return points;
+}
+
+} // namespace
+
+std::vector<int> findQuadCornerIndices(const std::vector<point2i> &contour) {
+    return findQuadCornerIndicesImpl(contour);
+}
+
+std::vector<int> findQuadCornerIndices(const std::vector<point2f> &contour) {
+    return findQuadCornerIndicesImpl(contour);
+}
+
+std::vector<point2i> findQuadCorners(const std::vector<point2i> &contour) {
+    return pointsAt(contour, findQuadCornerIndicesImpl(contour));
+}
+
+std::vector<point2f> findQuadCorners(const std::vector<point2f> &contour) {
+    return pointsAt(contour, findQuadCornerIndicesImpl(contour));
+}
+
+std::vector<int> simplifyContourIndices(const std::vector<point2i> &contour, size_t targetVertexSize) {
+    return simplifyContourIndicesImpl(contour, targetVertexSize);
+}
+
+std::vector<int> simplifyContourIndices(const std::vector<point2f> &contour, size_t targetVertexSize) {
+    return simplifyContourIndicesImpl(contour, targetVertexSize);
+}
+
+std::vector<point2i> simplifyContour(const std::vector<point2i> &contour, size_t targetVertexSize) {
+    return pointsAt(contour, simplifyContourIndicesImpl(contour, targetVertexSize));
+}
+
+std::vector<point2f> simplifyContour(const std::vector<point2f> &contour, size_t targetVertexSize) {
+    return pointsAt(contour, simplifyContourIndicesImpl(contour, targetVertexSize));
+}
+
+ContourSides::ContourSides(std::vector<point2i> contour, std::vector<int> cornerIndices)
+    : points_(std::move(contour)), corners_(std::move(cornerIndices))
+{
+    rassert(!points_.empty(), 918273652);
+    rassert(corners_.size() >= 2, 918273653, corners_.size());
+    const int n = points_.size();
+    for (std::size_t k = 0; k < corners_.size(); ++k) {
+        rassert(corners_[k] >= 0 && corners_[k] < n, 918273654, corners_[k], n);
+        rassert(k == 0 || corners_[k - 1] < corners_[k], 918273655, "corner indices must be ascending");
+    }
+
+    // the side from the last corner to the first one wraps around the end of the contour - the points up to
+    // the first corner are repeated after the end, so this side is contiguous too
+    contour_size_ = n;
+    points_.reserve(n + corners_[0] + 1);
+    for (int i = 0; i <= corners_[0]; ++i) points_.push_back(points_[i]);
+    corners_.push_back(n + corners_[0]);
+}
+
+std::span<const point2i> ContourSides::side(int k) const {
+    rassert(k >= 0 && k < count(), 918273656, k);
+    return {points_.data() + corners_[k], static_cast<std::size_t>(corners_[k + 1] - corners_[k] + 1)};
+}
+
 std::vector<std::vector<point2i>> splitContourByCorners(
     const std::vector<point2i> &contour,
     const std::vector<point2i> &corners)
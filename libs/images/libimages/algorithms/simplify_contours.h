@@ -2,8 +2,53 @@
 
 #include <libbase/point2.h>
 
+#include <span>
 #include <vector>
 
 std::vector<point2i> simplifyContour(const std::vector<point2i> &contour, size_t targetVertexSize);
 
+// the same, but returns ascending indices of the remaining vertices in the contour
+std::vector<int> simplifyContourIndices(const std::vector<point2i> &contour, size_t targetVertexSize);
+std::vector<int> simplifyContourIndices(const std::vector<point2f> &contour, size_t targetVertexSize);
+
+// the same for a subpixel contour (f.e. from extractContourSubpixel)
+std::vector<point2f> simplifyContour(const std::vector<point2f> &contour, size_t targetVertexSize);
+
+// 4 corners of a quadrilateral piece (like simplifyContour(contour, 4), but without eliminating contour points
+// one by one through a heap): vertices of the max-area quadrilateral inscribed in the convex hull of the contour,
+// in contour order. The hull of a pixel contour is built in linear time and has h << n vertices, the quadrilateral
+// is then found in O(h^2).
+std::vector<point2i> findQuadCorners(const std::vector<point2i> &contour);
+std::vector<point2f> findQuadCorners(const std::vector<point2f> &contour);
+
+// the same, but returns ascending indices of the corners in the contour
+std::vector<int> findQuadCornerIndices(const std::vector<point2i> &contour);
+std::vector<int> findQuadCornerIndices(const std::vector<point2f> &contour);
+
+// Closed contour split into sides by corner indices (f.e. from findQuadCornerIndices). All sides are spans over
+// one point buffer: side k goes from corner k to corner k + 1 including both of them (as in splitContourByCorners),
+// so sides are taken without searching the corners in the contour and without copying their points.
+class ContourSides final {
+public:
+    ContourSides() = default;
+    // cornerIndices must be ascending
+    ContourSides(std::vector<point2i> contour, std::vector<int> cornerIndices);
+
+    int count() const { return corners_.empty() ? 0 : static_cast<int>(corners_.size()) - 1; }
+    std::span<const point2i> side(int k) const;
+
+    // index of corner k in the contour (the start of side k)
+    int corner_index(int k) const { return corners_[k] % contour_size_; }
+    point2i corner(int k) const { return points_[corners_[k]]; }
+
+    // the contour itself (without the repeated points of the buffer)
+    std::span<const point2i> contour() const { return {points_.data(), static_cast<std::size_t>(contour_size_)}; }
+
+private:
+    std::vector<point2i> points_;   // the contour and then its points up to the first corner once more
+    std::vector<int> corners_;      // ascending corner indices in points_, the last one is the first corner repeated
+    int contour_size_ = 0;
+};
+
+// sides with copied points, corners are searched in the contour - see ContourSides to avoid both
 std::vector<std::vector<point2i>> splitContourByCorners(const std::vector<point2i> &contour, const std::vector<point2i> &corners);
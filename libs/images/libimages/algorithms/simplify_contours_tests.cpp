@@ -3,11 +3,17 @@
 #include <gtest/gtest.h>
 
 #include <libimages/tests_utils.h>
+#include <libimages/algorithms/extract_contour.h>
 #include <libbase/configure_working_directory.h>
+#include <libbase/fast_random.h>
+#include <libbase/timer.h>
 #include <libimages/debug_io.h>
 #include <libimages/image.h>
 
 #include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
 #include <vector>
 
 namespace {
@@ -62,6 +68,47 @@ static image8u visualize(const std::vector<point2i>& contour,
     return img;
 }
 
+// Pixel contour of a random convex quadrilateral (a rotated square with jittered corners) inside a size x size image.
+static std::vector<point2i> makeRandomQuadContour(int size, FastRandom &r) {
+    const float c = 0.5f * size;
+    const float radius = 0.4f * size;
+    const float angle0 = r.nextFloat(0.0f, 1.57f);
+    point2f quad[4];
+    for (int k = 0; k < 4; ++k) {
+        const float angle = angle0 + k * 1.5708f + r.nextFloat(-0.15f, 0.15f);
+        const float rk = radius * r.nextFloat(0.85f, 1.0f);
+        quad[k] = point2f(c + rk * std::cos(angle), c + rk * std::sin(angle));
+    }
+
+    image8u mask(size, size, 1);
+    mask.fill(0);
+    for (int y = 0; y < size; ++y) {
+        for (int x = 0; x < size; ++x) {
+            bool inside = true;
+            for (int k = 0; k < 4 && inside; ++k) {
+                const point2f a = quad[k];
+                const point2f b = quad[(k + 1) % 4];
+                inside = (b.x - a.x) * (y - a.y) - (b.y - a.y) * (x - a.x) >= 0.0f;
+            }
+            if (inside) mask(y, x) = 255;
+        }
+    }
+    return traceContour(mask);
+}
+
+// Every expected corner has a corner within tolerance pixels (the order is not compared: a corner at the start
+// of the contour can be picked on either side of the wrap).
+static void expectCloseCorners(const std::vector<point2i> &corners, const std::vector<point2i> &expected, int tolerance) {
+    ASSERT_EQ(corners.size(), expected.size());
+    for (point2i e: expected) {
+        int best = std::numeric_limits<int>::max();
+        for (point2i c: corners) {
+            best = std::min(best, std::max(std::abs(c.x - e.x), std::abs(c.y - e.y)));
+        }
+        EXPECT_LE(best, tolerance) << e;
+    }
+}
+
 } // namespace
 
 TEST(simplify_contours, simplifyContour_rectangle_to_4_corners) {
@@ -92,6 +139,28 @@ TEST(simplify_contours, simplifyContour_rectangle_to_4_corners) {
     EXPECT_EQ(simplified, expected);
 }
 
+TEST(simplify_contours, simplifyContour_subpixel_rectangle_to_4_corners) {
+    configureWorkingDirectory();
+
+    const point2f shift(0.25f, 0.75f);
+
+    std::vector<point2f> contour;
+    for (point2i p: makeRectContour(point2i{2, 3}, point2i{7, 8})) {
+        contour.push_back(point2f(p.x, p.y) + shift);
+    }
+
+    auto simplified = simplifyContour(contour, 4);
+    ASSERT_EQ(simplified.size(), 4u);
+
+    std::vector<point2f> expected = {
+        point2f(2, 3) + shift,
+        point2f(6, 3) + shift,
+        point2f(6, 7) + shift,
+        point2f(2, 7) + shift,
+    };
+    EXPECT_TRUE(std::is_permutation(simplified.begin(), simplified.end(), expected.begin()));
+}
+
 TEST(simplify_contours, simplifyContour_target_ge_size_returns_same) {
     configureWorkingDirectory();
 
@@ -147,3 +216,99 @@ TEST(simplify_contours, splitContourByCorners_rectangle_sides) {
         debug_io::dump_image(getUnitCaseDebugDir() + "01_parts.jpg", img);
     }
 }
+
+TEST(simplify_contours, findQuadCorners_rectangle) {
+    const point2i from{2, 3};
+    const point2i to{7, 8};
+
+    auto contour = makeRectContour(from, to);
+    auto corners = findQuadCorners(contour);
+
+    std::vector<point2i> expected = {
+        {from.x, from.y},
+        {to.x - 1, from.y},
+        {to.x - 1, to.y - 1},
+        {from.x, to.y - 1},
+    };
+    EXPECT_EQ(corners, expected);
+    EXPECT_EQ(corners, simplifyContour(contour, 4));
+}
+
+TEST(simplify_contours, findQuadCorners_agreesWithSimplifyContour) {
+    configureWorkingDirectory();
+
+    FastRandom r(239);
+    for (int iter = 0; iter < 50; ++iter) {
+        const int size = r.nextInt(16, 200);
+        const std::vector<point2i> contour = makeRandomQuadContour(size, r);
+        const std::vector<point2i> corners = findQuadCorners(contour);
+        const std::vector<point2i> expected = simplifyContour(contour, 4);
+        if (iter == 0) {
+            debug_io::dump_image(getUnitCaseDebugDir() + "00_corners.png", visualize(contour, corners, size, size));
+        }
+        // on pixel steps near a corner the two criteria can pick neighboring pixels
+        expectCloseCorners(corners, expected, 2);
+    }
+}
+
+static void benchmarkFindQuadCorners(const std::vector<int> &sizes) {
+    FastRandom r(2391);
+    std::cout << "quad corners:" << std::endl;
+    for (int size: sizes) {
+        const std::vector<point2i> contour = makeRandomQuadContour(size, r);
+        Timer t;
+        const std::vector<point2i> expected = simplifyContour(contour, 4);
+        const double heap_seconds = t.elapsed();
+        t.restart();
+        const std::vector<point2i> corners = findQuadCorners(contour);
+        const double seconds = t.elapsed();
+        std::cout << "  contour of " << contour.size() << " points: heap elimination " << heap_seconds
+                  << " sec, convex hull " << seconds << " sec (x" << heap_seconds / seconds << ")" << std::endl;
+        expectCloseCorners(corners, expected, 2);
+    }
+}
+
+TEST(simplify_contours, benchmark_small) {
+    benchmarkFindQuadCorners({64, 128, 256, 512, 1024});
+}
+
+// contours of tens of thousands of points need large masks, run with --gtest_also_run_disabled_tests
+TEST(simplify_contours, DISABLED_benchmark_large) {
+    benchmarkFindQuadCorners({2048, 4096, 8192});
+}
+
+TEST(simplify_contours, contourSides_equalSplitContourByCorners) {
+    FastRandom r(239);
+    for (int iter = 0; iter < 20; ++iter) {
+        const int size = r.nextInt(16, 100);
+        // rotate the contour so that the side across its start wraps around the end of the buffer
+        std::vector<point2i> contour = makeRandomQuadContour(size, r);
+        std::rotate(contour.begin(), contour.begin() + r.nextInt(0, contour.size() - 1), contour.end());
+
+        const std::vector<int> corner_indices = findQuadCornerIndices(contour);
+        ASSERT_TRUE(std::is_sorted(corner_indices.begin(), corner_indices.end()));
+        ASSERT_EQ(findQuadCorners(contour), std::vector<point2i>({contour[corner_indices[0]], contour[corner_indices[1]],
+                                                                  contour[corner_indices[2]], contour[corner_indices[3]]}));
+
+        const std::vector<std::vector<point2i>> expected = splitContourByCorners(contour, findQuadCorners(contour));
+        const ContourSides sides(contour, corner_indices);
+        ASSERT_EQ(sides.count(), 4);
+        EXPECT_TRUE(std::equal(contour.begin(), contour.end(), sides.contour().begin(), sides.contour().end()));
+        for (int k = 0; k < sides.count(); ++k) {
+            EXPECT_EQ(sides.corner_index(k), corner_indices[k]);
+            EXPECT_EQ(sides.corner(k), contour[corner_indices[k]]);
+            const std::span<const point2i> side = sides.side(k);
+            EXPECT_TRUE(std::equal(side.begin(), side.end(), expected[k].begin(), expected[k].end()));
+        }
+    }
+}
+
+TEST(simplify_contours, simplifyContourIndices_rectangle) {
+    auto contour = makeRectContour(point2i{2, 3}, point2i{7, 8});
+    const std::vector<int> indices = simplifyContourIndices(contour, 4);
+    const std::vector<point2i> corners = simplifyContour(contour, 4);
+    ASSERT_EQ(indices.size(), corners.size());
+    for (std::size_t k = 0; k < indices.size(); ++k) {
+        EXPECT_EQ(contour[indices[k]], corners[k]);
+    }
+}
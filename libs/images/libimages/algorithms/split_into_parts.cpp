@@ -1,11 +1,9 @@
 #include "split_into_parts.h"
 
-#include <libbase/disjoint_set.h>
-#include <libbase/bbox2.h>
+#include <libimages/algorithms/connected_components.h>
 
 #include <algorithm>
 #include <cstddef>
-#include <limits>
 #include <tuple>
 #include <vector>
 
@@ -15,118 +13,106 @@ namespace {
 
 constexpr unsigned char kObject = 255;
 
-inline std::size_t linearIndex(int x, int y, int w) noexcept {
-    return static_cast<std::size_t>(y) * static_cast<std::size_t>(w) + static_cast<std::size_t>(x);
+// Paints runs of the component into a new mask of the component's bbox
+image8u paintComponentMask(const ConnectedComponents &components, int label, point2i offset, int w, int h) {
+    image8u mask(w, h, 1);
+    for (std::size_t k = 0; k < components.runs.size(); ++k) {
+        if (components.run_labels[k] != label) continue;
+        const PixelRun &run = components.runs[k];
+        std::uint8_t *row = mask.row(run.y - offset.y);
+        std::fill(row + (run.x0 - offset.x), row + (run.x1 - offset.x), kObject);
+    }
+    return mask;
 }
 
 } // namespace
 
-std::tuple<std::vector<point2i>, std::vector<image8u>, std::vector<image8u>> splitObjects(
-    const image8u &image, const image8u &objectsMask)
+std::tuple<std::vector<point2i>, std::vector<image8u_view>, std::vector<image8u>> splitObjects(
+    image8u_view image, const image8u &objectsMask)
+{
+    rassert(objectsMask.channels() == 1, 980123743, objectsMask.channels());
+    return splitObjects(image, BinaryMask(objectsMask));
+}
+
+std::tuple<std::vector<point2i>, std::vector<image8u_view>, std::vector<image8u>> splitObjects(
+    image8u_view image, const BinaryMask &objectsMask)
 {
     rassert(image.width() == objectsMask.width(), 980123741);
     rassert(image.height() == objectsMask.height(), 980123742);
 
-    const int w = image.width();
-    const int h = image.height();
-
-    const std::size_t n = static_cast<std::size_t>(w) * static_cast<std::size_t>(h);
-    DisjointSetUnion dsu(n);
-
-    // Build DSU for object pixels (8-connectivity).
-    for (int y = 0; y < h; ++y) {
-        for (int x = 0; x < w; ++x) {
-            if (objectsMask(y, x) != kObject) continue;
-
-            const std::size_t id = linearIndex(x, y, w);
-
-            // Left
-            if (x > 0 && objectsMask(y, x - 1) == kObject) {
-                dsu.unite(id, linearIndex(x - 1, y, w));
-            }
-            // Up
-            if (y > 0 && objectsMask(y - 1, x) == kObject) {
-                dsu.unite(id, linearIndex(x, y - 1, w));
-            }
-            // Up-left
-            if (x > 0 && y > 0 && objectsMask(y - 1, x - 1) == kObject) {
-                dsu.unite(id, linearIndex(x - 1, y - 1, w));
-            }
-            // Up-right
-            if (x + 1 < w && y > 0 && objectsMask(y - 1, x + 1) == kObject) {
-                dsu.unite(id, linearIndex(x + 1, y - 1, w));
-            }
-        }
-    }
-
-    // Compute bbox per component root and remember root for each object pixel.
-    std::vector<bbox2i> boxes(n, bbox2i::make_empty());
-    std::vector<std::size_t> rootOfPixel(n, static_cast<std::size_t>(-1));
-
-    for (int y = 0; y < h; ++y) {
-        for (int x = 0; x < w; ++x) {
-            if (objectsMask(y, x) != kObject) continue;
-
-            const std::size_t id = linearIndex(x, y, w);
-            const std::size_t r = dsu.find(id);
-            rootOfPixel[id] = r;
-            boxes[r].include_pixel(x, y);
-        }
-    }
-
-    // Collect roots.
-    std::vector<std::size_t> roots;
-    roots.reserve(128);
-    for (std::size_t r = 0; r < n; ++r) {
-        if (!boxes[r].is_empty()) roots.push_back(r);
-    }
-
-    // Deterministic order: by bbox top-left (y, then x).
-    std::sort(roots.begin(), roots.end(), [&](std::size_t a, std::size_t b) {
-        const auto &A = boxes[a];
-        const auto &B = boxes[b];
-        if (A.min.y != B.min.y) return A.min.y < B.min.y;
-        return A.min.x < B.min.x;
-    });
+    // Components are labeled by runs, so no per-pixel scratch is needed.
+    const ConnectedComponents components = labelConnectedComponents(objectsMask);
+    const int n = components.count();
 
     std::vector<point2i> offsets;
-    std::vector<image8u> partsImages;
+    std::vector<image8u_view> partsImages;
     std::vector<image8u> partsMasks;
 
-    offsets.reserve(roots.size());
-    partsImages.reserve(roots.size());
-    partsMasks.reserve(roots.size());
+    offsets.reserve(n);
+    partsImages.reserve(n);
+    partsMasks.reserve(n);
 
-    // Extract crops.
-    for (std::size_t r : roots) {
-        const bbox2i &bb = boxes[r];
+    // Crops are ROIs of the image, masks are new images.
+    for (const bbox2i &bb : components.boxes) {
         const int outW = bb.width();
         const int outH = bb.height();
 
         point2i offset = bb.min;
         offsets.push_back(offset);
 
-        image8u partImage(outW, outH, image.channels());
-        image8u partMask(outW, outH, 1);
+        partsImages.push_back(image.roi(offset.x, offset.y, outW, outH));
+        partsMasks.emplace_back(outW, outH, 1);
+    }
+
+    // Paint runs into masks of their components.
+    for (std::size_t k = 0; k < components.runs.size(); ++k) {
+        const PixelRun &run = components.runs[k];
+        const int label = components.run_labels[k];
+        image8u &partMask = partsMasks[label];
+        const point2i offset = offsets[label];
+        std::uint8_t *row = partMask.data() + static_cast<std::size_t>(run.y - offset.y) * partMask.stride_elements();
+        std::fill(row + (run.x0 - offset.x), row + (run.x1 - offset.x), kObject);
+    }
+
+    return {offsets, partsImages, partsMasks};
+}
 
-        for (int yy = 0; yy < outH; ++yy) {
-            const int srcY = offset.y + yy;
-            for (int xx = 0; xx < outW; ++xx) {
-                const int srcX = offset.x + xx;
+std::tuple<std::vector<point2i>, std::vector<image8u_view>, std::vector<image8u>> splitObjectsCoarseToFine(
+    image8u_view image, const BinaryMask &coarseMask, int scale, int margin,
+    const std::function<BinaryMask(image8u_view roi)> &segment)
+{
+    rassert(scale >= 1 && margin >= 0, 980123744, scale, margin);
+    rassert(coarseMask.width() == (image.width() + scale - 1) / scale, 980123745, coarseMask.width(), image.width(), scale);
+    rassert(coarseMask.height() == (image.height() + scale - 1) / scale, 980123746, coarseMask.height(), image.height(), scale);
 
-                for (int c = 0; c < image.channels(); ++c) {
-                    partImage(yy, xx, c) = image(srcY, srcX, c);
-                }
+    const ConnectedComponents coarse = labelConnectedComponents(coarseMask);
 
-                const std::size_t sid = linearIndex(srcX, srcY, w);
-                const bool belongs = (objectsMask(srcY, srcX) == kObject) && (rootOfPixel[sid] == r);
-                partMask(yy, xx) = belongs ? kObject : 0;
-            }
+    std::vector<point2i> offsets;
+    std::vector<image8u_view> partsImages;
+    std::vector<image8u> partsMasks;
+    for (const bbox2i &coarseBox : coarse.boxes) {
+        const int x0 = std::max(0, coarseBox.min.x * scale - margin);
+        const int y0 = std::max(0, coarseBox.min.y * scale - margin);
+        const int x1 = std::min(image.width(), coarseBox.max.x * scale + margin);
+        const int y1 = std::min(image.height(), coarseBox.max.y * scale + margin);
+        const image8u_view roi = image.roi(x0, y0, x1 - x0, y1 - y0);
+
+        const BinaryMask fineMask = segment(roi);
+        rassert(fineMask.width() == roi.width() && fineMask.height() == roi.height(), 980123747);
+        const ConnectedComponents fine = labelConnectedComponents(fineMask);
+        if (fine.count() == 0) continue;
+
+        // the object is the largest component, the others are parts of neighbouring objects or noise
+        std::vector<long long> areas(fine.count(), 0);
+        for (std::size_t k = 0; k < fine.runs.size(); ++k) {
+            areas[fine.run_labels[k]] += fine.runs[k].x1 - fine.runs[k].x0;
         }
+        const int label = static_cast<int>(std::max_element(areas.begin(), areas.end()) - areas.begin());
+        const bbox2i &bb = fine.boxes[label];
 
-        partsImages.push_back(std::move(partImage));
-        partsMasks.push_back(std::move(partMask));
+        offsets.push_back({x0 + bb.min.x, y0 + bb.min.y});
+        partsImages.push_back(roi.roi(bb.min.x, bb.min.y, bb.width(), bb.height()));
+        partsMasks.push_back(paintComponentMask(fine, label, bb.min, bb.width(), bb.height()));
     }
-
     return {offsets, partsImages, partsMasks};
 }
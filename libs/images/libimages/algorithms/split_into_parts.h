@@ -1,8 +1,26 @@
 #pragma once
 
+#include <functional>
+
+#include <libimages/binary_mask.h>
 #include <libimages/image.h>
 #include <libbase/point2.h>
 
 
-std::tuple<std::vector<point2i>, std::vector<image8u>, std::vector<image8u>> splitObjects(
-    const image8u &image, const image8u &objectsMask);
+// Splits objects of the mask (0 = background, 255 = object) into 8-connected components.
+// Returns offsets (top-left corners), image crops and masks of components sorted by bbox top-left (y, then x).
+// Crops are views (ROIs) into the image - nothing is copied, so the image must outlive them.
+std::tuple<std::vector<point2i>, std::vector<image8u_view>, std::vector<image8u>> splitObjects(
+    image8u_view image, const image8u &objectsMask);
+
+std::tuple<std::vector<point2i>, std::vector<image8u_view>, std::vector<image8u>> splitObjects(
+    image8u_view image, const BinaryMask &objectsMask);
+
+// Coarse-to-fine split for large images: objects are found on coarseMask - the mask segmented at 1/scale resolution
+// (f.e. of downsample_box(image, scale)). Then each object is segmented again at full resolution by segment(roi),
+// but only inside its bbox scaled back to full resolution and padded by margin pixels - the largest component there
+// is the object. So full resolution is processed only around objects, and object edges keep full precision.
+// Objects are in the order of their coarse components.
+std::tuple<std::vector<point2i>, std::vector<image8u_view>, std::vector<image8u>> splitObjectsCoarseToFine(
+    image8u_view image, const BinaryMask &coarseMask, int scale, int margin,
+    const std::function<BinaryMask(image8u_view roi)> &segment);
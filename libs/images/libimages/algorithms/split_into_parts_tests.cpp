@@ -6,6 +6,9 @@
 #include <libbase/point2.h>
 #include <libbase/runtime_assert.h>
 #include <libbase/configure_working_directory.h>
+#include <libimages/algorithms/downsample.h>
+#include <libimages/algorithms/grayscale.h>
+#include <libimages/algorithms/threshold_masking.h>
 #include <libimages/debug_io.h>
 #include <libimages/image.h>
 #include <libimages/tests_utils.h>
@@ -58,7 +61,7 @@ TEST(split_into_parts, oneComponent) {
     ASSERT_EQ(n, 1);
 
     for (int i = 0; i < n; ++i) {
-        debug_io::dump_image(getUnitCaseDebugDir() + "10_object" + std::to_string(i) + "_image.jpg", objectsImages[i]);
+        debug_io::dump_image(getUnitCaseDebugDir() + "10_object" + std::to_string(i) + "_image.jpg", objectsImages[i].copy());
         debug_io::dump_image(getUnitCaseDebugDir() + "10_object" + std::to_string(i) + "_mask.png", objectsMasks[i]);
     }
 
@@ -70,8 +73,8 @@ TEST(split_into_parts, oneComponent) {
     ASSERT_EQ(objectsMasks[0].width(), aSize.x);
     ASSERT_EQ(objectsMasks[0].height(), aSize.y);
 
-    ASSERT_EQ(stats::minValue(objectsImages[0].toVector()), 0);
-    ASSERT_EQ(stats::maxValue(objectsImages[0].toVector()), aColor);
+    ASSERT_EQ(stats::minValue(objectsImages[0].copy().toVector()), 0);
+    ASSERT_EQ(stats::maxValue(objectsImages[0].copy().toVector()), aColor);
 
     ASSERT_EQ(stats::minValue(objectsMasks[0].toVector()), 0);
     ASSERT_EQ(stats::maxValue(objectsMasks[0].toVector()), 255);
@@ -132,7 +135,7 @@ TEST(split_into_parts, twoComponents) {
     ASSERT_EQ(n, 2);
 
     for (int i = 0; i < n; ++i) {
-        debug_io::dump_image(getUnitCaseDebugDir() + "10_object" + std::to_string(i) + "_image.jpg", objectsImages[i]);
+        debug_io::dump_image(getUnitCaseDebugDir() + "10_object" + std::to_string(i) + "_image.jpg", objectsImages[i].copy());
         debug_io::dump_image(getUnitCaseDebugDir() + "10_object" + std::to_string(i) + "_mask.png", objectsMasks[i]);
     }
 
@@ -154,10 +157,10 @@ TEST(split_into_parts, twoComponents) {
     ASSERT_EQ(objectsMasks[bIndex].width(), bSize.x);
     ASSERT_EQ(objectsMasks[bIndex].height(), bSize.y);
 
-    ASSERT_EQ(stats::minValue(objectsImages[aIndex].toVector()), 0);
-    ASSERT_EQ(stats::maxValue(objectsImages[aIndex].toVector()), aColor);
-    ASSERT_EQ(stats::minValue(objectsImages[bIndex].toVector()), 0);
-    ASSERT_EQ(stats::maxValue(objectsImages[bIndex].toVector()), bColor);
+    ASSERT_EQ(stats::minValue(objectsImages[aIndex].copy().toVector()), 0);
+    ASSERT_EQ(stats::maxValue(objectsImages[aIndex].copy().toVector()), aColor);
+    ASSERT_EQ(stats::minValue(objectsImages[bIndex].copy().toVector()), 0);
+    ASSERT_EQ(stats::maxValue(objectsImages[bIndex].copy().toVector()), bColor);
 
     ASSERT_EQ(stats::minValue(objectsMasks[aIndex].toVector()), 0);
     ASSERT_EQ(stats::maxValue(objectsMasks[aIndex].toVector()), 255);
@@ -184,3 +187,54 @@ TEST(split_into_parts, twoComponents) {
     debug_io::dump_image(getUnitCaseDebugDir() + "02_result_components.jpg", debug_io::colorize_labels(labels, 0));
 }
 
+
+TEST(split_into_parts, cropsAreViewsIntoImage) {
+    image8u image(40, 30, 3);
+    image8u objectsMask(40, 30, 1);
+    drawCross(objectsMask, point2i{5, 7}, point2i{15, 20}, (unsigned char) 255);
+
+    auto [objectsOffsets, objectsImages, objectsMasks] = splitObjects(image, objectsMask);
+    ASSERT_EQ(objectsImages.size(), 1);
+    ASSERT_EQ(objectsOffsets[0], point2i(5, 7));
+
+    // no pixels are copied: the crop points into the source image and has its stride
+    const image8u_view crop = objectsImages[0];
+    EXPECT_EQ(crop.data(), image.data() + 7 * image.stride_elements() + 5 * 3);
+    EXPECT_EQ(crop.stride_elements(), image.stride_elements());
+    image(7, 5, 1) = 42;
+    EXPECT_EQ(crop(0, 0, 1), 42);
+}
+
+TEST(split_into_parts, coarseToFineEqualsFullResolution) {
+    // two ellipses (their edges are only approximated by the coarse mask) and a small speck
+    const int w = 203;
+    const int h = 150;
+    image8u image(w, h, 1);
+    for (int j = 0; j < h; ++j) {
+        for (int i = 0; i < w; ++i) {
+            const double a = ((i - 50) / 40.0) * ((i - 50) / 40.0) + ((j - 60) / 30.0) * ((j - 60) / 30.0);
+            const double b = ((i - 150) / 35.0) * ((i - 150) / 35.0) + ((j - 95) / 45.0) * ((j - 95) / 45.0);
+            if (a < 1.0 || b < 1.0)
+                image(j, i) = 200;
+        }
+    }
+    image(5, 100) = 255;
+
+    auto segment = [](image8u_view roi) { return threshold_binary_mask(to_grayscale_float(roi), 128.0f); };
+    auto [expectedOffsets, expectedImages, expectedMasks] = splitObjects(image, segment(image));
+    ASSERT_EQ(expectedOffsets.size(), 3);
+
+    const int scale = 4;
+    const BinaryMask coarseMask = segment(downsample_box(image, scale));
+    auto [offsets, images, masks] = splitObjectsCoarseToFine(image, coarseMask, scale, 2 * scale, segment);
+
+    // the speck is lost at the coarse scale, objects are the same as at full resolution
+    ASSERT_EQ(offsets.size(), 2);
+    for (int obj = 0; obj < 2; ++obj) {
+        const int expected = obj == 0 ? 1 : 2;
+        EXPECT_EQ(offsets[obj], expectedOffsets[expected]);
+        EXPECT_EQ(images[obj].data(), expectedImages[expected].data());
+        EXPECT_EQ(images[obj].size(), expectedImages[expected].size());
+        EXPECT_EQ(masks[obj].toVector(), expectedMasks[expected].toVector());
+    }
+}
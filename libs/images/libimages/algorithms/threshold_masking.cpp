@@ -1,15 +1,248 @@
 #include "threshold_masking.h"
 
 #include <libbase/runtime_assert.h>
+#include <libimages/algorithms/grayscale.h>
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#ifdef LIBBASE_X86_SIMD
+#include <immintrin.h>
+#endif
 
 
 image8u threshold_masking(const image32f &image, float threshold) {
     rassert(image.channels() == 1, 2321431421, image.channels());
-    image8u mask(image.size());
+    image8u mask(image.size(), ImageInit::Uninitialized);
     for (int j = 0; j < image.height(); ++j) {
+        const float *src = image.row(j);
+        std::uint8_t *dst = mask.row(j);
         for (int i = 0; i < image.width(); ++i) {
-            mask(j, i) = (image(j, i) < threshold) ? 0 : 255;
+            dst[i] = (src[i] < threshold) ? 0 : 255;
+        }
+    }
+    return mask;
+}
+
+namespace {
+
+void threshold_row(const float *src, int width, float threshold, std::uint64_t *dst) {
+    for (int x0 = 0, word = 0; x0 < width; x0 += BinaryMask::WORD_BITS, ++word) {
+        const int n = std::min(BinaryMask::WORD_BITS, width - x0);
+        std::uint64_t bits = 0;
+        for (int k = 0; k < n; ++k) {
+            bits |= static_cast<std::uint64_t>(!(src[x0 + k] < threshold)) << k;
+        }
+        dst[word] = bits;
+    }
+}
+
+} // namespace
+
+BinaryMask threshold_binary_mask(const image32f &image, float threshold) {
+    rassert(image.channels() == 1, 2321431422, image.channels());
+    BinaryMask mask(image.width(), image.height());
+    for (int j = 0; j < image.height(); ++j) {
+        threshold_row(image.row(j), image.width(), threshold, mask.row(j));
+    }
+    return mask;
+}
+
+namespace {
+
+std::uint8_t pixel_luma8(const std::uint8_t *pixel, int channels) {
+    return channels == 1 ? pixel[0] : luma8(pixel[0], pixel[1], pixel[2]);
+}
+
+} // namespace
+
+LumaHistogram border_luma_histogram(image8u_view image) {
+    const int w = image.width();
+    const int h = image.height();
+    const int c = image.channels();
+    rassert(c == 1 || c == 3 || c == 4, 2321431424, c);
+    rassert(w > 0 && h > 0, 2321431425, w, h);
+
+    LumaHistogram histogram;
+    for (int j = 0; j < h; ++j) {
+        const std::uint8_t *row = image.row(j);
+        // the first and the last rows entirely, other rows - only the first and the last pixels
+        const int step = (j == 0 || j == h - 1) ? 1 : std::max(1, w - 1);
+        for (int i = 0; i < w; i += step) {
+            histogram.add(pixel_luma8(row + static_cast<std::size_t>(i) * c, c));
+        }
+    }
+    return histogram;
+}
+
+namespace {
+
+// Sets bit x of dst (zeroed before) for pixels of [from, width) with luma >= t
+void threshold_luma_row_scalar(const std::uint8_t *src, int width, int channels, int t, int from, std::uint64_t *dst) {
+    for (int x = from; x < width; ++x) {
+        const bool set = pixel_luma8(src + static_cast<std::size_t>(x) * channels, channels) >= t;
+        dst[x / BinaryMask::WORD_BITS] |= static_cast<std::uint64_t>(set) << (x % BinaryMask::WORD_BITS);
+    }
+}
+
+#ifdef LIBBASE_X86_SIMD
+
+// pshufb masks which gather channel ch of 16 RGB pixels from the k-th of three 16-byte registers (-1 - zero byte)
+struct DeinterleaveMasks {
+    alignas(16) std::int8_t m[3][3][16];
+};
+
+constexpr DeinterleaveMasks makeDeinterleaveMasks() {
+    DeinterleaveMasks masks{};
+    for (int ch = 0; ch < 3; ++ch) {
+        for (int k = 0; k < 3; ++k) {
+            for (int i = 0; i < 16; ++i) {
+                const int byte = 3 * i + ch - 16 * k;
+                masks.m[ch][k][i] = static_cast<std::int8_t>((byte >= 0 && byte < 16) ? byte : -1);
+            }
+        }
+    }
+    return masks;
+}
+
+constexpr DeinterleaveMasks DEINTERLEAVE_MASKS = makeDeinterleaveMasks();
+
+__attribute__((target("sse4.1")))
+inline __m128i gather_channel_sse41(__m128i a, __m128i b, __m128i c, int ch) {
+    const auto mask = [ch](int k) { return _mm_load_si128(reinterpret_cast<const __m128i *>(DEINTERLEAVE_MASKS.m[ch][k])); };
+    return _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a, mask(0)), _mm_shuffle_epi8(b, mask(1))), _mm_shuffle_epi8(c, mask(2)));
+}
+
+// luma8 of 8 pixels given as 16-bit channels
+__attribute__((target("sse4.1")))
+inline __m128i luma8_epi16_sse41(__m128i r, __m128i g, __m128i b) {
+    __m128i sum = _mm_mullo_epi16(r, _mm_set1_epi16(77));
+    sum = _mm_add_epi16(sum, _mm_mullo_epi16(g, _mm_set1_epi16(150)));
+    sum = _mm_add_epi16(sum, _mm_mullo_epi16(b, _mm_set1_epi16(29)));
+    return _mm_srli_epi16(_mm_add_epi16(sum, _mm_set1_epi16(128)), 8); // max sum is 255 * 256 + 128 - no overflow of uint16
+}
+
+__attribute__((target("sse4.1")))
+void threshold_luma_row_rgb_sse41(const std::uint8_t *src, int width, int t, std::uint64_t *dst) {
+    const __m128i below = _mm_set1_epi16(static_cast<short>(t - 1));
+    const __m128i zero = _mm_setzero_si128();
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        const std::uint8_t *p = src + static_cast<std::size_t>(x) * 3;
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 16));
+        const __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 32));
+        const __m128i r = gather_channel_sse41(a, b, c, 0);
+        const __m128i g = gather_channel_sse41(a, b, c, 1);
+        const __m128i bl = gather_channel_sse41(a, b, c, 2);
+        const __m128i lumaLo = luma8_epi16_sse41(_mm_cvtepu8_epi16(r), _mm_cvtepu8_epi16(g), _mm_cvtepu8_epi16(bl));
+        const __m128i lumaHi = luma8_epi16_sse41(_mm_unpackhi_epi8(r, zero), _mm_unpackhi_epi8(g, zero), _mm_unpackhi_epi8(bl, zero));
+        const __m128i set = _mm_packs_epi16(_mm_cmpgt_epi16(lumaLo, below), _mm_cmpgt_epi16(lumaHi, below));
+        const std::uint64_t bits = static_cast<std::uint32_t>(_mm_movemask_epi8(set));
+        dst[x / BinaryMask::WORD_BITS] |= bits << (x % BinaryMask::WORD_BITS); // x is a multiple of 16 - bits don't cross words
+    }
+    threshold_luma_row_scalar(src, width, 3, t, x, dst);
+}
+
+__attribute__((target("avx2")))
+void threshold_luma_row_rgb_avx2(const std::uint8_t *src, int width, int t, std::uint64_t *dst) {
+    const __m256i below = _mm256_set1_epi16(static_cast<short>(t - 1));
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        const std::uint8_t *p = src + static_cast<std::size_t>(x) * 3;
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 16));
+        const __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 32));
+        // all 16 pixels fit one 256-bit register of 16-bit values
+        const __m256i r = _mm256_cvtepu8_epi16(gather_channel_sse41(a, b, c, 0));
+        const __m256i g = _mm256_cvtepu8_epi16(gather_channel_sse41(a, b, c, 1));
+        const __m256i bl = _mm256_cvtepu8_epi16(gather_channel_sse41(a, b, c, 2));
+        __m256i sum = _mm256_mullo_epi16(r, _mm256_set1_epi16(77));
+        sum = _mm256_add_epi16(sum, _mm256_mullo_epi16(g, _mm256_set1_epi16(150)));
+        sum = _mm256_add_epi16(sum, _mm256_mullo_epi16(bl, _mm256_set1_epi16(29)));
+        const __m256i luma = _mm256_srli_epi16(_mm256_add_epi16(sum, _mm256_set1_epi16(128)), 8);
+        const __m256i cmp = _mm256_cmpgt_epi16(luma, below);
+        const __m128i set = _mm_packs_epi16(_mm256_castsi256_si128(cmp), _mm256_extracti128_si256(cmp, 1));
+        const std::uint64_t bits = static_cast<std::uint32_t>(_mm_movemask_epi8(set));
+        dst[x / BinaryMask::WORD_BITS] |= bits << (x % BinaryMask::WORD_BITS);
+    }
+    threshold_luma_row_scalar(src, width, 3, t, x, dst);
+}
+
+#endif
+
+void threshold_luma_row(SimdLevel level, const std::uint8_t *src, int width, int channels, int t, std::uint64_t *dst) {
+    if (channels == 3) {
+        switch (level) {
+#ifdef LIBBASE_X86_SIMD
+        case SimdLevel::AVX2:
+            threshold_luma_row_rgb_avx2(src, width, t, dst);
+            return;
+        case SimdLevel::SSE41:
+            threshold_luma_row_rgb_sse41(src, width, t, dst);
+            return;
+#endif
+        default:
+            break;
+        }
+    }
+    threshold_luma_row_scalar(src, width, channels, t, 0, dst);
+}
+
+// luma is integer, so luma >= threshold <=> luma >= ceil(threshold), clamped so that it fits 16-bit lanes
+int luma_threshold(float threshold) { return static_cast<int>(std::ceil(std::clamp(threshold, 0.0f, 256.0f))); }
+
+} // namespace
+
+BinaryMask threshold_luma_mask(image8u_view image, float threshold, std::size_t *foreground_count, SimdLevel level) {
+    const int w = image.width();
+    const int h = image.height();
+    const int c = image.channels();
+    rassert(c == 1 || c == 3 || c == 4, 2321431426, c);
+    level = supportedSimdLevel(level);
+    const int t = luma_threshold(threshold);
+
+    BinaryMask mask(w, h);
+    const int words = mask.words_per_row();
+    long long count = 0;
+    #pragma omp parallel for schedule(static) reduction(+:count)
+    for (int j = 0; j < h; ++j) {
+        std::uint64_t *dst = mask.row(j);
+        std::fill(dst, dst + words, 0);
+        threshold_luma_row(level, image.row(j), w, c, t, dst);
+        for (int k = 0; k < words; ++k) {
+            count += std::popcount(dst[k]);
+        }
+    }
+    if (foreground_count) *foreground_count = static_cast<std::size_t>(count);
+    return mask;
+}
+
+BinaryMask threshold_luma_mask(ImageRowReader &reader, float threshold, std::size_t *foreground_count, SimdLevel level) {
+    rassert(reader.rows_read() == 0, 2321431423, "Reader has already been used", reader.rows_read());
+    const int w = reader.width();
+    const int c = reader.channels();
+    rassert(c == 1 || c == 3 || c == 4, 2321431427, c);
+    level = supportedSimdLevel(level);
+    const int t = luma_threshold(threshold);
+
+    BinaryMask mask(w, reader.height());
+    const int words = mask.words_per_row();
+    std::vector<std::uint8_t> row(static_cast<std::size_t>(w) * c);
+    std::size_t count = 0;
+    for (int j = 0; j < reader.height(); ++j) {
+        reader.read_row(row.data());
+        std::uint64_t *dst = mask.row(j);
+        std::fill(dst, dst + words, 0);
+        threshold_luma_row(level, row.data(), w, c, t, dst);
+        for (int k = 0; k < words; ++k) {
+            count += std::popcount(dst[k]);
         }
     }
+    if (foreground_count) *foreground_count = count;
     return mask;
 }
@@ -1,7 +1,34 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+
+#include <libbase/cpu_features.h>
+#include <libbase/stats.h>
+#include <libimages/binary_mask.h>
 #include <libimages/image.h>
+#include <libimages/image_io.h>
 
 
 // returns mask that has 0 if < threshold, 255 otherwise
 image8u threshold_masking(const image32f &image, float threshold);
+
+// the same mask but bit-packed: pixel is set iff it is >= threshold
+BinaryMask threshold_binary_mask(const image32f &image, float threshold);
+
+// Histogram of 8-bit intensities
+using LumaHistogram = stats::Histogram<256>;
+
+// Histogram of luma8 (see grayscale.h) of the pixels on the image border, each pixel is counted once (2w + 2h - 4 pixels)
+LumaHistogram border_luma_histogram(image8u_view image);
+
+// Fused grayscale + threshold: pixel is set iff its luma8 is >= threshold. No grayscale image is built - each row is
+// converted and packed into mask words in a single sweep (with the strongest supported SIMD instructions up to level
+// for 3-channel images, all levels give the same mask). foreground_count (if not null) gets the number of set pixels.
+BinaryMask threshold_luma_mask(image8u_view image, float threshold, std::size_t *foreground_count = nullptr,
+                               SimdLevel level = SimdLevel::AVX2);
+
+// The same mask of an image decoded row by row: only a single row of the source image is held in memory,
+// the mask is bit-identical to threshold_luma_mask of the fully loaded image
+BinaryMask threshold_luma_mask(ImageRowReader &reader, float threshold, std::size_t *foreground_count = nullptr,
+                               SimdLevel level = SimdLevel::AVX2);
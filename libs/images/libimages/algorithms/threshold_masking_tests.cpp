@@ -3,12 +3,17 @@
 #include <gtest/gtest.h>
 
 #include <libbase/configure_working_directory.h>
+#include <libbase/fast_random.h>
 #include <libbase/runtime_assert.h>
+#include <libbase/stats.h>
 #include <libimages/algorithms/grayscale.h>
 #include <libimages/debug_io.h>
 #include <libimages/image_io.h>
 #include <libimages/tests_utils.h>
 
+#include <cstdint>
+#include <vector>
+
 TEST(threshold_masking, thresholdByConstant100) {
     configureWorkingDirectory();
 
@@ -17,3 +22,109 @@ TEST(threshold_masking, thresholdByConstant100) {
     image8u is_foreground_mask = threshold_masking(grayscale, 100);
     debug_io::dump_image(getUnitCaseDebugDir() + "is_foreground_by_100.jpg", is_foreground_mask);
 }
+
+TEST(threshold_masking, binaryMaskEqualsImage) {
+    FastRandom r(239);
+    image32f image(131, 17, 1);
+    for (int j = 0; j < image.height(); ++j)
+        for (int i = 0; i < image.width(); ++i)
+            image(j, i) = r.nextFloat(0.0f, 255.0f);
+    image(3, 4) = 100.0f; // exactly the threshold is foreground
+
+    const BinaryMask mask = threshold_binary_mask(image, 100.0f);
+    EXPECT_EQ(mask.toImage().toVector(), threshold_masking(image, 100.0f).toVector());
+    EXPECT_TRUE(mask(3, 4));
+}
+
+TEST(threshold_masking, rowReaderEqualsDecodedImage) {
+    configureWorkingDirectory();
+
+    const std::string jpeg_path = "data/00_photo_six_parts_downscaled_x4.jpg";
+    image8u img = load_image(jpeg_path);
+    std::size_t expected_count = 0;
+    const BinaryMask expected = threshold_luma_mask(img, 100.0f, &expected_count);
+
+    // lossless copy is decoded exactly as the in-memory image, so the masks are the same on all SIMD levels
+    const std::string png_path = getUnitCaseDebugDir() + "input.png";
+    debug_io::dump_image(png_path, img);
+    for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::SSE41, SimdLevel::AVX2}) {
+        ImageRowReader png_reader(png_path);
+        std::size_t count = 0;
+        EXPECT_TRUE(threshold_luma_mask(png_reader, 100.0f, &count, level) == expected) << simdLevelName(level);
+        EXPECT_EQ(count, expected_count);
+    }
+
+    // streamed JPEG decoding differs by a few intensity levels, so only pixels close to the threshold can flip
+    ImageRowReader jpeg_reader(jpeg_path);
+    const BinaryMask streamed = threshold_luma_mask(jpeg_reader, 100.0f);
+    BinaryMask flipped = streamed;
+    flipped &= ~expected;
+    BinaryMask lost = expected;
+    lost &= ~streamed;
+    EXPECT_LE(flipped.count() + lost.count(), expected.width() * expected.height() / 1000);
+}
+
+TEST(threshold_masking, lumaMaskEqualsNaive) {
+    FastRandom r(239);
+    for (int c : {1, 3, 4}) {
+        for (int w : {1, 15, 16, 64, 131}) {
+            image8u image(w, 7, c);
+            for (std::uint8_t &v : image.pixels())
+                v = static_cast<std::uint8_t>(r.nextInt(0, 255));
+
+            for (float threshold : {0.0f, 99.5f, 100.0f, 255.0f, 300.0f}) {
+                std::size_t expected_count = 0;
+                BinaryMask expected(w, 7);
+                for (int j = 0; j < 7; ++j) {
+                    for (int i = 0; i < w; ++i) {
+                        const std::uint8_t luma = c == 1 ? image(j, i, 0) : luma8(image(j, i, 0), image(j, i, 1), image(j, i, 2));
+                        if (luma >= threshold) {
+                            expected.set(j, i, true);
+                            ++expected_count;
+                        }
+                    }
+                }
+                for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::SSE41, SimdLevel::AVX2}) {
+                    std::size_t count = 0;
+                    const BinaryMask mask = threshold_luma_mask(image, threshold, &count, level);
+                    EXPECT_TRUE(mask == expected) << c << " channels, width " << w << ", threshold " << threshold << ", " << simdLevelName(level);
+                    EXPECT_EQ(count, expected_count);
+                }
+            }
+        }
+    }
+}
+
+TEST(threshold_masking, lumaMaskIsCloseToFloatGrayscale) {
+    configureWorkingDirectory();
+
+    image8u img = load_image("data/00_photo_six_parts_downscaled_x4.jpg");
+    const BinaryMask expected = threshold_binary_mask(to_grayscale_float(img), 100.0f);
+    const BinaryMask mask = threshold_luma_mask(img, 100.0f);
+
+    // fixed-point luma differs from float grayscale by less than one intensity level
+    BinaryMask flipped = mask;
+    flipped &= ~expected;
+    BinaryMask lost = expected;
+    lost &= ~mask;
+    EXPECT_LE(flipped.count() + lost.count(), expected.width() * expected.height() / 1000);
+}
+
+TEST(threshold_masking, borderHistogramPercentile) {
+    FastRandom r(42);
+    image8u image(37, 11, 3);
+    for (std::uint8_t &v : image.pixels())
+        v = static_cast<std::uint8_t>(r.nextInt(0, 255));
+
+    std::vector<int> border;
+    for (int j = 0; j < image.height(); ++j)
+        for (int i = 0; i < image.width(); ++i)
+            if (i == 0 || j == 0 || i == image.width() - 1 || j == image.height() - 1)
+                border.push_back(luma8(image(j, i, 0), image(j, i, 1), image(j, i, 2)));
+
+    const LumaHistogram histogram = border_luma_histogram(image);
+    EXPECT_EQ(histogram.total(), 2 * 37 + 2 * 11 - 4);
+    for (double p : {0.0, 10.0, 33.3, 50.0, 90.0, 100.0}) {
+        EXPECT_DOUBLE_EQ(histogram.percentile(p), stats::percentile(border, p)) << p;
+    }
+}
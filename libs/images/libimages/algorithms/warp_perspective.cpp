@@ -0,0 +1,389 @@
+#include "warp_perspective.h"
+
+#include <libbase/runtime_assert.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#ifdef LIBBASE_X86_SIMD
+#include <immintrin.h>
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+Homography Homography::fromCorrespondences(const std::array<point2f, 4> &src, const std::array<point2f, 4> &dst) {
+    // Unknowns: h00 h01 h02 h10 h11 h12 h20 h21, with h22=1
+    double A[8][9] = {}; // augmented matrix [8 x (8+1)]
+
+    for (int i = 0; i < 4; ++i) {
+        const double x = src[i].x;
+        const double y = src[i].y;
+        const double u = dst[i].x;
+        const double v = dst[i].y;
+
+        // u row
+        {
+            double *r = A[2 * i];
+            r[0] = x; r[1] = y; r[2] = 1.0;
+            r[3] = 0; r[4] = 0; r[5] = 0;
+            r[6] = -x * u; r[7] = -y * u;
+            r[8] = u;
+        }
+        // v row
+        {
+            double *r = A[2 * i + 1];
+            r[0] = 0; r[1] = 0; r[2] = 0;
+            r[3] = x; r[4] = y; r[5] = 1.0;
+            r[6] = -x * v; r[7] = -y * v;
+            r[8] = v;
+        }
+    }
+
+    // Gaussian elimination with partial pivoting
+    for (int col = 0; col < 8; ++col) {
+        int piv = col;
+        double best = std::abs(A[col][col]);
+        for (int r = col + 1; r < 8; ++r) {
+            const double v = std::abs(A[r][col]);
+            if (v > best) {
+                best = v;
+                piv = r;
+            }
+        }
+        rassert(best > 1e-12, 7123980412301, "Homography solve failed: singular system");
+
+        if (piv != col) {
+            for (int k = col; k < 9; ++k) std::swap(A[piv][k], A[col][k]);
+        }
+
+        const double diag = A[col][col];
+        for (int k = col; k < 9; ++k) A[col][k] /= diag;
+
+        for (int r = 0; r < 8; ++r) {
+            if (r == col) continue;
+            const double f = A[r][col];
+            if (f == 0.0) continue;
+            for (int k = col; k < 9; ++k) A[r][k] -= f * A[col][k];
+        }
+    }
+
+    Homography H;
+    for (int i = 0; i < 8; ++i) H.h[i] = A[i][8];
+    H.h[8] = 1.0;
+    return H;
+}
+
+Homography Homography::inverse() const {
+    const double a00 = h[0], a01 = h[1], a02 = h[2];
+    const double a10 = h[3], a11 = h[4], a12 = h[5];
+    const double a20 = h[6], a21 = h[7], a22 = h[8];
+
+    const double c00 =  a11 * a22 - a12 * a21;
+    const double c01 = -(a10 * a22 - a12 * a20);
+    const double c02 =  a10 * a21 - a11 * a20;
+
+    const double c10 = -(a01 * a22 - a02 * a21);
+    const double c11 =  a00 * a22 - a02 * a20;
+    const double c12 = -(a00 * a21 - a01 * a20);
+
+    const double c20 =  a01 * a12 - a02 * a11;
+    const double c21 = -(a00 * a12 - a02 * a10);
+    const double c22 =  a00 * a11 - a01 * a10;
+
+    const double det = a00 * c00 + a01 * c01 + a02 * c02;
+    rassert(std::abs(det) > 1e-12, 7123980412302, "Homography matrix is singular");
+
+    const double invDet = 1.0 / det;
+
+    // adjugate = cofactors transposed
+    Homography inv;
+    inv.h[0] = c00 * invDet; inv.h[1] = c10 * invDet; inv.h[2] = c20 * invDet;
+    inv.h[3] = c01 * invDet; inv.h[4] = c11 * invDet; inv.h[5] = c21 * invDet;
+    inv.h[6] = c02 * invDet; inv.h[7] = c12 * invDet; inv.h[8] = c22 * invDet;
+    return inv;
+}
+
+point2f Homography::operator()(point2f p) const {
+    const double w = h[6] * p.x + h[7] * p.y + h[8];
+    rassert(std::abs(w) > 1e-12, 7123980412303, "Point is mapped to infinity");
+    return point2f(static_cast<float>((h[0] * p.x + h[1] * p.y + h[2]) / w),
+                   static_cast<float>((h[3] * p.x + h[4] * p.y + h[5]) / w));
+}
+
+namespace {
+
+// Source coordinates of the pixel centers of a dst row y: numerators and denominator of the homography are linear
+// along the row, so they are stepped from the row start (one multiply-add each per pixel instead of a full matrix
+// product). SIMD levels compute every lane with the same double operations, so the coordinates are the same.
+void map_row_scalar(const double *h, int y, int from, int width, float *xs, float *ys) {
+    const double py = y + 0.5;
+    const double u0 = h[1] * py + h[2];
+    const double v0 = h[4] * py + h[5];
+    const double w0 = h[7] * py + h[8];
+    for (int x = from; x < width; ++x) {
+        const double px = x + 0.5;
+        const double w = h[6] * px + w0;
+        xs[x] = static_cast<float>((h[0] * px + u0) / w);
+        ys[x] = static_cast<float>((h[3] * px + v0) / w);
+    }
+}
+
+// Destination pixel x of a row with its 4 source neighbors (offsets of top-left, top-right, bottom-left, bottom-right
+// pixels from the source data) and bilinear weights of the right and of the bottom neighbors
+struct BilinearSample final {
+    int x;
+    float fx;
+    float fy;
+    std::size_t offsets[4];
+};
+
+// Pixels of a dst row that get a source color: their nearest source pixel exists and is an object pixel
+void collect_row_samples(image8u_view src, image8u_view src_mask, const float *xs, const float *ys, int width,
+                         std::vector<BilinearSample> &samples) {
+    samples.clear();
+    const int W = src.width();
+    const int H = src.height();
+    const int C = src.channels();
+    const std::size_t stride = src.stride_elements();
+    for (int x = 0; x < width; ++x) {
+        const float sx = xs[x];
+        const float sy = ys[x];
+        // NaN and infinities (points mapped to infinity) fail these checks too
+        if (!(sx > -0.5f && sx < W - 0.5f && sy > -0.5f && sy < H - 0.5f))
+            continue;
+        if (src_mask.data() != nullptr) {
+            const int xi = static_cast<int>(std::floor(sx + 0.5f));
+            const int yi = static_cast<int>(std::floor(sy + 0.5f));
+            if (src_mask.row(yi)[xi] == 0)
+                continue;
+        }
+
+        const float cx = std::clamp(sx, 0.0f, float(W - 1));
+        const float cy = std::clamp(sy, 0.0f, float(H - 1));
+        const int xl = static_cast<int>(cx);
+        const int yt = static_cast<int>(cy);
+        const int xr = std::min(xl + 1, W - 1);
+        const int yb = std::min(yt + 1, H - 1);
+
+        BilinearSample s;
+        s.x = x;
+        s.fx = cx - float(xl);
+        s.fy = cy - float(yt);
+        s.offsets[0] = yt * stride + static_cast<std::size_t>(xl) * C;
+        s.offsets[1] = yt * stride + static_cast<std::size_t>(xr) * C;
+        s.offsets[2] = yb * stride + static_cast<std::size_t>(xl) * C;
+        s.offsets[3] = yb * stride + static_cast<std::size_t>(xr) * C;
+        samples.push_back(s);
+    }
+}
+
+void blend_scalar(const std::uint8_t *src, int C, const BilinearSample *samples, int from, int n, std::uint8_t *dst_row) {
+    for (int i = from; i < n; ++i) {
+        const BilinearSample &s = samples[i];
+        const float wx = 1.0f - s.fx;
+        const float wy = 1.0f - s.fy;
+        std::uint8_t *d = dst_row + static_cast<std::size_t>(s.x) * C;
+        for (int c = 0; c < C; ++c) {
+            const float top = float(src[s.offsets[0] + c]) * wx + float(src[s.offsets[1] + c]) * s.fx;
+            const float bottom = float(src[s.offsets[2] + c]) * wx + float(src[s.offsets[3] + c]) * s.fx;
+            const float value = top * wy + bottom * s.fy;
+            d[c] = static_cast<std::uint8_t>(std::min(255, static_cast<int>(value + 0.5f)));
+        }
+    }
+}
+
+#ifdef LIBBASE_X86_SIMD
+
+__attribute__((target("sse4.1"))) void map_row_sse41(const double *h, int y, int width, float *xs, float *ys) {
+    const double py = y + 0.5;
+    const __m128d u0 = _mm_set1_pd(h[1] * py + h[2]);
+    const __m128d v0 = _mm_set1_pd(h[4] * py + h[5]);
+    const __m128d w0 = _mm_set1_pd(h[7] * py + h[8]);
+    const __m128d h0 = _mm_set1_pd(h[0]);
+    const __m128d h3 = _mm_set1_pd(h[3]);
+    const __m128d h6 = _mm_set1_pd(h[6]);
+    __m128d px = _mm_setr_pd(0.5, 1.5);
+    int x = 0;
+    for (; x + 2 <= width; x += 2, px = _mm_add_pd(px, _mm_set1_pd(2.0))) {
+        const __m128d w = _mm_add_pd(_mm_mul_pd(h6, px), w0);
+        _mm_storel_pi(reinterpret_cast<__m64 *>(xs + x), _mm_cvtpd_ps(_mm_div_pd(_mm_add_pd(_mm_mul_pd(h0, px), u0), w)));
+        _mm_storel_pi(reinterpret_cast<__m64 *>(ys + x), _mm_cvtpd_ps(_mm_div_pd(_mm_add_pd(_mm_mul_pd(h3, px), v0), w)));
+    }
+    map_row_scalar(h, y, x, width, xs, ys);
+}
+
+__attribute__((target("avx2"))) void map_row_avx2(const double *h, int y, int width, float *xs, float *ys) {
+    const double py = y + 0.5;
+    const __m256d u0 = _mm256_set1_pd(h[1] * py + h[2]);
+    const __m256d v0 = _mm256_set1_pd(h[4] * py + h[5]);
+    const __m256d w0 = _mm256_set1_pd(h[7] * py + h[8]);
+    const __m256d h0 = _mm256_set1_pd(h[0]);
+    const __m256d h3 = _mm256_set1_pd(h[3]);
+    const __m256d h6 = _mm256_set1_pd(h[6]);
+    __m256d px = _mm256_setr_pd(0.5, 1.5, 2.5, 3.5);
+    int x = 0;
+    for (; x + 4 <= width; x += 4, px = _mm256_add_pd(px, _mm256_set1_pd(4.0))) {
+        const __m256d w = _mm256_add_pd(_mm256_mul_pd(h6, px), w0);
+        _mm_storeu_ps(xs + x, _mm256_cvtpd_ps(_mm256_div_pd(_mm256_add_pd(_mm256_mul_pd(h0, px), u0), w)));
+        _mm_storeu_ps(ys + x, _mm256_cvtpd_ps(_mm256_div_pd(_mm256_add_pd(_mm256_mul_pd(h3, px), v0), w)));
+    }
+    map_row_scalar(h, y, x, width, xs, ys);
+}
+
+// RGB pixel as 32 bits (the 4th byte is zero) - without reading past the pixel, it can be the last one of the buffer
+inline std::uint64_t load_rgb(const std::uint8_t *p) {
+    return std::uint64_t(p[0]) | (std::uint64_t(p[1]) << 8) | (std::uint64_t(p[2]) << 16);
+}
+
+inline void store_rgb(std::uint8_t *d, std::uint32_t rgb) {
+    d[0] = static_cast<std::uint8_t>(rgb);
+    d[1] = static_cast<std::uint8_t>(rgb >> 8);
+    d[2] = static_cast<std::uint8_t>(rgb >> 16);
+}
+
+// Left and right RGB neighbors of a sample as bytes 0..2 and 3..5 (other bytes are junk and end up in the ignored
+// 4th lane): neighbors in the same row are loaded at once if the 8 bytes don't cross the end of the source data
+__attribute__((target("sse4.1"))) inline __m128i load_pair_sse41(const std::uint8_t *src, std::size_t left,
+                                                                  std::size_t right, std::size_t end) {
+    if (right == left + 3 && left + 8 <= end)
+        return _mm_loadl_epi64(reinterpret_cast<const __m128i *>(src + left));
+    return _mm_cvtsi64_si128(static_cast<long long>(load_rgb(src + left) | (load_rgb(src + right) << 24)));
+}
+
+// RGB channels of a pixel are the lanes: the same operations in the same order as in blend_scalar
+__attribute__((target("sse4.1"))) void blend_rgb_sse41(const std::uint8_t *src, std::size_t end,
+                                                        const BilinearSample *samples, int n, std::uint8_t *dst_row) {
+    const __m128 half = _mm_set1_ps(0.5f);
+    for (int i = 0; i < n; ++i) {
+        const BilinearSample &s = samples[i];
+        const __m128i top = load_pair_sse41(src, s.offsets[0], s.offsets[1], end);
+        const __m128i bottom = load_pair_sse41(src, s.offsets[2], s.offsets[3], end);
+        const __m128 t00 = _mm_cvtepi32_ps(_mm_cvtepu8_epi32(top));
+        const __m128 t10 = _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_srli_si128(top, 3)));
+        const __m128 t01 = _mm_cvtepi32_ps(_mm_cvtepu8_epi32(bottom));
+        const __m128 t11 = _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_srli_si128(bottom, 3)));
+        const __m128 fx = _mm_set1_ps(s.fx);
+        const __m128 fy = _mm_set1_ps(s.fy);
+        const __m128 wx = _mm_set1_ps(1.0f - s.fx);
+        const __m128 wy = _mm_set1_ps(1.0f - s.fy);
+        const __m128 top_value = _mm_add_ps(_mm_mul_ps(t00, wx), _mm_mul_ps(t10, fx));
+        const __m128 bottom_value = _mm_add_ps(_mm_mul_ps(t01, wx), _mm_mul_ps(t11, fx));
+        const __m128 value = _mm_add_ps(_mm_mul_ps(top_value, wy), _mm_mul_ps(bottom_value, fy));
+        const __m128i v32 = _mm_cvttps_epi32(_mm_add_ps(value, half));
+        const __m128i v8 = _mm_packus_epi16(_mm_packus_epi32(v32, v32), v32);
+        store_rgb(dst_row + static_cast<std::size_t>(s.x) * 3, static_cast<std::uint32_t>(_mm_cvtsi128_si32(v8)));
+    }
+}
+
+// two samples per register: the first one in the low 128-bit lane, the second one in the high lane
+__attribute__((target("avx2"))) inline __m256 texels_avx2(__m128i a, __m128i b) {
+    return _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_unpacklo_epi32(a, b)));
+}
+
+__attribute__((target("avx2"))) void blend_rgb_avx2(const std::uint8_t *src, std::size_t end,
+                                                     const BilinearSample *samples, int n, std::uint8_t *dst_row) {
+    const __m256 half = _mm256_set1_ps(0.5f);
+    int i = 0;
+    for (; i + 2 <= n; i += 2) {
+        const BilinearSample &a = samples[i];
+        const BilinearSample &b = samples[i + 1];
+        const __m128i top_a = load_pair_sse41(src, a.offsets[0], a.offsets[1], end);
+        const __m128i top_b = load_pair_sse41(src, b.offsets[0], b.offsets[1], end);
+        const __m128i bottom_a = load_pair_sse41(src, a.offsets[2], a.offsets[3], end);
+        const __m128i bottom_b = load_pair_sse41(src, b.offsets[2], b.offsets[3], end);
+        const __m256 t00 = texels_avx2(top_a, top_b);
+        const __m256 t10 = texels_avx2(_mm_srli_si128(top_a, 3), _mm_srli_si128(top_b, 3));
+        const __m256 t01 = texels_avx2(bottom_a, bottom_b);
+        const __m256 t11 = texels_avx2(_mm_srli_si128(bottom_a, 3), _mm_srli_si128(bottom_b, 3));
+        const __m256 fx = _mm256_setr_m128(_mm_set1_ps(a.fx), _mm_set1_ps(b.fx));
+        const __m256 fy = _mm256_setr_m128(_mm_set1_ps(a.fy), _mm_set1_ps(b.fy));
+        const __m256 wx = _mm256_setr_m128(_mm_set1_ps(1.0f - a.fx), _mm_set1_ps(1.0f - b.fx));
+        const __m256 wy = _mm256_setr_m128(_mm_set1_ps(1.0f - a.fy), _mm_set1_ps(1.0f - b.fy));
+        const __m256 top_value = _mm256_add_ps(_mm256_mul_ps(t00, wx), _mm256_mul_ps(t10, fx));
+        const __m256 bottom_value = _mm256_add_ps(_mm256_mul_ps(t01, wx), _mm256_mul_ps(t11, fx));
+        const __m256 value = _mm256_add_ps(_mm256_mul_ps(top_value, wy), _mm256_mul_ps(bottom_value, fy));
+        const __m256i v32 = _mm256_cvttps_epi32(_mm256_add_ps(value, half));
+        // packs work within 128-bit lanes: bytes of the first sample are at 0..3, of the second one - at 16..19
+        const __m256i v8 = _mm256_packus_epi16(_mm256_packus_epi32(v32, v32), v32);
+        store_rgb(dst_row + static_cast<std::size_t>(a.x) * 3, static_cast<std::uint32_t>(_mm256_extract_epi32(v8, 0)));
+        store_rgb(dst_row + static_cast<std::size_t>(b.x) * 3, static_cast<std::uint32_t>(_mm256_extract_epi32(v8, 4)));
+    }
+    blend_scalar(src, 3, samples, i, n, dst_row);
+}
+
+#endif
+
+void map_row(SimdLevel level, const double *h, int y, int width, float *xs, float *ys) {
+    switch (level) {
+#ifdef LIBBASE_X86_SIMD
+    case SimdLevel::AVX2:
+        map_row_avx2(h, y, width, xs, ys);
+        return;
+    case SimdLevel::SSE41:
+        map_row_sse41(h, y, width, xs, ys);
+        return;
+#endif
+    default:
+        map_row_scalar(h, y, 0, width, xs, ys);
+    }
+}
+
+void blend(SimdLevel level, image8u_view src, const std::vector<BilinearSample> &samples, std::uint8_t *dst_row) {
+    const int n = static_cast<int>(samples.size());
+#ifdef LIBBASE_X86_SIMD
+    // the source data ends with the last pixel of its last row (a ROI can be followed by other pixels, but not always)
+    const std::size_t end = (src.height() - 1) * src.stride_elements() + static_cast<std::size_t>(src.width()) * 3;
+    if (src.channels() == 3) {
+        switch (level) {
+        case SimdLevel::AVX2:
+            blend_rgb_avx2(src.data(), end, samples.data(), n, dst_row);
+            return;
+        case SimdLevel::SSE41:
+            blend_rgb_sse41(src.data(), end, samples.data(), n, dst_row);
+            return;
+        case SimdLevel::Scalar:
+            break;
+        }
+    }
+#endif
+    blend_scalar(src.data(), src.channels(), samples.data(), 0, n, dst_row);
+}
+
+} // namespace
+
+void warpPerspective(image8u_view src, image8u_view src_mask, const Homography &dst_to_src, ImageView<std::uint8_t> dst,
+                     SimdLevel level) {
+    rassert(src.channels() == dst.channels(), 7123980412304, src.channels(), dst.channels());
+    rassert(src_mask.data() == nullptr || (src_mask.width() == src.width() && src_mask.height() == src.height()
+                                           && src_mask.channels() == 1), 7123980412305);
+    if (src.width() == 0 || src.height() == 0 || dst.width() == 0 || dst.height() == 0)
+        return;
+
+    level = supportedSimdLevel(level);
+    const int W = dst.width();
+    const int H = dst.height();
+
+    int bands = 1;
+#ifdef _OPENMP
+    bands = std::max(1, std::min(H, omp_get_max_threads()));
+#endif
+
+    #pragma omp parallel for schedule(static)
+    for (int band = 0; band < bands; ++band) {
+        const int y0 = static_cast<int>(static_cast<long long>(H) * band / bands);
+        const int y1 = static_cast<int>(static_cast<long long>(H) * (band + 1) / bands);
+        std::vector<float> xs(W), ys(W);
+        std::vector<BilinearSample> samples;
+        samples.reserve(W);
+        for (int y = y0; y < y1; ++y) {
+            map_row(level, dst_to_src.h, y, W, xs.data(), ys.data());
+            collect_row_samples(src, src_mask, xs.data(), ys.data(), W, samples);
+            blend(level, src, samples, dst.row(y));
+        }
+    }
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <array>
+
+#include <libbase/cpu_features.h>
+#include <libbase/point2.h>
+#include <libimages/image.h>
+
+// Projective transform of the plane: row-major 3x3 matrix h,
+// (x, y) -> ((h[0] x + h[1] y + h[2]) / w, (h[3] x + h[4] y + h[5]) / w), where w = h[6] x + h[7] y + h[8]
+struct Homography final {
+    double h[9] = {1.0, 0.0, 0.0,
+                   0.0, 1.0, 0.0,
+                   0.0, 0.0, 1.0};
+
+    // The homography that maps src[i] to dst[i], no three of the points may lie on a line
+    static Homography fromCorrespondences(const std::array<point2f, 4> &src, const std::array<point2f, 4> &dst);
+
+    Homography inverse() const;
+
+    point2f operator()(point2f p) const;
+};
+
+// Inverse warp: every pixel (x, y) of dst takes the color of src bilinearly interpolated at dst_to_src(x + 0.5, y + 0.5)
+// (i.e. dst is a canvas of cells with corners at integer coordinates, src coordinates are pixel centers as in contours).
+// Pixels whose nearest source pixel is outside of src (or is zero in src_mask, if it is not empty) are left untouched,
+// so pieces can be warped one by one into ROIs of a shared canvas.
+// The homography is stepped along each row (several pixels at once with SIMD) and rows are warped in parallel.
+// dst must have the same number of channels as src, 3-channel images are blended with the strongest supported SIMD
+// instructions up to level, all levels give the same result.
+void warpPerspective(image8u_view src, image8u_view src_mask, const Homography &dst_to_src, ImageView<std::uint8_t> dst,
+                     SimdLevel level = SimdLevel::AVX2);
@@ -0,0 +1,277 @@
+#include "warp_perspective.h"
+
+#include <gtest/gtest.h>
+
+#include <libbase/configure_working_directory.h>
+#include <libbase/fast_random.h>
+#include <libbase/timer.h>
+#include <libimages/debug_io.h>
+#include <libimages/image.h>
+#include <libimages/tests_utils.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+static image8u makeRandomImage(int w, int h, int c, FastRandom &r) {
+    image8u img(w, h, c);
+    for (std::uint8_t &v: img.pixels()) {
+        v = static_cast<std::uint8_t>(r.nextInt(0, 255));
+    }
+    return img;
+}
+
+// Smooth image (random values are too noisy to see what a warp did)
+static image8u makeGradientImage(int w, int h) {
+    image8u img(w, h, 3);
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            img(y, x, 0) = static_cast<std::uint8_t>(255 * x / std::max(1, w - 1));
+            img(y, x, 1) = static_cast<std::uint8_t>(255 * y / std::max(1, h - 1));
+            img(y, x, 2) = static_cast<std::uint8_t>(((x / 16 + y / 16) % 2) * 255);
+        }
+    }
+    return img;
+}
+
+// Elliptic object mask
+static image8u makeEllipseMask(int w, int h) {
+    image8u mask(w, h, 1);
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            const float dx = (x + 0.5f - 0.5f * w) / (0.5f * w);
+            const float dy = (y + 0.5f - 0.5f * h) / (0.5f * h);
+            mask(y, x) = (dx * dx + dy * dy <= 1.0f) ? 255 : 0;
+        }
+    }
+    return mask;
+}
+
+// Homography that maps a jittered quadrilateral inside src onto the whole dst (as in puzzle assembly)
+static Homography makeDstToSrc(int src_w, int src_h, int dst_w, int dst_h, FastRandom &r) {
+    const float jx = 0.15f * src_w;
+    const float jy = 0.15f * src_h;
+    const std::array<point2f, 4> src = {
+        point2f(r.nextFloat(0.0f, jx), r.nextFloat(0.0f, jy)),
+        point2f(src_w - r.nextFloat(0.0f, jx), r.nextFloat(0.0f, jy)),
+        point2f(src_w - r.nextFloat(0.0f, jx), src_h - r.nextFloat(0.0f, jy)),
+        point2f(r.nextFloat(0.0f, jx), src_h - r.nextFloat(0.0f, jy)),
+    };
+    const std::array<point2f, 4> dst = {
+        point2f(0.0f, 0.0f), point2f(dst_w, 0.0f), point2f(dst_w, dst_h), point2f(0.0f, dst_h),
+    };
+    return Homography::fromCorrespondences(src, dst).inverse();
+}
+
+// Reference: previous implementation from puzzle assembly - the homography is applied to every pixel center,
+// the nearest mask pixel and four source pixels are read through checked accessors
+static void referenceWarp(const image8u &src, const image8u &mask, const Homography &dst_to_src, image8u &dst) {
+    const double *m = dst_to_src.h;
+    const int W = src.width();
+    const int H = src.height();
+    for (int Y = 0; Y < dst.height(); ++Y) {
+        for (int X = 0; X < dst.width(); ++X) {
+            const double x = X + 0.5;
+            const double y = Y + 0.5;
+            const double w = m[6] * x + m[7] * y + m[8];
+            const float sx = static_cast<float>((m[0] * x + m[1] * y + m[2]) / w);
+            const float sy = static_cast<float>((m[3] * x + m[4] * y + m[5]) / w);
+
+            const int xi = (int) std::lround(sx);
+            const int yi = (int) std::lround(sy);
+            if (xi < 0 || xi >= W || yi < 0 || yi >= H || mask(yi, xi) != 255) continue;
+
+            const float cx = std::clamp(sx, 0.0f, float(W - 1));
+            const float cy = std::clamp(sy, 0.0f, float(H - 1));
+            const int x0 = (int) std::floor(cx);
+            const int y0 = (int) std::floor(cy);
+            const int x1 = std::min(x0 + 1, W - 1);
+            const int y1 = std::min(y0 + 1, H - 1);
+            const float fx = cx - float(x0);
+            const float fy = cy - float(y0);
+            for (int c = 0; c < src.channels(); ++c) {
+                const float top = src(y0, x0, c) * (1 - fx) + src(y0, x1, c) * fx;
+                const float bottom = src(y1, x0, c) * (1 - fx) + src(y1, x1, c) * fx;
+                dst(Y, X, c) = static_cast<std::uint8_t>(std::clamp((int) std::lround(top * (1 - fy) + bottom * fy), 0, 255));
+            }
+        }
+    }
+}
+
+static void expectEqualImages(const image8u &a, const image8u &b) {
+    ASSERT_EQ(a.size(), b.size());
+    std::size_t mismatches = 0;
+    for (std::size_t k = 0; k < a.pixels().size(); ++k) {
+        mismatches += (a.pixels()[k] != b.pixels()[k]);
+    }
+    EXPECT_EQ(mismatches, 0u);
+}
+
+// The row stepping sums up the homography in a different order than the per-pixel product,
+// so a pixel exactly on a mask border or between two source pixels may rarely go the other way
+static void expectAlmostEqualImages(const image8u &a, const image8u &b) {
+    ASSERT_EQ(a.size(), b.size());
+    std::size_t mismatches = 0;
+    for (std::size_t k = 0; k < a.pixels().size(); ++k) {
+        mismatches += (a.pixels()[k] != b.pixels()[k]);
+    }
+    EXPECT_LE(mismatches, a.pixels().size() / 1000);
+}
+
+// Maps dst pixel (x, y) onto src pixel (x, y): dst pixel centers are at half-integer coordinates, src ones - at integer
+static Homography pixelToPixel() {
+    Homography H;
+    H.h[2] = -0.5;
+    H.h[5] = -0.5;
+    return H;
+}
+
+} // namespace
+
+TEST(warp_perspective, homographyMapsCorrespondences) {
+    const std::array<point2f, 4> src = {point2f(3, 5), point2f(97, 11), point2f(88, 120), point2f(-4, 101)};
+    const std::array<point2f, 4> dst = {point2f(0, 0), point2f(200, 0), point2f(200, 200), point2f(0, 200)};
+    const Homography H = Homography::fromCorrespondences(src, dst);
+    const Homography inv = H.inverse();
+    for (int i = 0; i < 4; ++i) {
+        EXPECT_NEAR(H(src[i]).x, dst[i].x, 1e-3f);
+        EXPECT_NEAR(H(src[i]).y, dst[i].y, 1e-3f);
+        EXPECT_NEAR(inv(dst[i]).x, src[i].x, 1e-3f);
+        EXPECT_NEAR(inv(dst[i]).y, src[i].y, 1e-3f);
+    }
+}
+
+TEST(warp_perspective, identityCopiesImage) {
+    FastRandom r(239);
+    for (int c: {1, 3}) {
+        const image8u src = makeRandomImage(37, 23, c, r);
+        image8u dst(37, 23, c);
+        warpPerspective(src, image8u_view(), pixelToPixel(), dst);
+        expectEqualImages(dst, src);
+    }
+}
+
+TEST(warp_perspective, pixelsOutsideOfMaskAreUntouched) {
+    const image8u src = makeGradientImage(40, 30);
+    const image8u mask = makeEllipseMask(40, 30);
+    image8u dst(40, 30, 3);
+    dst.fill(7);
+    warpPerspective(src, mask, pixelToPixel(), dst);
+    for (int y = 0; y < 30; ++y) {
+        for (int x = 0; x < 40; ++x) {
+            for (int c = 0; c < 3; ++c) {
+                EXPECT_EQ(dst(y, x, c), mask(y, x) ? src(y, x, c) : 7);
+            }
+        }
+    }
+}
+
+TEST(warp_perspective, roiOfCanvas) {
+    FastRandom r(239);
+    const image8u src = makeGradientImage(90, 70);
+    const image8u mask = makeEllipseMask(90, 70);
+    const Homography dst_to_src = makeDstToSrc(90, 70, 60, 50, r);
+
+    image8u cell(60, 50, 3);
+    warpPerspective(src, mask, dst_to_src, cell);
+
+    // the same warp into a ROI of a bigger canvas - other pixels of the canvas are not touched
+    image8u canvas(100, 80, 3);
+    canvas.fill(7);
+    warpPerspective(src, mask, dst_to_src, ImageView<std::uint8_t>(canvas).roi(20, 10, 60, 50));
+    for (int y = 0; y < canvas.height(); ++y) {
+        for (int x = 0; x < canvas.width(); ++x) {
+            const bool inside = x >= 20 && x < 80 && y >= 10 && y < 60;
+            for (int c = 0; c < 3; ++c) {
+                if (inside) {
+                    const std::uint8_t expected = cell(y - 10, x - 20, c);
+                    // pixels outside of the mask are left untouched: black in the cell and 7 in the canvas
+                    EXPECT_TRUE(canvas(y, x, c) == expected || (expected == 0 && canvas(y, x, c) == 7));
+                } else {
+                    EXPECT_EQ(canvas(y, x, c), 7);
+                }
+            }
+        }
+    }
+    debug_io::dump_image(getUnitCaseDebugDir() + "00_src.png", src);
+    debug_io::dump_image(getUnitCaseDebugDir() + "01_canvas.png", canvas);
+}
+
+TEST(warp_perspective, equalsReferenceAndSimdLevelsAreTheSame) {
+    FastRandom r(239);
+    for (int iter = 0; iter < 10; ++iter) {
+        const int w = r.nextInt(1, 120);
+        const int h = r.nextInt(1, 120);
+        const int c = (iter % 3 == 2) ? 1 : 3;
+        const image8u src = makeRandomImage(w, h, c, r);
+        const image8u mask = makeEllipseMask(w, h);
+        const int dst_w = r.nextInt(1, 150);
+        const int dst_h = r.nextInt(1, 150);
+        const Homography dst_to_src = makeDstToSrc(w, h, dst_w, dst_h, r);
+
+        image8u expected(dst_w, dst_h, c);
+        referenceWarp(src, mask, dst_to_src, expected);
+
+        image8u scalar(dst_w, dst_h, c);
+        warpPerspective(src, mask, dst_to_src, scalar, SimdLevel::Scalar);
+        expectAlmostEqualImages(scalar, expected);
+
+        for (SimdLevel level: {SimdLevel::SSE41, SimdLevel::AVX2}) {
+            SCOPED_TRACE(std::string(simdLevelName(supportedSimdLevel(level))) + " " + std::to_string(w) + "x" + std::to_string(h) + "x" + std::to_string(c));
+            image8u warped(dst_w, dst_h, c);
+            warpPerspective(src, mask, dst_to_src, warped, level);
+            expectEqualImages(warped, scalar);
+        }
+    }
+}
+
+// Assembly of a puzzle of pieces_count pieces: every piece is warped into its own cell of a shared canvas
+static void benchmarkAssembly(int pieces_count, int piece_size, int cell_size) {
+    FastRandom r(2391);
+    const image8u piece = makeRandomImage(piece_size, piece_size, 3, r);
+    const image8u mask = makeEllipseMask(piece_size, piece_size);
+    const int columns = static_cast<int>(std::ceil(std::sqrt(pieces_count)));
+    const int rows = (pieces_count + columns - 1) / columns;
+    std::vector<Homography> homographies;
+    for (int i = 0; i < pieces_count; ++i) {
+        homographies.push_back(makeDstToSrc(piece_size, piece_size, cell_size, cell_size, r));
+    }
+
+    image8u expected(columns * cell_size, rows * cell_size, 3);
+    image8u canvas(columns * cell_size, rows * cell_size, 3);
+    image8u cell(cell_size, cell_size, 3);
+    Timer t;
+    for (int i = 0; i < pieces_count; ++i) {
+        cell.fill(0);
+        referenceWarp(piece, mask, homographies[i], cell);
+        for (int y = 0; y < cell_size; ++y) {
+            std::copy(cell.row(y), cell.row(y) + cell_size * 3, expected.row((i / columns) * cell_size + y) + (i % columns) * cell_size * 3);
+        }
+    }
+    const double reference_seconds = t.elapsed();
+    t.restart();
+    for (int i = 0; i < pieces_count; ++i) {
+        warpPerspective(piece, mask, homographies[i],
+                        ImageView<std::uint8_t>(canvas).roi((i % columns) * cell_size, (i / columns) * cell_size, cell_size, cell_size));
+    }
+    const double seconds = t.elapsed();
+    std::cout << pieces_count << " pieces " << piece_size << "x" << piece_size << " -> " << canvas.width() << "x" << canvas.height()
+              << " canvas (" << simdLevelName(maxSimdLevel()) << "): per-pixel reference " << reference_seconds
+              << " sec, warpPerspective " << seconds << " sec (x" << reference_seconds / seconds << ")" << std::endl;
+    expectAlmostEqualImages(canvas, expected);
+}
+
+TEST(warp_perspective, benchmark_small) {
+    benchmarkAssembly(36, 250, 200);
+}
+
+// 1000 pieces take a while with the reference implementation, run with --gtest_also_run_disabled_tests
+TEST(warp_perspective, DISABLED_benchmark_1000_pieces) {
+    benchmarkAssembly(1000, 250, 200);
+}
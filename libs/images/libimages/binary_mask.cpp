@@ -0,0 +1,152 @@
+#include "binary_mask.h"
+
+#include <libbase/runtime_assert.h>
+
+#include <algorithm>
+#include <bit>
+#include <string>
+
+BinaryMask::BinaryMask() = default;
+
+BinaryMask::BinaryMask(int width, int height) {
+    rassert(width >= 0 && height >= 0, 5129837410231, width, height);
+    w_ = width;
+    h_ = height;
+    words_ = (width + WORD_BITS - 1) / WORD_BITS;
+    data_ = std::vector<std::uint64_t>(static_cast<std::size_t>(words_) * static_cast<std::size_t>(height), 0);
+}
+
+BinaryMask::BinaryMask(const image8u &mask) : BinaryMask(mask.width(), mask.height()) {
+    rassert(mask.channels() == 1, 5129837410232, mask.channels());
+    const std::uint8_t *src = mask.data();
+    for (int j = 0; j < h_; ++j) {
+        std::uint64_t *dst = row(j);
+        const std::uint8_t *src_row = src + static_cast<std::size_t>(j) * mask.stride_elements();
+        // validation is fused with packing: a pixel is valid iff it is equal to 0 or to 255
+        bool all_valid = true;
+        for (int word = 0; word < words_; ++word) {
+            const int x0 = word * WORD_BITS;
+            const int n = std::min(WORD_BITS, w_ - x0);
+            std::uint64_t bits = 0;
+            for (int k = 0; k < n; ++k) {
+                const std::uint8_t v = src_row[x0 + k];
+                all_valid &= (v == 0 || v == 255);
+                bits |= static_cast<std::uint64_t>(v >> 7) << k;
+            }
+            dst[word] = bits;
+        }
+        rassert(all_valid, 5129837410233, "mask expects binary pixels {0,255}", "row", j);
+    }
+}
+
+int BinaryMask::width() const noexcept { return w_; }
+
+int BinaryMask::height() const noexcept { return h_; }
+
+int BinaryMask::words_per_row() const noexcept { return words_; }
+
+std::uint64_t *BinaryMask::row(int j, std::source_location loc) {
+    rassert(j >= 0 && j < h_, 5129837410234, "Row out of bounds:", j, "/", h_, format_code_location(loc));
+    return data_.data() + static_cast<std::size_t>(j) * static_cast<std::size_t>(words_);
+}
+
+const std::uint64_t *BinaryMask::row(int j, std::source_location loc) const {
+    rassert(j >= 0 && j < h_, 5129837410235, "Row out of bounds:", j, "/", h_, format_code_location(loc));
+    return data_.data() + static_cast<std::size_t>(j) * static_cast<std::size_t>(words_);
+}
+
+void BinaryMask::check_bounds(int j, int i, std::source_location loc) const {
+    rassert(j >= 0 && j < h_ && i >= 0 && i < w_, 5129837410236,
+            "Pixel out of bounds:", "j=" + std::to_string(j) + "/height=" + std::to_string(h_) + ",",
+            "i=" + std::to_string(i) + "/width=" + std::to_string(w_), format_code_location(loc));
+}
+
+bool BinaryMask::operator()(int j, int i, std::source_location loc) const {
+    check_bounds(j, i, loc);
+    const std::uint64_t word = data_[static_cast<std::size_t>(j) * words_ + i / WORD_BITS];
+    return (word >> (i % WORD_BITS)) & 1;
+}
+
+void BinaryMask::set(int j, int i, bool value, std::source_location loc) {
+    check_bounds(j, i, loc);
+    std::uint64_t &word = data_[static_cast<std::size_t>(j) * words_ + i / WORD_BITS];
+    const std::uint64_t bit = std::uint64_t(1) << (i % WORD_BITS);
+    word = value ? (word | bit) : (word & ~bit);
+}
+
+std::uint64_t BinaryMask::tail_mask(int width) noexcept {
+    const int tail = width % WORD_BITS;
+    return tail == 0 ? ~std::uint64_t(0) : (std::uint64_t(1) << tail) - 1;
+}
+
+void BinaryMask::fill(bool value) {
+    if (!value) {
+        std::fill(data_.begin(), data_.end(), 0);
+        return;
+    }
+    std::fill(data_.begin(), data_.end(), ~std::uint64_t(0));
+    const std::uint64_t tail = tail_mask(w_);
+    for (int j = 0; j < h_ && words_ > 0; ++j) {
+        row(j)[words_ - 1] &= tail;
+    }
+}
+
+std::size_t BinaryMask::count() const noexcept {
+    std::size_t total = 0;
+    for (std::uint64_t word : data_) {
+        total += std::popcount(word);
+    }
+    return total;
+}
+
+void BinaryMask::check_same_size(const BinaryMask &other) const {
+    rassert(w_ == other.w_ && h_ == other.h_, 5129837410237, w_, h_, other.w_, other.h_);
+}
+
+BinaryMask &BinaryMask::operator&=(const BinaryMask &other) {
+    check_same_size(other);
+    for (std::size_t k = 0; k < data_.size(); ++k) {
+        data_[k] &= other.data_[k];
+    }
+    return *this;
+}
+
+BinaryMask &BinaryMask::operator|=(const BinaryMask &other) {
+    check_same_size(other);
+    for (std::size_t k = 0; k < data_.size(); ++k) {
+        data_[k] |= other.data_[k];
+    }
+    return *this;
+}
+
+BinaryMask BinaryMask::operator~() const {
+    BinaryMask inverted(w_, h_);
+    const std::uint64_t tail = tail_mask(w_);
+    for (int j = 0; j < h_; ++j) {
+        const std::uint64_t *src = row(j);
+        std::uint64_t *dst = inverted.row(j);
+        for (int word = 0; word < words_; ++word) {
+            dst[word] = ~src[word];
+        }
+        if (words_ > 0)
+            dst[words_ - 1] &= tail;
+    }
+    return inverted;
+}
+
+image8u BinaryMask::toImage() const {
+    image8u mask(w_, h_, 1, ImageInit::Uninitialized);
+    std::uint8_t *dst = mask.data();
+    for (int j = 0; j < h_; ++j) {
+        const std::uint64_t *src = row(j);
+        std::uint8_t *dst_row = dst + static_cast<std::size_t>(j) * mask.stride_elements();
+        for (int i = 0; i < w_; ++i) {
+            dst_row[i] = ((src[i / WORD_BITS] >> (i % WORD_BITS)) & 1) ? 255 : 0;
+        }
+    }
+    return mask;
+}
+
+bool BinaryMask::operator==(const BinaryMask &other) const noexcept {
+    return w_ == other.w_ && h_ == other.h_ && data_ == other.data_;
+}
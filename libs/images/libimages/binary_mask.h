@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <source_location>
+#include <vector>
+
+#include <libimages/image.h>
+
+// Binary mask with 1 bit per pixel: each row is packed into 64-bit words,
+// pixel x of a row is bit (x % 64) of word (x / 64). Bits after the last pixel of a row are always zero,
+// so that whole-word operations (AND/OR/popcount) can ignore the row width.
+class BinaryMask final {
+  public:
+    static constexpr int WORD_BITS = 64;
+
+    BinaryMask();
+    BinaryMask(int width, int height); // all pixels are 0
+    // From a mask image with pixels 0 and 255 (anything else is an error)
+    explicit BinaryMask(const image8u &mask);
+
+    int width() const noexcept;
+    int height() const noexcept;
+    int words_per_row() const noexcept;
+
+    std::uint64_t *row(int j, std::source_location loc = std::source_location::current());
+    const std::uint64_t *row(int j, std::source_location loc = std::source_location::current()) const;
+
+    bool operator()(int j, int i, std::source_location loc = std::source_location::current()) const;
+    void set(int j, int i, bool value, std::source_location loc = std::source_location::current());
+
+    void fill(bool value);
+
+    // Number of set pixels
+    std::size_t count() const noexcept;
+
+    BinaryMask &operator&=(const BinaryMask &other);
+    BinaryMask &operator|=(const BinaryMask &other);
+    BinaryMask operator~() const;
+
+    // Mask image with 0 and 255
+    image8u toImage() const;
+
+    bool operator==(const BinaryMask &other) const noexcept;
+    bool operator!=(const BinaryMask &other) const noexcept { return !(*this == other); }
+
+    // Bits of the last word of a row that correspond to pixels
+    static std::uint64_t tail_mask(int width) noexcept;
+
+  private:
+    int w_ = 0;
+    int h_ = 0;
+    int words_ = 0;
+    std::vector<std::uint64_t> data_;
+
+    void check_bounds(int j, int i, std::source_location loc) const;
+    void check_same_size(const BinaryMask &other) const;
+};
+
+inline BinaryMask operator&(BinaryMask a, const BinaryMask &b) { return a &= b; }
+inline BinaryMask operator|(BinaryMask a, const BinaryMask &b) { return a |= b; }
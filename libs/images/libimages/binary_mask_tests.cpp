@@ -0,0 +1,86 @@
+#include "binary_mask.h"
+
+#include <gtest/gtest.h>
+
+#include <libbase/fast_random.h>
+#include <libbase/runtime_assert.h>
+
+#include <cstdint>
+
+namespace {
+
+image8u makeRandomMask(int w, int h, uint32_t seed) {
+    FastRandom r(seed);
+    image8u mask(w, h, 1);
+    for (int j = 0; j < h; ++j)
+        for (int i = 0; i < w; ++i)
+            mask(j, i) = r.nextInt(0, 1) ? 255 : 0;
+    return mask;
+}
+
+int countWhite(const image8u &mask) {
+    int count = 0;
+    for (int j = 0; j < mask.height(); ++j)
+        for (int i = 0; i < mask.width(); ++i)
+            count += mask(j, i) == 255;
+    return count;
+}
+
+} // namespace
+
+TEST(binary_mask, packAndUnpack) {
+    for (int w : {1, 63, 64, 65, 130}) {
+        const image8u image = makeRandomMask(w, 7, 239 + w);
+        const BinaryMask mask(image);
+        EXPECT_EQ(mask.width(), w);
+        EXPECT_EQ(mask.height(), 7);
+        EXPECT_EQ(mask.words_per_row(), (w + 63) / 64);
+        for (int j = 0; j < 7; ++j)
+            for (int i = 0; i < w; ++i)
+                EXPECT_EQ(mask(j, i), image(j, i) == 255);
+        EXPECT_EQ(mask.count(), countWhite(image));
+
+        const image8u unpacked = mask.toImage();
+        EXPECT_EQ(unpacked.toVector(), image.toVector());
+    }
+}
+
+TEST(binary_mask, bitOperations) {
+    const BinaryMask a(makeRandomMask(100, 5, 1));
+    const BinaryMask b(makeRandomMask(100, 5, 2));
+    const BinaryMask both = a & b;
+    const BinaryMask any = a | b;
+    const BinaryMask not_a = ~a;
+    for (int j = 0; j < 5; ++j) {
+        for (int i = 0; i < 100; ++i) {
+            EXPECT_EQ(both(j, i), a(j, i) && b(j, i));
+            EXPECT_EQ(any(j, i), a(j, i) || b(j, i));
+            EXPECT_EQ(not_a(j, i), !a(j, i));
+        }
+    }
+    // bits after the end of a row stay zero, so popcount is exact
+    EXPECT_EQ(not_a.count() + a.count(), 500);
+
+    BinaryMask full(100, 5);
+    full.fill(true);
+    EXPECT_EQ(full.count(), 500);
+    EXPECT_EQ(~full, BinaryMask(100, 5));
+}
+
+TEST(binary_mask, setAndBounds) {
+    BinaryMask mask(70, 3);
+    mask.set(2, 69, true);
+    mask.set(0, 0, true);
+    mask.set(0, 0, false);
+    EXPECT_TRUE(mask(2, 69));
+    EXPECT_FALSE(mask(0, 0));
+    EXPECT_EQ(mask.count(), 1);
+
+    EXPECT_THROW(mask(3, 0), assertion_error);
+    EXPECT_THROW(mask.set(0, 70, true), assertion_error);
+    EXPECT_THROW(mask &= BinaryMask(71, 3), assertion_error);
+
+    image8u not_binary(4, 4, 1);
+    not_binary(1, 2) = 128;
+    EXPECT_THROW(BinaryMask{not_binary}, assertion_error);
+}
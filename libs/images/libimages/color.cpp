@@ -15,7 +15,7 @@ template <typename T>
 void Color<T>::init(int channels) {
     rassert(channels == 1 || channels == 3, "Invalid color channels count", channels);
     c_ = channels;
-    data_.assign(static_cast<std::size_t>(c_), T(0));
+    data_.fill(T(0));
 }
 
 template <typename T>
@@ -54,12 +54,12 @@ const T* Color<T>::data() const noexcept {
 
 template <typename T>
 std::vector<T> Color<T>::toVector() const {
-    return data_;
+    return std::vector<T>(data_.begin(), data_.begin() + c_);
 }
 
 template <typename T>
 void Color<T>::fill(const T& v) {
-    std::fill(data_.begin(), data_.end(), v);
+    std::fill(data_.begin(), data_.begin() + c_, v);
 }
 
 template <typename T>
@@ -84,7 +84,7 @@ const T& Color<T>::operator()(int c, std::source_location loc) const {
 template <typename T>
 bool Color<T>::operator==(const Color<T>& other) const noexcept {
     if (c_ != other.c_) return false;
-    return data_ == other.data_;
+    return std::equal(data_.begin(), data_.begin() + c_, other.data_.begin());
 }
 
 // Explicit instantiations
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <array>
 #include <cstdint>
 #include <cstddef>
 #include <source_location>
@@ -7,6 +8,7 @@
 #include <vector>
 #include <variant>
 
+// Small fixed-size color (1 or 3 channels) - stored inline, without heap allocations
 template <typename T> class Color final {
 public:
     using value_type = T;
@@ -32,7 +34,7 @@ public:
 
 private:
     int c_ = 0;
-    std::vector<T> data_;
+    std::array<T, 3> data_{};
 
     void init(int channels);
     void check_bounds(int c, std::source_location loc) const;
@@ -0,0 +1,116 @@
+#include "color_strip.h"
+
+#include <libbase/runtime_assert.h>
+
+#include <algorithm>
+#include <string>
+
+template <typename T> ColorStrip<T>::ColorStrip() = default;
+
+template <typename T>
+void ColorStrip<T>::init(int length, int channels) {
+    rassert(length >= 0, 4312987310921, length);
+    rassert(channels == 1 || channels == 3, 4312987310922, channels);
+    n_ = length;
+    c_ = channels;
+    data_ = std::vector<T>(static_cast<std::size_t>(length) * static_cast<std::size_t>(channels));
+}
+
+template <typename T>
+ColorStrip<T>::ColorStrip(int length, int channels) {
+    init(length, channels);
+}
+
+template <typename T>
+ColorStrip<T>::ColorStrip(int length, const Color<T> &value) {
+    init(length, value.channels());
+    for (int c = 0; c < c_; ++c) {
+        std::fill_n(channel(c), n_, value(c));
+    }
+}
+
+template <typename T>
+ColorStrip<T>::ColorStrip(const std::vector<Color<T>> &colors) {
+    init(static_cast<int>(colors.size()), colors.empty() ? 3 : colors[0].channels());
+    for (int i = 0; i < n_; ++i) {
+        setColor(i, colors[i]);
+    }
+}
+
+template <typename T> int ColorStrip<T>::length() const noexcept { return n_; }
+
+template <typename T> int ColorStrip<T>::channels() const noexcept { return c_; }
+
+template <typename T> bool ColorStrip<T>::empty() const noexcept { return n_ == 0; }
+
+template <typename T> T *ColorStrip<T>::data() noexcept { return data_.data(); }
+
+template <typename T> const T *ColorStrip<T>::data() const noexcept { return data_.data(); }
+
+template <typename T> T *ColorStrip<T>::channel(int c, std::source_location loc) {
+    rassert(c >= 0 && c < c_, 4312987310923, "Channel out of bounds:", c, "/", c_, format_code_location(loc));
+    return data_.data() + static_cast<std::size_t>(c) * static_cast<std::size_t>(n_);
+}
+
+template <typename T> const T *ColorStrip<T>::channel(int c, std::source_location loc) const {
+    rassert(c >= 0 && c < c_, 4312987310924, "Channel out of bounds:", c, "/", c_, format_code_location(loc));
+    return data_.data() + static_cast<std::size_t>(c) * static_cast<std::size_t>(n_);
+}
+
+template <typename T> void ColorStrip<T>::fill(const T &value) { std::fill(data_.begin(), data_.end(), value); }
+
+template <typename T> void ColorStrip<T>::check_bounds(int i, int c, std::source_location loc) const {
+    rassert(i >= 0 && i < n_ && c >= 0 && c < c_, 4312987310925,
+            "Color out of bounds:", "i=" + std::to_string(i) + "/length=" + std::to_string(n_) + ",",
+            "c=" + std::to_string(c) + "/channels=" + std::to_string(c_), format_code_location(loc));
+}
+
+template <typename T> T &ColorStrip<T>::operator()(int i, int c, std::source_location loc) {
+    check_bounds(i, c, loc);
+    return data_[static_cast<std::size_t>(c) * static_cast<std::size_t>(n_) + static_cast<std::size_t>(i)];
+}
+
+template <typename T> const T &ColorStrip<T>::operator()(int i, int c, std::source_location loc) const {
+    check_bounds(i, c, loc);
+    return data_[static_cast<std::size_t>(c) * static_cast<std::size_t>(n_) + static_cast<std::size_t>(i)];
+}
+
+template <typename T> Color<T> ColorStrip<T>::color(int i, std::source_location loc) const {
+    check_bounds(i, 0, loc);
+    if (c_ == 1)
+        return Color<T>((*this)(i, 0));
+    return Color<T>((*this)(i, 0), (*this)(i, 1), (*this)(i, 2));
+}
+
+template <typename T> void ColorStrip<T>::setColor(int i, const Color<T> &color, std::source_location loc) {
+    check_bounds(i, 0, loc);
+    rassert(color.channels() == c_, 4312987310926, color.channels(), c_, format_code_location(loc));
+    for (int c = 0; c < c_; ++c) {
+        (*this)(i, c) = color(c);
+    }
+}
+
+template <typename T> ColorStrip<T> ColorStrip<T>::reversed() const {
+    ColorStrip<T> out(n_, c_);
+    for (int c = 0; c < c_; ++c) {
+        std::reverse_copy(channel(c), channel(c) + n_, out.channel(c));
+    }
+    return out;
+}
+
+template <typename T> std::vector<Color<T>> ColorStrip<T>::toColors() const {
+    std::vector<Color<T>> colors;
+    colors.reserve(static_cast<std::size_t>(n_));
+    for (int i = 0; i < n_; ++i) {
+        colors.push_back(color(i));
+    }
+    return colors;
+}
+
+template <typename T> bool ColorStrip<T>::operator==(const ColorStrip<T> &other) const noexcept {
+    return n_ == other.n_ && c_ == other.c_ && data_ == other.data_;
+}
+
+// Explicit instantiations
+template class ColorStrip<std::uint8_t>;
+template class ColorStrip<float>;
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <source_location>
+#include <vector>
+
+#include <libimages/color.h>
+
+// Sequence of colors (f.e. colors along a side of a puzzle piece) stored as structure of arrays:
+// one contiguous allocation with planes [channel 0: n values][channel 1: n values]...
+// so that each channel can be processed by a simple (vectorizable) loop over a plain pointer.
+template <typename T> class ColorStrip final {
+  public:
+    using value_type = T;
+
+    ColorStrip();
+    ColorStrip(int length, int channels);
+    ColorStrip(int length, const Color<T> &value);
+    explicit ColorStrip(const std::vector<Color<T>> &colors);
+
+    int length() const noexcept;
+    int channels() const noexcept;
+    bool empty() const noexcept;
+
+    T *data() noexcept;
+    const T *data() const noexcept;
+
+    // Plane of channel c - length() contiguous values
+    T *channel(int c, std::source_location loc = std::source_location::current());
+    const T *channel(int c, std::source_location loc = std::source_location::current()) const;
+
+    void fill(const T &value);
+
+    T &operator()(int i, int c, std::source_location loc = std::source_location::current());
+    const T &operator()(int i, int c, std::source_location loc = std::source_location::current()) const;
+
+    Color<T> color(int i, std::source_location loc = std::source_location::current()) const;
+    void setColor(int i, const Color<T> &color, std::source_location loc = std::source_location::current());
+
+    // The same colors in the opposite order
+    ColorStrip reversed() const;
+
+    std::vector<Color<T>> toColors() const;
+
+    bool operator==(const ColorStrip &other) const noexcept;
+    bool operator!=(const ColorStrip &other) const noexcept { return !(*this == other); }
+
+  private:
+    int n_ = 0;
+    int c_ = 0;
+    std::vector<T> data_;
+
+    void init(int length, int channels);
+    void check_bounds(int i, int c, std::source_location loc) const;
+};
+
+extern template class ColorStrip<std::uint8_t>;
+extern template class ColorStrip<float>;
+
+using color_strip8u = ColorStrip<std::uint8_t>;
+using color_strip32f = ColorStrip<float>;
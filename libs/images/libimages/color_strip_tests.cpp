@@ -0,0 +1,55 @@
+#include "color_strip.h"
+
+#include <gtest/gtest.h>
+
+#include <libbase/runtime_assert.h>
+
+#include <cstdint>
+#include <vector>
+
+TEST(color_strip, planarLayout) {
+    color_strip8u strip(4, 3);
+    strip.fill(0);
+    strip.setColor(1, color8u(10, 20, 30));
+
+    // channels are stored as separate contiguous planes
+    EXPECT_EQ(strip.channel(0), strip.data());
+    EXPECT_EQ(strip.channel(1), strip.data() + 4);
+    EXPECT_EQ(strip.channel(2), strip.data() + 8);
+    EXPECT_EQ(strip.channel(0)[1], 10);
+    EXPECT_EQ(strip.channel(1)[1], 20);
+    EXPECT_EQ(strip.channel(2)[1], 30);
+    EXPECT_EQ(strip(1, 2), 30);
+    EXPECT_EQ(strip.color(1), color8u(10, 20, 30));
+    EXPECT_EQ(strip.color(0), color8u(0, 0, 0));
+}
+
+TEST(color_strip, fromColorsAndBack) {
+    std::vector<color8u> colors;
+    for (int i = 0; i < 10; ++i) {
+        colors.emplace_back((uint8_t) i, (uint8_t) (2 * i), (uint8_t) (3 * i));
+    }
+    color_strip8u strip(colors);
+    EXPECT_EQ(strip.length(), 10);
+    EXPECT_EQ(strip.channels(), 3);
+    EXPECT_EQ(strip.toColors(), colors);
+
+    color_strip8u reversed = strip.reversed();
+    for (int i = 0; i < 10; ++i) {
+        EXPECT_EQ(reversed.color(i), colors[9 - i]);
+    }
+    EXPECT_EQ(reversed.reversed(), strip);
+
+    color_strip32f gray(5, color32f(0.5f));
+    EXPECT_EQ(gray.channels(), 1);
+    EXPECT_EQ(gray.color(4), color32f(0.5f));
+}
+
+TEST(color_strip, boundsChecked) {
+    color_strip8u strip(3, 3);
+    EXPECT_THROW(strip(3, 0), assertion_error);
+    EXPECT_THROW(strip(0, 3), assertion_error);
+    EXPECT_THROW(strip.channel(-1), assertion_error);
+    EXPECT_THROW(strip.setColor(0, color8u(1)), assertion_error);
+    EXPECT_THROW(color_strip8u(3, 2), assertion_error);
+}
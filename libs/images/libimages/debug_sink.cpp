@@ -0,0 +1,160 @@
+#include "debug_sink.h"
+
+#include <iostream>
+#include <utility>
+
+#include <libbase/runtime_assert.h>
+#include <libimages/debug_io.h>
+
+namespace debug_io {
+
+DebugLevel parseDebugLevel(const std::string &name) {
+    if (name == "off")
+        return DebugLevel::Off;
+    if (name == "summary")
+        return DebugLevel::Summary;
+    if (name == "full")
+        return DebugLevel::Full;
+    rassert(false, 8127301923817, "unknown debug level (expected off/summary/full):", name);
+    return DebugLevel::Off;
+}
+
+AsyncImageWriter::AsyncImageWriter(std::size_t max_queued_images) : max_queued_(max_queued_images) {
+    rassert(max_queued_images > 0, 5129837120931);
+    thread_ = std::thread([this]() { run(); });
+}
+
+AsyncImageWriter::~AsyncImageWriter() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    queue_changed_.notify_all();
+    thread_.join();
+}
+
+void AsyncImageWriter::enqueue(std::string path, image8u img) { push(Task{std::move(path), std::move(img)}); }
+
+void AsyncImageWriter::enqueue(std::string path, image32f img, float void_value) {
+    push(Task{std::move(path), Float32Image{std::move(img), void_value}});
+}
+
+void AsyncImageWriter::push(Task task) {
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        queue_changed_.wait(lock, [&]() { return queue_.size() < max_queued_; });
+        queue_.push_back(std::move(task));
+    }
+    queue_changed_.notify_all();
+}
+
+void AsyncImageWriter::flush() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    queue_changed_.wait(lock, [&]() { return queue_.empty() && !in_progress_; });
+}
+
+std::size_t AsyncImageWriter::saved_count() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return saved_count_;
+}
+
+std::size_t AsyncImageWriter::failed_count() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return failed_count_;
+}
+
+void AsyncImageWriter::run() {
+    while (true) {
+        Task task;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            queue_changed_.wait(lock, [&]() { return !queue_.empty() || stopping_; });
+            if (queue_.empty())
+                return; // stopping and nothing left to save
+            task = std::move(queue_.front());
+            queue_.pop_front();
+            in_progress_ = true;
+        }
+        queue_changed_.notify_all();
+
+        bool ok = true;
+        try {
+            if (const image8u *img = std::get_if<image8u>(&task.img)) {
+                dump_image(task.path, *img);
+            } else {
+                const Float32Image &f = std::get<Float32Image>(task.img);
+                dump_image(task.path, f.img, f.void_value);
+            }
+        } catch (const std::exception &e) {
+            // debug artifacts must not break processing - just report the failure
+            std::cerr << "[debug_io] failed to save " << task.path << ": " << e.what() << std::endl;
+            ok = false;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            in_progress_ = false;
+            ++(ok ? saved_count_ : failed_count_);
+        }
+        queue_changed_.notify_all();
+    }
+}
+
+DebugSink::DebugSink(DebugLevel level, std::string dir, std::shared_ptr<AsyncImageWriter> writer)
+    : level_(level), dir_(std::move(dir)), writer_(std::move(writer)) {}
+
+DebugSink DebugSink::subdir(const std::string &name) const { return DebugSink(level_, dir_ + name + "/", writer_); }
+
+void DebugSink::dump(DebugLevel level, const std::string &filename, const image8u &img) const {
+    if (!enabled(level))
+        return;
+    if (writer_) {
+        writer_->enqueue(dir_ + filename, image8u(img));
+    } else {
+        dump_image(dir_ + filename, img);
+    }
+}
+
+void DebugSink::dump(DebugLevel level, const std::string &filename, image8u &&img) const {
+    if (!enabled(level))
+        return;
+    if (writer_) {
+        writer_->enqueue(dir_ + filename, std::move(img));
+    } else {
+        dump_image(dir_ + filename, img);
+    }
+}
+
+void DebugSink::dump(DebugLevel level, const std::string &filename, const image32f &img, float void_value) const {
+    if (!enabled(level))
+        return;
+    if (writer_) {
+        writer_->enqueue(dir_ + filename, image32f(img), void_value);
+    } else {
+        dump_image(dir_ + filename, img, void_value);
+    }
+}
+
+void DebugSink::dump(DebugLevel level, const std::string &filename, image32f &&img, float void_value) const {
+    if (!enabled(level))
+        return;
+    if (writer_) {
+        writer_->enqueue(dir_ + filename, std::move(img), void_value);
+    } else {
+        dump_image(dir_ + filename, img, void_value);
+    }
+}
+
+void DebugSink::dump(DebugLevel level, const std::string &filename, image8u_view img) const {
+    if (!enabled(level))
+        return;
+    dump(level, filename, img.copy());
+}
+
+void DebugSink::dump(DebugLevel level, const std::string &filename, const BinaryMask &mask) const {
+    if (!enabled(level))
+        return;
+    dump(level, filename, mask.toImage());
+}
+
+} // namespace debug_io
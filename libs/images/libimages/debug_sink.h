@@ -0,0 +1,105 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <variant>
+
+#include <libimages/binary_mask.h>
+#include <libimages/image.h>
+
+namespace debug_io {
+
+enum class DebugLevel {
+    Off,     // nothing is built, encoded or saved
+    Summary, // only a few per-image visualizations
+    Full,    // everything: per-image, per-object and per-pair visualizations
+};
+
+// "off" / "summary" / "full"
+DebugLevel parseDebugLevel(const std::string &name);
+
+// Saves debug images on a background thread, so that JPEG/PNG encoding and directories creation
+// are done off the critical path. Queue is bounded - enqueue() blocks if the writer falls behind.
+class AsyncImageWriter final {
+  public:
+    explicit AsyncImageWriter(std::size_t max_queued_images = 64);
+    // Saves everything that is still queued
+    ~AsyncImageWriter();
+
+    AsyncImageWriter(const AsyncImageWriter &) = delete;
+    AsyncImageWriter &operator=(const AsyncImageWriter &) = delete;
+
+    void enqueue(std::string path, image8u img);
+    void enqueue(std::string path, image32f img, float void_value = std::numeric_limits<float>::max());
+
+    // Blocks until all queued images are saved
+    void flush();
+
+    std::size_t saved_count() const;
+    std::size_t failed_count() const;
+
+  private:
+    struct Float32Image {
+        image32f img;
+        float void_value;
+    };
+    struct Task {
+        std::string path;
+        std::variant<image8u, Float32Image> img;
+    };
+
+    void push(Task task);
+    void run();
+
+    const std::size_t max_queued_;
+    mutable std::mutex mutex_;
+    std::condition_variable queue_changed_;
+    std::deque<Task> queue_;
+    bool in_progress_ = false;
+    bool stopping_ = false;
+    std::size_t saved_count_ = 0;
+    std::size_t failed_count_ = 0;
+    std::thread thread_;
+};
+
+// Debug artifacts sink of a pipeline: artifact is saved only if its level is enabled,
+// so callers should build visualizations only under if (sink.enabled(level)) { ... }
+// With writer == nullptr images are saved synchronously (with debug_io::dump_image).
+class DebugSink final {
+  public:
+    DebugSink() = default; // DebugLevel::Off
+    DebugSink(DebugLevel level, std::string dir, std::shared_ptr<AsyncImageWriter> writer = nullptr);
+
+    DebugLevel level() const noexcept { return level_; }
+    bool enabled(DebugLevel level) const noexcept { return level != DebugLevel::Off && level <= level_; }
+
+    const std::string &dir() const noexcept { return dir_; }
+
+    // Sink with the same level and writer, but saving to dir() + name + "/"
+    DebugSink subdir(const std::string &name) const;
+
+    // Image is copied only if the level is enabled, temporaries are moved
+    void dump(DebugLevel level, const std::string &filename, const image8u &img) const;
+    void dump(DebugLevel level, const std::string &filename, image8u &&img) const;
+    void dump(DebugLevel level, const std::string &filename, const image32f &img,
+              float void_value = std::numeric_limits<float>::max()) const;
+    void dump(DebugLevel level, const std::string &filename, image32f &&img,
+              float void_value = std::numeric_limits<float>::max()) const;
+    // View is copied only if the level is enabled
+    void dump(DebugLevel level, const std::string &filename, image8u_view img) const;
+    // Mask is unpacked to 0/255 image only if the level is enabled
+    void dump(DebugLevel level, const std::string &filename, const BinaryMask &mask) const;
+
+  private:
+    DebugLevel level_ = DebugLevel::Off;
+    std::string dir_;
+    std::shared_ptr<AsyncImageWriter> writer_;
+};
+
+} // namespace debug_io
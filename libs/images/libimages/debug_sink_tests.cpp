@@ -0,0 +1,92 @@
+#include "debug_sink.h"
+
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <memory>
+
+#include <libbase/configure_working_directory.h>
+#include <libbase/runtime_assert.h>
+#include <libimages/tests_utils.h>
+
+static image8u makeGradient(int w, int h) {
+    image8u img(w, h, 3);
+    for (int j = 0; j < h; ++j) {
+        for (int i = 0; i < w; ++i) {
+            img(j, i, 0) = (unsigned char)(i * 255 / w);
+            img(j, i, 1) = (unsigned char)(j * 255 / h);
+            img(j, i, 2) = 128;
+        }
+    }
+    return img;
+}
+
+TEST(debug_sink, parseLevel) {
+    EXPECT_EQ(debug_io::parseDebugLevel("off"), debug_io::DebugLevel::Off);
+    EXPECT_EQ(debug_io::parseDebugLevel("summary"), debug_io::DebugLevel::Summary);
+    EXPECT_EQ(debug_io::parseDebugLevel("full"), debug_io::DebugLevel::Full);
+    EXPECT_THROW(debug_io::parseDebugLevel("verbose"), assertion_error);
+}
+
+TEST(debug_sink, levelsFiltering) {
+    configureWorkingDirectory();
+
+    std::string dir = getUnitCaseDebugDir();
+    std::filesystem::remove_all(dir);
+
+    debug_io::DebugSink off;
+    EXPECT_FALSE(off.enabled(debug_io::DebugLevel::Summary));
+    EXPECT_FALSE(off.enabled(debug_io::DebugLevel::Full));
+    off.dump(debug_io::DebugLevel::Summary, "off.png", makeGradient(8, 8));
+
+    debug_io::DebugSink summary(debug_io::DebugLevel::Summary, dir);
+    EXPECT_TRUE(summary.enabled(debug_io::DebugLevel::Summary));
+    EXPECT_FALSE(summary.enabled(debug_io::DebugLevel::Full));
+    EXPECT_FALSE(summary.enabled(debug_io::DebugLevel::Off));
+    summary.dump(debug_io::DebugLevel::Summary, "summary.png", makeGradient(8, 8));
+    summary.subdir("sub").dump(debug_io::DebugLevel::Full, "full.png", makeGradient(8, 8));
+
+    EXPECT_TRUE(std::filesystem::exists(dir + "summary.png"));
+    EXPECT_FALSE(std::filesystem::exists(dir + "sub/full.png"));
+    EXPECT_FALSE(std::filesystem::exists("off.png"));
+}
+
+TEST(debug_sink, asyncWriter) {
+    configureWorkingDirectory();
+
+    std::string dir = getUnitCaseDebugDir();
+    std::filesystem::remove_all(dir);
+
+    const int n = 20;
+    auto writer = std::make_shared<debug_io::AsyncImageWriter>(4); // small queue to exercise backpressure
+    debug_io::DebugSink sink(debug_io::DebugLevel::Full, dir, writer);
+    for (int k = 0; k < n; ++k) {
+        sink.subdir("objects/" + std::to_string(k)).dump(debug_io::DebugLevel::Full, "gradient.png", makeGradient(32, 16));
+    }
+    image32f values(10, 10, 1);
+    values.fill(1.0f);
+    sink.dump(debug_io::DebugLevel::Summary, "values.jpg", values);
+
+    writer->flush();
+    EXPECT_EQ(writer->saved_count(), n + 1);
+    EXPECT_EQ(writer->failed_count(), 0);
+    for (int k = 0; k < n; ++k) {
+        EXPECT_TRUE(std::filesystem::exists(dir + "objects/" + std::to_string(k) + "/gradient.png"));
+    }
+    EXPECT_TRUE(std::filesystem::exists(dir + "values.jpg"));
+}
+
+TEST(debug_sink, asyncWriterSavesQueuedOnDestruction) {
+    configureWorkingDirectory();
+
+    std::string dir = getUnitCaseDebugDir();
+    std::filesystem::remove_all(dir);
+
+    {
+        debug_io::AsyncImageWriter writer;
+        writer.enqueue(dir + "a.png", makeGradient(16, 16));
+        writer.enqueue(dir + "b.png", makeGradient(16, 16));
+    }
+    EXPECT_TRUE(std::filesystem::exists(dir + "a.png"));
+    EXPECT_TRUE(std::filesystem::exists(dir + "b.png"));
+}
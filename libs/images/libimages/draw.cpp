@@ -101,7 +101,7 @@ void drawPoint(Image<T>& image, point2i pixel, Color<T> c, int size) {
 }
 
 template <typename T>
-void drawPoints(Image<T>& image, const std::vector<point2i>& pixels, Color<T> c, int size) {
+void drawPoints(Image<T>& image, std::span<const point2i> pixels, Color<T> c, int size) {
     for (const auto& p : pixels) {
         drawPoint(image, p, c, size);
     }
@@ -114,5 +114,5 @@ template void drawSegment<float>(Image<float>& image, point2i from, point2i to,
 template void drawPoint<std::uint8_t>(Image<std::uint8_t>& image, point2i pixel, Color<uint8_t> c, int size);
 template void drawPoint<float>(Image<float>& image, point2i pixel, Color<float> c, int size);
 
-template void drawPoints<std::uint8_t>(Image<std::uint8_t>& image, const std::vector<point2i>& pixels, Color<uint8_t> c, int size);
-template void drawPoints<float>(Image<float>& image, const std::vector<point2i>& pixels, Color<float> c, int size);
+template void drawPoints<std::uint8_t>(Image<std::uint8_t>& image, std::span<const point2i> pixels, Color<uint8_t> c, int size);
+template void drawPoints<float>(Image<float>& image, std::span<const point2i> pixels, Color<float> c, int size);
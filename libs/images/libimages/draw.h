@@ -1,6 +1,6 @@
 #pragma once
 
-#include <vector>
+#include <span>
 
 #include <libbase/point2.h>
 #include <libimages/image.h>
@@ -14,10 +14,10 @@ template <typename T>
 void drawPoint(Image<T>& image, point2i pixel, Color<T> c, int size=1);
 
 template <typename T>
-void drawPoints(Image<T>& image, const std::vector<point2i>& pixels, Color<T> c, int size=1);
+void drawPoints(Image<T>& image, std::span<const point2i> pixels, Color<T> c, int size=1);
 
 extern template void drawPoint<std::uint8_t>(Image<std::uint8_t>& image, point2i pixel, Color<uint8_t> c, int size);
 extern template void drawPoint<float>(Image<float>& image, point2i pixel, Color<float> c, int size);
 
-extern template void drawPoints<std::uint8_t>(Image<std::uint8_t>& image, const std::vector<point2i>& pixels, Color<uint8_t> c, int size);
-extern template void drawPoints<float>(Image<float>& image, const std::vector<point2i>& pixels, Color<float> c, int size);
+extern template void drawPoints<std::uint8_t>(Image<std::uint8_t>& image, std::span<const point2i> pixels, Color<uint8_t> c, int size);
+extern template void drawPoints<float>(Image<float>& image, std::span<const point2i> pixels, Color<float> c, int size);
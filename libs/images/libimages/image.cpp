@@ -3,52 +3,101 @@
 #include <libbase/runtime_assert.h>
 
 #include <algorithm>
+#include <cstring>
 #include <string>
+#include <utility>
 
 template <typename T> Image<T>::Image() = default;
 
 template <typename T>
-void Image<T>::init(int width, int height, int channels) {
+void Image<T>::init(int width, int height, int channels, ImageInit init) {
+    rassert(width > 0 && height > 0 && channels > 0, "Invalid image size", width, height, channels);
     w_ = width;
     h_ = height;
     c_ = channels;
-    data_ = std::vector<T>((size_t) width * height * channels);
-    rassert(width > 0 && height > 0 && channels > 0, "Invalid image size", width, height, channels);
+    resource_ = currentImageMemoryResource();
+    data_ = static_cast<T *>(resource_->allocate(elements_count() * sizeof(T), IMAGE_ALIGNMENT));
+    if (init == ImageInit::Zeros) {
+        std::memset(data_, 0, elements_count() * sizeof(T));
+    }
+}
+
+template <typename T> void Image<T>::free() noexcept {
+    if (data_) {
+        resource_->deallocate(data_, elements_count() * sizeof(T), IMAGE_ALIGNMENT);
+    }
+    data_ = nullptr;
+    resource_ = nullptr;
+    w_ = h_ = c_ = 0;
 }
 
 template <typename T>
-Image<T>::Image(int width, int height, int channels) {
-    init(width, height, channels);
+Image<T>::Image(int width, int height, int channels, ImageInit init) {
+    this->init(width, height, channels, init);
 }
 
 template <typename T>
-Image<T>::Image(std::tuple<int, int, int> size) {
+Image<T>::Image(std::tuple<int, int, int> size, ImageInit init) {
     auto [width, height, channels] = size;
-    init(width, height, channels);
+    this->init(width, height, channels, init);
 }
 
-template <typename T> int Image<T>::width() const noexcept { return w_; }
-
-template <typename T> int Image<T>::height() const noexcept { return h_; }
-
-template <typename T> int Image<T>::channels() const noexcept { return c_; }
+template <typename T> Image<T>::~Image() { free(); }
 
-template <typename T> std::tuple<int, int, int> Image<T>::size() const noexcept { return { w_, h_, c_ }; }
-
-template <typename T> std::size_t Image<T>::stride_elements() const noexcept {
-    return static_cast<std::size_t>(w_) * static_cast<std::size_t>(c_);
+template <typename T> Image<T>::Image(const Image &other) {
+    if (other.data_) {
+        init(other.w_, other.h_, other.c_, ImageInit::Uninitialized);
+        std::memcpy(data_, other.data_, elements_count() * sizeof(T));
+    }
 }
 
-template <typename T> T *Image<T>::data() noexcept { return data_.data(); }
+template <typename T>
+Image<T>::Image(Image &&other) noexcept
+    : w_(std::exchange(other.w_, 0)), h_(std::exchange(other.h_, 0)), c_(std::exchange(other.c_, 0)),
+      data_(std::exchange(other.data_, nullptr)), resource_(std::exchange(other.resource_, nullptr)) {}
+
+template <typename T> Image<T> &Image<T>::operator=(const Image &other) {
+    if (this == &other) return *this;
+    // the buffer is reused if it has the same size
+    if (!other.data_ || elements_count() != other.elements_count()) {
+        free();
+        if (other.data_) init(other.w_, other.h_, other.c_, ImageInit::Uninitialized);
+    }
+    w_ = other.w_;
+    h_ = other.h_;
+    c_ = other.c_;
+    if (data_) std::memcpy(data_, other.data_, elements_count() * sizeof(T));
+    return *this;
+}
 
-template <typename T> const T *Image<T>::data() const noexcept { return data_.data(); }
+template <typename T> Image<T> &Image<T>::operator=(Image &&other) noexcept {
+    if (this == &other) return *this;
+    free();
+    w_ = std::exchange(other.w_, 0);
+    h_ = std::exchange(other.h_, 0);
+    c_ = std::exchange(other.c_, 0);
+    data_ = std::exchange(other.data_, nullptr);
+    resource_ = std::exchange(other.resource_, nullptr);
+    return *this;
+}
 
-template <typename T> std::vector<T> Image<T>::toVector() const {
-    std::vector<T> copy = data_;
-    return copy;
+template <typename T>
+Image<T> Image<T>::adopt(T *data, int width, int height, int channels, std::pmr::memory_resource *resource) {
+    rassert(width > 0 && height > 0 && channels > 0, "Invalid image size", width, height, channels);
+    rassert(data != nullptr && resource != nullptr, 78497218937);
+    rassert(reinterpret_cast<std::uintptr_t>(data) % IMAGE_ALIGNMENT == 0, 78497218938, "Adopted buffer is not aligned");
+    Image image;
+    image.w_ = width;
+    image.h_ = height;
+    image.c_ = channels;
+    image.data_ = data;
+    image.resource_ = resource;
+    return image;
 }
 
-template <typename T> void Image<T>::fill(const T &value) { std::fill(data_.begin(), data_.end(), value); }
+template <typename T> std::vector<T> Image<T>::toVector() const { return std::vector<T>(data_, data_ + elements_count()); }
+
+template <typename T> void Image<T>::fill(const T &value) { std::fill(data_, data_ + elements_count(), value); }
 
 template <typename T> void Image<T>::check_bounds_2d(int j, int i, std::source_location loc) const {
     rassert(i >= 0 && i < w_ && j >= 0 && j < h_, 78497218931,
@@ -96,3 +145,69 @@ template <typename T> const T &Image<T>::operator()(int j, int i, int c, std::so
 template class Image<std::uint8_t>;
 template class Image<int>;
 template class Image<float>;
+
+template <typename T> ImageView<T>::ImageView() = default;
+
+template <typename T>
+ImageView<T>::ImageView(T *data, int width, int height, int channels, std::size_t stride_elements)
+    : data_(data), w_(width), h_(height), c_(channels), stride_(stride_elements) {
+    rassert(width > 0 && height > 0 && channels > 0, "Invalid image view size", width, height, channels);
+    rassert(stride_elements >= static_cast<std::size_t>(width) * static_cast<std::size_t>(channels), 78497218932,
+            stride_elements, width, channels);
+}
+
+template <typename T>
+ImageView<T>::ImageView(Image<value_type> &image)
+    : ImageView(image.data(), image.width(), image.height(), image.channels(), image.stride_elements()) {}
+
+template <typename T>
+ImageView<T>::ImageView(const Image<value_type> &image) requires std::is_const_v<T>
+    : ImageView(image.data(), image.width(), image.height(), image.channels(), image.stride_elements()) {}
+
+template <typename T>
+ImageView<T>::ImageView(const ImageView<value_type> &view) requires std::is_const_v<T>
+    : data_(view.data()), w_(view.width()), h_(view.height()), c_(view.channels()), stride_(view.stride_elements()) {}
+
+template <typename T> void ImageView<T>::check_bounds_3d(int j, int i, int c, std::source_location loc) const {
+    rassert(i >= 0 && i < w_ && j >= 0 && j < h_, 78497218934,
+            "Pixel out of bounds:", "row j=" + std::to_string(j) + "/height=" + std::to_string(h_) + ",",
+            "column i=" + std::to_string(i) + "/width=" + std::to_string(w_), format_code_location(loc));
+    rassert(c >= 0 && c < c_, 78497218935,
+            "Channel out of bounds:", "c=" + std::to_string(c) + "/channels count=" + std::to_string(c_),
+            format_code_location(loc));
+}
+
+template <typename T> T &ImageView<T>::operator()(int j, int i, std::source_location loc) const {
+    rassert(c_ == 1, "(j,i) access is only valid for grayscale images", c_);
+    check_bounds_3d(j, i, 0, loc);
+    return data_[static_cast<std::size_t>(j) * stride_ + static_cast<std::size_t>(i)];
+}
+
+template <typename T> T &ImageView<T>::operator()(int j, int i, int c, std::source_location loc) const {
+    check_bounds_3d(j, i, c, loc);
+    return data_[static_cast<std::size_t>(j) * stride_ + static_cast<std::size_t>(i) * c_ + static_cast<std::size_t>(c)];
+}
+
+template <typename T>
+ImageView<T> ImageView<T>::roi(int x, int y, int width, int height, std::source_location loc) const {
+    rassert(x >= 0 && y >= 0 && width > 0 && height > 0 && x + width <= w_ && y + height <= h_, 78497218936,
+            "ROI out of bounds:", x, y, width, height, "image:", w_, h_, format_code_location(loc));
+    return ImageView(data_ + static_cast<std::size_t>(y) * stride_ + static_cast<std::size_t>(x) * c_, width, height, c_, stride_);
+}
+
+template <typename T> Image<typename ImageView<T>::value_type> ImageView<T>::copy() const {
+    Image<value_type> result(w_, h_, c_, ImageInit::Uninitialized);
+    const std::size_t row_elements = static_cast<std::size_t>(w_) * static_cast<std::size_t>(c_);
+    for (int j = 0; j < h_; ++j) {
+        const T *src = row(j);
+        std::copy(src, src + row_elements, result.row(j));
+    }
+    return result;
+}
+
+template class ImageView<std::uint8_t>;
+template class ImageView<const std::uint8_t>;
+template class ImageView<int>;
+template class ImageView<const int>;
+template class ImageView<float>;
+template class ImageView<const float>;
@@ -2,27 +2,84 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <memory_resource>
 #include <source_location>
+#include <span>
+#include <tuple>
+#include <type_traits>
 #include <vector>
 
+#include <libimages/image_memory.h>
+
+// Rows of an image for range-for loops: for (std::span<T> row : image.rows()) for (T &v : row) ...
+template <typename T> class ImageRows final {
+  public:
+    class iterator final {
+      public:
+        using value_type = std::span<T>;
+        using difference_type = std::ptrdiff_t;
+
+        iterator() = default;
+        iterator(const ImageRows *rows, int j) : rows_(rows), j_(j) {}
+
+        std::span<T> operator*() const { return (*rows_)[j_]; }
+        iterator &operator++() { ++j_; return *this; }
+        iterator operator++(int) { iterator old = *this; ++j_; return old; }
+        bool operator==(const iterator &other) const { return j_ == other.j_; }
+
+      private:
+        const ImageRows *rows_ = nullptr;
+        int j_ = 0;
+    };
+
+    ImageRows(T *data, int height, std::size_t row_elements, std::size_t stride_elements)
+        : data_(data), h_(height), row_elements_(row_elements), stride_(stride_elements) {}
+
+    std::span<T> operator[](int j) const { return {data_ + static_cast<std::size_t>(j) * stride_, row_elements_}; }
+    iterator begin() const { return iterator(this, 0); }
+    iterator end() const { return iterator(this, h_); }
+    int size() const noexcept { return h_; }
+
+  private:
+    T *data_;
+    int h_;
+    std::size_t row_elements_;
+    std::size_t stride_;
+};
+
+// How pixels of a new image are initialized: Uninitialized skips zeroing for images that are fully overwritten anyway
+enum class ImageInit { Zeros, Uninitialized };
+
+// Pixels are stored contiguously (row after row) in an IMAGE_ALIGNMENT-aligned buffer taken from
+// currentImageMemoryResource() of the thread that created the image (see ImageMemoryScope and ImagePool).
 template <typename T> class Image final {
   public:
     using value_type = T;
 
     Image();
-    Image(int width, int height, int channels);
-    Image(std::tuple<int, int, int> size);
+    Image(int width, int height, int channels, ImageInit init = ImageInit::Zeros);
+    Image(std::tuple<int, int, int> size, ImageInit init = ImageInit::Zeros);
+    ~Image();
+
+    Image(const Image &other);
+    Image(Image &&other) noexcept;
+    Image &operator=(const Image &other);
+    Image &operator=(Image &&other) noexcept;
 
-    int width() const noexcept;
-    int height() const noexcept;
-    int channels() const noexcept;
-    std::tuple<int, int, int> size() const noexcept;
+    // Takes ownership of a buffer of width * height * channels values aligned by IMAGE_ALIGNMENT
+    // (f.e. decoded by a library), the buffer is returned to resource when the image is freed
+    static Image adopt(T *data, int width, int height, int channels, std::pmr::memory_resource *resource);
+
+    int width() const noexcept { return w_; }
+    int height() const noexcept { return h_; }
+    int channels() const noexcept { return c_; }
+    std::tuple<int, int, int> size() const noexcept { return { w_, h_, c_ }; }
 
     // Number of elements in a single row (width * channels)
-    std::size_t stride_elements() const noexcept;
+    std::size_t stride_elements() const noexcept { return static_cast<std::size_t>(w_) * static_cast<std::size_t>(c_); }
 
-    T *data() noexcept;
-    const T *data() const noexcept;
+    T *data() noexcept { return data_; }
+    const T *data() const noexcept { return data_; }
     std::vector<T> toVector() const;
 
     void fill(const T &value);
@@ -35,13 +92,36 @@ template <typename T> class Image final {
     T &operator()(int j, int i, int c, std::source_location loc = std::source_location::current());
     const T &operator()(int j, int i, int c, std::source_location loc = std::source_location::current()) const;
 
+    // Fast access for inner loops: inline, bounds are checked only in debug builds (without NDEBUG)
+    T *row(int j) { debug_check_bounds(j, 0, 0); return data_ + static_cast<std::size_t>(j) * stride_elements(); }
+    const T *row(int j) const { debug_check_bounds(j, 0, 0); return data_ + static_cast<std::size_t>(j) * stride_elements(); }
+    T &at_unchecked(int j, int i, int c = 0) { debug_check_bounds(j, i, c); return row(j)[static_cast<std::size_t>(i) * c_ + c]; }
+    const T &at_unchecked(int j, int i, int c = 0) const { debug_check_bounds(j, i, c); return row(j)[static_cast<std::size_t>(i) * c_ + c]; }
+    ImageRows<T> rows() { return {data_, h_, stride_elements(), stride_elements()}; }
+    ImageRows<const T> rows() const { return {data_, h_, stride_elements(), stride_elements()}; }
+    // All values in memory order (pixel by pixel, channels interleaved)
+    std::span<T> pixels() noexcept { return {data_, elements_count()}; }
+    std::span<const T> pixels() const noexcept { return {data_, elements_count()}; }
+
   private:
     int w_ = 0;
     int h_ = 0;
     int c_ = 0;
-    std::vector<T> data_;
+    T *data_ = nullptr;
+    std::pmr::memory_resource *resource_ = nullptr; // the buffer is returned to the resource it was taken from
 
-    void init(int w, int h, int c);
+    static_assert(std::is_trivially_copyable_v<T>, "image buffers are copied and left uninitialized as raw memory");
+
+    std::size_t elements_count() const noexcept { return stride_elements() * static_cast<std::size_t>(h_); }
+
+    void debug_check_bounds([[maybe_unused]] int j, [[maybe_unused]] int i, [[maybe_unused]] int c) const {
+#ifndef NDEBUG
+        check_bounds_3d(j, i, c, std::source_location::current());
+#endif
+    }
+
+    void init(int w, int h, int c, ImageInit init);
+    void free() noexcept;
     void check_bounds_2d(int j, int i, std::source_location loc) const;
     void check_bounds_3d(int j, int i, int c, std::source_location loc) const;
     std::size_t index(int j, int i, int c) const;
@@ -53,3 +133,66 @@ extern template class Image<float>;
 using image8u = Image<std::uint8_t>;
 using image32i = Image<int>;
 using image32f = Image<float>;
+
+// Non-owning view of an image or of its rectangular region (ROI): pixels of a row are contiguous,
+// rows are stride_elements() apart. The viewed image must outlive the view.
+// ImageView<const T> is a read-only view, any Image<T> converts to it implicitly.
+template <typename T> class ImageView final {
+  public:
+    using value_type = std::remove_const_t<T>;
+
+    ImageView();
+    ImageView(T *data, int width, int height, int channels, std::size_t stride_elements);
+    ImageView(Image<value_type> &image);
+    ImageView(const Image<value_type> &image) requires std::is_const_v<T>;
+    ImageView(const ImageView<value_type> &view) requires std::is_const_v<T>;
+
+    int width() const noexcept { return w_; }
+    int height() const noexcept { return h_; }
+    int channels() const noexcept { return c_; }
+    std::tuple<int, int, int> size() const noexcept { return { w_, h_, c_ }; }
+
+    // Number of elements between starts of neighbouring rows (>= width * channels)
+    std::size_t stride_elements() const noexcept { return stride_; }
+
+    T *data() const noexcept { return data_; }
+
+    // Access for grayscale images (channels == 1)
+    T &operator()(int j, int i, std::source_location loc = std::source_location::current()) const;
+    // Access for multi-channel images
+    T &operator()(int j, int i, int c, std::source_location loc = std::source_location::current()) const;
+
+    // Fast access for inner loops: inline, bounds are checked only in debug builds (without NDEBUG)
+    T *row(int j) const { debug_check_bounds(j, 0, 0); return data_ + static_cast<std::size_t>(j) * stride_; }
+    T &at_unchecked(int j, int i, int c = 0) const { debug_check_bounds(j, i, c); return row(j)[static_cast<std::size_t>(i) * c_ + c]; }
+    ImageRows<T> rows() const { return {data_, h_, static_cast<std::size_t>(w_) * static_cast<std::size_t>(c_), stride_}; }
+
+    // View of the region [x, x + width) x [y, y + height) - no pixels are copied
+    ImageView roi(int x, int y, int width, int height, std::source_location loc = std::source_location::current()) const;
+
+    // Owning contiguous copy of the viewed pixels
+    Image<value_type> copy() const;
+
+  private:
+    T *data_ = nullptr;
+    int w_ = 0;
+    int h_ = 0;
+    int c_ = 0;
+    std::size_t stride_ = 0;
+
+    void check_bounds_3d(int j, int i, int c, std::source_location loc) const;
+    void debug_check_bounds([[maybe_unused]] int j, [[maybe_unused]] int i, [[maybe_unused]] int c) const {
+#ifndef NDEBUG
+        check_bounds_3d(j, i, c, std::source_location::current());
+#endif
+    }
+};
+
+extern template class ImageView<std::uint8_t>;
+extern template class ImageView<const std::uint8_t>;
+extern template class ImageView<float>;
+extern template class ImageView<const float>;
+
+using image8u_view = ImageView<const std::uint8_t>;
+using image32i_view = ImageView<const int>;
+using image32f_view = ImageView<const float>;
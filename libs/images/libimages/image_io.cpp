@@ -3,9 +3,12 @@
 #include <algorithm>
 #include <cctype>
 #include <cstdio>
+#include <cstdint>
 #include <cstring>
 #include <filesystem>
+#include <memory_resource>
 #include <string>
+#include <tuple>
 #include <vector>
 
 #include <libbase/runtime_assert.h>
@@ -22,6 +25,13 @@
 #error "Define either LIBIMAGES_USE_STB or LIBIMAGES_USE_SYSTEM"
 #endif
 
+// Scanline decoding for ImageRowReader
+#if defined(LIBIMAGES_HAS_LIBJPEG) || defined(LIBIMAGES_USE_SYSTEM)
+#define LIBIMAGES_STREAM_JPEG
+#include <csetjmp>
+#include <jpeglib.h>
+#endif
+
 namespace libimages {
 
 static std::string to_lower_copy(std::string s) {
@@ -40,6 +50,26 @@ static std::string file_ext_lower(const std::string &path) {
 
 #if defined(LIBIMAGES_USE_STB)
 
+namespace libimages {
+
+// Owner of buffers decoded by stb_image (only returns them to stb)
+class StbiBuffers final : public std::pmr::memory_resource {
+  private:
+    void *do_allocate(std::size_t, std::size_t) override {
+        rassert(false, 7812093412032, "stb buffers are allocated by stb_image only");
+        return nullptr;
+    }
+    void do_deallocate(void *p, std::size_t, std::size_t) override { stbi_image_free(p); }
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override { return this == &other; }
+};
+
+static std::pmr::memory_resource *stbi_buffers() {
+    static StbiBuffers resource;
+    return &resource;
+}
+
+} // namespace libimages
+
 image8u load_image(const std::string &path) {
     const std::filesystem::path p = std::filesystem::u8path(path);
     rassert(std::filesystem::exists(p),
@@ -60,12 +90,9 @@ image8u load_image(const std::string &path) {
         rassert(false, "stbi_load failed", path, stbi_failure_reason());
     }
 
-    image8u img(w, h, req_comp);
-    const std::size_t n =
-        static_cast<std::size_t>(w) * static_cast<std::size_t>(h) * static_cast<std::size_t>(req_comp);
-    std::memcpy(img.data(), ptr, n * sizeof(std::uint8_t));
-    stbi_image_free(ptr);
-    return img;
+    // stb allocates aligned buffers (see third_party/stb/stb_impl.cpp), so the decoded pixels are adopted without a copy
+    rassert(reinterpret_cast<std::uintptr_t>(ptr) % IMAGE_ALIGNMENT == 0, 7812093412031, "stb buffer is not aligned");
+    return image8u::adopt(ptr, w, h, req_comp, libimages::stbi_buffers());
 }
 
 void save_image(const image8u &img, const std::string &path, int jpg_quality) {
@@ -167,7 +194,7 @@ static image8u load_png(const std::string &path) {
     rassert(rowbytes == static_cast<png_size_t>(w) * static_cast<png_size_t>(channels), "Unexpected PNG rowbytes", path,
             static_cast<unsigned long>(rowbytes));
 
-    image8u img(static_cast<int>(w), static_cast<int>(h), channels);
+    image8u img(static_cast<int>(w), static_cast<int>(h), channels, ImageInit::Uninitialized);
     std::vector<png_bytep> rows(static_cast<std::size_t>(h));
     for (png_uint_32 j = 0; j < h; ++j) {
         rows[static_cast<std::size_t>(j)] =
@@ -203,7 +230,7 @@ static image8u load_jpeg(const std::string &path) {
     const int channels = static_cast<int>(cinfo.output_components);
     rassert(channels == 3, "Unexpected JPEG components", channels);
 
-    image8u img(w, h, 3);
+    image8u img(w, h, 3, ImageInit::Uninitialized);
 
     std::vector<JSAMPLE> row(static_cast<std::size_t>(w) * 3);
     while (cinfo.output_scanline < cinfo.output_height) {
@@ -372,3 +399,127 @@ void save_image(const image8u &img, const std::string &path, int jpg_quality) {
 
 #endif
 
+
+#if defined(LIBIMAGES_STREAM_JPEG)
+
+namespace libimages {
+
+// libjpeg reports errors by calling error_exit that must not return: it jumps back to the setjmp of the failed call
+struct JpegErrorManager final {
+    jpeg_error_mgr pub;
+    std::jmp_buf jump;
+    char message[JMSG_LENGTH_MAX];
+};
+
+static void on_jpeg_error(j_common_ptr cinfo) {
+    JpegErrorManager *err = reinterpret_cast<JpegErrorManager *>(cinfo->err);
+    (*cinfo->err->format_message)(cinfo, err->message);
+    std::longjmp(err->jump, 1);
+}
+
+} // namespace libimages
+
+#endif
+
+struct ImageRowReader::Impl final {
+    int w = 0;
+    int h = 0;
+    int c = 0;
+    int next_row = 0;
+
+    // fallback: the whole image decoded at once
+    image8u decoded;
+
+#if defined(LIBIMAGES_STREAM_JPEG)
+    bool jpeg = false;
+    FILE *fp = nullptr;
+    jpeg_decompress_struct cinfo{};
+    libimages::JpegErrorManager err{};
+
+    // functions with setjmp have only trivial locals, so longjmp doesn't skip any destructors
+    bool jpeg_start() {
+        cinfo.err = jpeg_std_error(&err.pub);
+        err.pub.error_exit = libimages::on_jpeg_error;
+        if (setjmp(err.jump)) return false;
+        jpeg_create_decompress(&cinfo);
+        jpeg = true;
+        jpeg_stdio_src(&cinfo, fp);
+        jpeg_read_header(&cinfo, TRUE);
+        cinfo.out_color_space = JCS_RGB;
+        jpeg_start_decompress(&cinfo);
+        return true;
+    }
+
+    bool jpeg_read_row(std::uint8_t *dst, JDIMENSION &got) {
+        if (setjmp(err.jump)) return false;
+        JSAMPROW row = dst;
+        got = jpeg_read_scanlines(&cinfo, &row, 1);
+        return true;
+    }
+#endif
+
+    ~Impl() {
+#if defined(LIBIMAGES_STREAM_JPEG)
+        if (jpeg) jpeg_destroy_decompress(&cinfo);
+        if (fp) std::fclose(fp);
+#endif
+    }
+};
+
+ImageRowReader::ImageRowReader(const std::string &path) : impl_(std::make_unique<Impl>()) {
+    const std::filesystem::path p = std::filesystem::u8path(path);
+    rassert(std::filesystem::exists(p),
+            "Please check working directory and relative input file path - input file does not exist", path);
+    rassert(std::filesystem::is_regular_file(p), "Input path is not a regular file", path);
+
+#if defined(LIBIMAGES_STREAM_JPEG)
+    const std::string ext = libimages::file_ext_lower(path);
+    if (ext == "jpg" || ext == "jpeg") {
+        impl_->fp = std::fopen(path.c_str(), "rb");
+        rassert(impl_->fp != nullptr, 7812093412033, "Failed to open file", path);
+        rassert(impl_->jpeg_start(), 7812093412034, "libjpeg failed to start decoding", path, impl_->err.message);
+        impl_->w = static_cast<int>(impl_->cinfo.output_width);
+        impl_->h = static_cast<int>(impl_->cinfo.output_height);
+        impl_->c = static_cast<int>(impl_->cinfo.output_components);
+        rassert(impl_->c == 3, 7812093412035, "Unexpected JPEG components", impl_->c, path);
+        return;
+    }
+#endif
+
+    impl_->decoded = load_image(path);
+    std::tie(impl_->w, impl_->h, impl_->c) = impl_->decoded.size();
+}
+
+ImageRowReader::~ImageRowReader() = default;
+
+int ImageRowReader::width() const noexcept { return impl_->w; }
+
+int ImageRowReader::height() const noexcept { return impl_->h; }
+
+int ImageRowReader::channels() const noexcept { return impl_->c; }
+
+int ImageRowReader::rows_read() const noexcept { return impl_->next_row; }
+
+bool ImageRowReader::is_streaming() const noexcept {
+#if defined(LIBIMAGES_STREAM_JPEG)
+    return impl_->jpeg;
+#else
+    return false;
+#endif
+}
+
+int ImageRowReader::read_row(std::uint8_t *dst) {
+    rassert(impl_->next_row < impl_->h, 7812093412036, "All rows are already read", impl_->h);
+    const int j = impl_->next_row++;
+#if defined(LIBIMAGES_STREAM_JPEG)
+    if (impl_->jpeg) {
+        JDIMENSION got = 0;
+        rassert(impl_->jpeg_read_row(dst, got), 7812093412037, "libjpeg failed to decode row", j, impl_->err.message);
+        rassert(got == 1, 7812093412038, "jpeg_read_scanlines failed", j);
+        return j;
+    }
+#endif
+    const std::uint8_t *src = impl_->decoded.row(j);
+    std::copy(src, src + impl_->decoded.stride_elements(), dst);
+    return j;
+}
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstdint>
+#include <memory>
 #include <string>
 
 #include <libimages/image.h>
@@ -8,3 +10,28 @@ image8u load_image(const std::string &path);
 
 // Saves 1/3/4-channel 8-bit image. For JPEG, alpha is dropped.
 void save_image(const image8u &img, const std::string &path, int jpg_quality = 95);
+
+// Reads an image file row by row. JPEG files are decoded scanline by scanline when libjpeg is available
+// (is_streaming() == true), so the whole decoded image is never held in memory. Other files (or without libjpeg)
+// are decoded at once with load_image and then handed out row by row.
+class ImageRowReader final {
+  public:
+    explicit ImageRowReader(const std::string &path);
+    ~ImageRowReader();
+
+    ImageRowReader(const ImageRowReader &) = delete;
+    ImageRowReader &operator=(const ImageRowReader &) = delete;
+
+    int width() const noexcept;
+    int height() const noexcept;
+    int channels() const noexcept;
+    bool is_streaming() const noexcept;
+
+    // Decodes the next row (width * channels values) into dst and returns its index
+    int read_row(std::uint8_t *dst);
+    int rows_read() const noexcept;
+
+  private:
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
+};
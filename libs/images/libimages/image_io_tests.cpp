@@ -0,0 +1,95 @@
+#include "image_io.h"
+
+#include <gtest/gtest.h>
+
+#include <libbase/configure_working_directory.h>
+#include <libbase/fast_random.h>
+#include <libbase/runtime_assert.h>
+#include <libimages/debug_io.h>
+#include <libimages/tests_utils.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+namespace {
+
+image8u makeRandomImage(int w, int h, int c, std::uint32_t seed) {
+    FastRandom r(seed);
+    image8u image(w, h, c, ImageInit::Uninitialized);
+    for (std::uint8_t &v : image.pixels())
+        v = r.nextInt(0, 255);
+    return image;
+}
+
+} // namespace
+
+TEST(image_io, loadedPixelsAreAdoptedAligned) {
+    configureWorkingDirectory();
+
+    for (int c : {3, 4}) {
+        const image8u image = makeRandomImage(37, 11, c, 239 + c);
+        const std::string path = getUnitCaseDebugDir() + "random" + std::to_string(c) + ".png";
+        debug_io::dump_image(path, image);
+
+        const image8u loaded = load_image(path);
+        EXPECT_EQ(reinterpret_cast<std::uintptr_t>(loaded.data()) % IMAGE_ALIGNMENT, 0);
+        EXPECT_EQ(loaded.size(), image.size());
+        EXPECT_EQ(loaded.toVector(), image.toVector());
+    }
+}
+
+TEST(image_io, rowReaderOfPngEqualsLoadImage) {
+    configureWorkingDirectory();
+
+    const image8u image = makeRandomImage(53, 20, 3, 2391);
+    const std::string path = getUnitCaseDebugDir() + "random.png";
+    debug_io::dump_image(path, image);
+
+    ImageRowReader reader(path);
+    EXPECT_FALSE(reader.is_streaming());
+    ASSERT_EQ(reader.width(), 53);
+    ASSERT_EQ(reader.height(), 20);
+    ASSERT_EQ(reader.channels(), 3);
+    std::vector<std::uint8_t> row(53 * 3);
+    for (int j = 0; j < 20; ++j) {
+        EXPECT_EQ(reader.read_row(row.data()), j);
+        EXPECT_TRUE(std::equal(row.begin(), row.end(), image.row(j)));
+    }
+    EXPECT_EQ(reader.rows_read(), 20);
+    EXPECT_THROW(reader.read_row(row.data()), assertion_error);
+}
+
+TEST(image_io, rowReaderOfJpegMatchesLoadImage) {
+    configureWorkingDirectory();
+
+    const std::string path = "data/00_photo_six_parts_downscaled_x4.jpg";
+    const image8u image = load_image(path);
+    ImageRowReader reader(path);
+    ASSERT_EQ(reader.width(), image.width());
+    ASSERT_EQ(reader.height(), image.height());
+    ASSERT_EQ(reader.channels(), image.channels());
+
+    // libjpeg and stb_image use different IDCT and chroma upsampling, so streamed pixels can differ slightly
+    const int max_allowed_diff = reader.is_streaming() ? 8 : 0;
+    std::vector<std::uint8_t> row(image.stride_elements());
+    long long diff_sum = 0;
+    int max_diff = 0;
+    for (int j = 0; j < image.height(); ++j) {
+        reader.read_row(row.data());
+        const std::uint8_t *expected = image.row(j);
+        for (std::size_t k = 0; k < row.size(); ++k) {
+            const int diff = std::abs(int(row[k]) - int(expected[k]));
+            diff_sum += diff;
+            max_diff = std::max(max_diff, diff);
+        }
+    }
+    const double mean_diff = double(diff_sum) / image.pixels().size();
+    EXPECT_LE(max_diff, max_allowed_diff) << "streaming=" << reader.is_streaming();
+    EXPECT_LE(mean_diff, reader.is_streaming() ? 1.0 : 0.0) << "streaming=" << reader.is_streaming();
+}
+
+TEST(image_io, rowReaderOfMissingFile) {
+    EXPECT_THROW(ImageRowReader("no_such_file.jpg"), assertion_error);
+}
@@ -0,0 +1,84 @@
+#include "image_memory.h"
+
+#include <libbase/runtime_assert.h>
+
+namespace {
+
+thread_local std::pmr::memory_resource *current_resource = nullptr;
+
+} // namespace
+
+std::pmr::memory_resource *currentImageMemoryResource() noexcept {
+    return current_resource ? current_resource : std::pmr::new_delete_resource();
+}
+
+ImageMemoryScope::ImageMemoryScope(std::pmr::memory_resource *resource) noexcept : previous_(current_resource) {
+    current_resource = resource;
+}
+
+ImageMemoryScope::~ImageMemoryScope() { current_resource = previous_; }
+
+ImagePool::ImagePool(std::size_t max_cached_bytes, std::pmr::memory_resource *upstream)
+    : upstream_(upstream), max_cached_bytes_(max_cached_bytes) {
+    rassert(upstream != nullptr, 4390128374101);
+}
+
+ImagePool::~ImagePool() { release(); }
+
+void ImagePool::release() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto &[size, block] : free_) {
+        upstream_->deallocate(block.ptr, block.size, block.alignment);
+    }
+    free_.clear();
+    cached_bytes_ = 0;
+}
+
+std::size_t ImagePool::hits() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return hits_;
+}
+
+std::size_t ImagePool::misses() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return misses_;
+}
+
+std::size_t ImagePool::cached_bytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return cached_bytes_;
+}
+
+void *ImagePool::do_allocate(std::size_t bytes, std::size_t alignment) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // smallest cached buffer that fits, if it doesn't waste more than a quarter of itself
+    for (auto it = free_.lower_bound(bytes); it != free_.end() && it->first - bytes <= it->first / 4; ++it) {
+        if (it->second.alignment < alignment) continue;
+        const Block block = it->second;
+        free_.erase(it);
+        used_.emplace(block.ptr, block);
+        cached_bytes_ -= block.size;
+        ++hits_;
+        return block.ptr;
+    }
+    void *p = upstream_->allocate(bytes, alignment);
+    used_.emplace(p, Block{p, bytes, alignment});
+    ++misses_;
+    return p;
+}
+
+void ImagePool::do_deallocate(void *p, std::size_t, std::size_t) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = used_.find(p);
+    rassert(it != used_.end(), 4390128374103, "Buffer doesn't belong to the image pool");
+    const Block block = it->second;
+    used_.erase(it);
+    if (cached_bytes_ + block.size > max_cached_bytes_) {
+        upstream_->deallocate(block.ptr, block.size, block.alignment);
+        return;
+    }
+    free_.emplace(block.size, block);
+    cached_bytes_ += block.size;
+}
+
+bool ImagePool::do_is_equal(const std::pmr::memory_resource &other) const noexcept { return this == &other; }
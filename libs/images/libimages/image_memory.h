@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <memory_resource>
+#include <mutex>
+#include <unordered_map>
+
+// Alignment of image buffers (a cache line, also enough for any SIMD loads)
+constexpr std::size_t IMAGE_ALIGNMENT = 64;
+
+// Memory resource used by this thread for new image buffers (aligned new/delete unless ImageMemoryScope is active)
+std::pmr::memory_resource *currentImageMemoryResource() noexcept;
+
+// While the scope is alive, images created by this thread take their buffers from resource.
+// Each image remembers its resource, so the resource must outlive all images allocated from it
+// (including images moved to other threads, f.e. to the asynchronous debug writer).
+class ImageMemoryScope final {
+  public:
+    explicit ImageMemoryScope(std::pmr::memory_resource *resource) noexcept;
+    ~ImageMemoryScope();
+
+    ImageMemoryScope(const ImageMemoryScope &) = delete;
+    ImageMemoryScope &operator=(const ImageMemoryScope &) = delete;
+
+  private:
+    std::pmr::memory_resource *previous_;
+};
+
+// Thread-safe pool of image buffers: freed buffers are kept and handed out again for requests of a similar size,
+// so a pipeline that processes images of the same size one after another stops hitting the system allocator.
+// Cached buffers beyond max_cached_bytes are returned to the upstream resource.
+class ImagePool final : public std::pmr::memory_resource {
+  public:
+    explicit ImagePool(std::size_t max_cached_bytes = std::size_t(1) << 30,
+                       std::pmr::memory_resource *upstream = std::pmr::new_delete_resource());
+    ~ImagePool() override;
+
+    ImagePool(const ImagePool &) = delete;
+    ImagePool &operator=(const ImagePool &) = delete;
+
+    // Frees all cached (not used) buffers. Buffers still used by images are returned to the pool when freed,
+    // so the pool must outlive them.
+    void release();
+
+    std::size_t hits() const;        // allocations served by a cached buffer
+    std::size_t misses() const;      // allocations that went to the upstream resource
+    std::size_t cached_bytes() const; // bytes in cached (not used) buffers
+
+  private:
+    void *do_allocate(std::size_t bytes, std::size_t alignment) override;
+    void do_deallocate(void *p, std::size_t bytes, std::size_t alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override;
+
+    struct Block final {
+        void *ptr;
+        std::size_t size;
+        std::size_t alignment;
+    };
+
+    std::pmr::memory_resource *upstream_;
+    std::size_t max_cached_bytes_;
+
+    mutable std::mutex mutex_;
+    std::multimap<std::size_t, Block> free_; // cached buffers by their size
+    std::unordered_map<void *, Block> used_; // handed out buffers (they can be larger than requested)
+    std::size_t cached_bytes_ = 0;
+    std::size_t hits_ = 0;
+    std::size_t misses_ = 0;
+};
@@ -0,0 +1,110 @@
+#include "image_memory.h"
+
+#include <gtest/gtest.h>
+
+#include <libimages/image.h>
+
+#include <cstdint>
+#include <thread>
+#include <utility>
+
+namespace {
+
+bool isAligned(const void *p) { return reinterpret_cast<std::uintptr_t>(p) % IMAGE_ALIGNMENT == 0; }
+
+} // namespace
+
+TEST(image_memory, buffersAreAligned) {
+    for (int w : {1, 3, 17, 640}) {
+        image8u gray(w, 3, 1);
+        image32f rgb(w, 5, 3, ImageInit::Uninitialized);
+        EXPECT_TRUE(isAligned(gray.data()));
+        EXPECT_TRUE(isAligned(rgb.data()));
+    }
+}
+
+TEST(image_memory, zerosByDefault) {
+    ImagePool pool;
+    const ImageMemoryScope scope(&pool);
+    {
+        image32i garbage(64, 64, 1);
+        garbage.fill(-1);
+    }
+    // the buffer with -1 values is reused, but it is zeroed again
+    image32i zeros(64, 64, 1);
+    EXPECT_EQ(pool.hits(), 1);
+    for (int v : zeros.pixels()) {
+        ASSERT_EQ(v, 0);
+    }
+}
+
+TEST(image_memory, poolReusesBuffers) {
+    ImagePool pool;
+    {
+        const ImageMemoryScope scope(&pool);
+        for (int k = 0; k < 10; ++k) {
+            image32f gray(200, 100, 1, ImageInit::Uninitialized);
+            image8u mask(200, 100, 1, ImageInit::Uninitialized);
+        }
+    }
+    EXPECT_EQ(pool.misses(), 2);
+    EXPECT_EQ(pool.hits(), 18);
+    EXPECT_EQ(pool.cached_bytes(), 200 * 100 * (sizeof(float) + 1));
+
+    // outside of the scope images don't use the pool
+    image8u other(200, 100, 1);
+    EXPECT_EQ(pool.misses() + pool.hits(), 20);
+
+    pool.release();
+    EXPECT_EQ(pool.cached_bytes(), 0);
+}
+
+TEST(image_memory, poolDoesntHandOutTooLargeBuffers) {
+    ImagePool pool;
+    const ImageMemoryScope scope(&pool);
+    { image8u large(1000, 1000, 1); }
+    { image8u small(10, 10, 1); }
+    EXPECT_EQ(pool.hits(), 0);
+    { image8u almost_the_same(1000, 900, 1); }
+    EXPECT_EQ(pool.hits(), 1);
+}
+
+TEST(image_memory, poolCacheIsLimited) {
+    ImagePool pool(1000);
+    const ImageMemoryScope scope(&pool);
+    {
+        image8u a(20, 20, 1);
+        image8u b(20, 20, 1);
+        image8u c(20, 20, 1);
+    }
+    EXPECT_EQ(pool.cached_bytes(), 800);
+}
+
+TEST(image_memory, copiesAndMoves) {
+    ImagePool pool;
+    image8u copy;
+    {
+        const ImageMemoryScope scope(&pool);
+        image8u image(4, 3, 3);
+        image(2, 3, 1) = 7;
+
+        copy = image;
+        EXPECT_NE(copy.data(), image.data());
+        EXPECT_EQ(copy(2, 3, 1), 7);
+
+        // same size - buffer is reused
+        const std::uint8_t *buffer = copy.data();
+        image(0, 0, 0) = 1;
+        copy = image;
+        EXPECT_EQ(copy.data(), buffer);
+        EXPECT_EQ(copy(0, 0, 0), 1);
+
+        image8u moved = std::move(image);
+        EXPECT_EQ(image.data(), nullptr);
+        EXPECT_EQ(image.width(), 0);
+        EXPECT_EQ(moved(2, 3, 1), 7);
+    }
+    // images outlive the scope and can be freed by any thread - they return buffers to their pool
+    std::thread([&copy]() { copy = image8u(); }).join();
+    EXPECT_EQ(pool.cached_bytes(), 2 * 4 * 3 * 3);
+}
@@ -0,0 +1,144 @@
+#include "image.h"
+
+#include <gtest/gtest.h>
+
+#include <libbase/fast_random.h>
+#include <libbase/runtime_assert.h>
+#include <libbase/timer.h>
+
+#include <cstdint>
+#include <iostream>
+#include <span>
+#include <utility>
+#include <vector>
+
+TEST(image, viewOfImage) {
+    image8u image(5, 4, 3);
+    image(2, 3, 1) = 7;
+
+    const image8u_view view = image;
+    EXPECT_EQ(view.width(), 5);
+    EXPECT_EQ(view.height(), 4);
+    EXPECT_EQ(view.channels(), 3);
+    EXPECT_EQ(view.stride_elements(), 15);
+    EXPECT_EQ(view.data(), image.data());
+    EXPECT_EQ(view(2, 3, 1), 7);
+
+    // mutable view writes into the image
+    ImageView<std::uint8_t> writable = image;
+    writable(0, 0, 2) = 9;
+    EXPECT_EQ(image(0, 0, 2), 9);
+}
+
+TEST(image, roiAndCopy) {
+    image32f image(6, 5, 1);
+    for (int j = 0; j < 5; ++j)
+        for (int i = 0; i < 6; ++i)
+            image(j, i) = j * 10.0f + i;
+
+    const image32f_view roi = image32f_view(image).roi(2, 1, 3, 2);
+    EXPECT_EQ(roi.width(), 3);
+    EXPECT_EQ(roi.height(), 2);
+    EXPECT_EQ(roi.stride_elements(), 6);
+    EXPECT_EQ(roi(0, 0), 12.0f);
+    EXPECT_EQ(roi(1, 2), 24.0f);
+    EXPECT_EQ(roi.row(1), image.data() + 2 * 6 + 2);
+
+    // ROI of ROI is relative to the first one
+    EXPECT_EQ(roi.roi(1, 1, 1, 1)(0, 0), 23.0f);
+
+    const image32f copy = roi.copy();
+    EXPECT_EQ(copy.width(), 3);
+    EXPECT_EQ(copy.height(), 2);
+    EXPECT_EQ(copy.toVector(), std::vector<float>({12.0f, 13.0f, 14.0f, 22.0f, 23.0f, 24.0f}));
+}
+
+TEST(image, viewBoundsChecked) {
+    image8u image(4, 4, 1);
+    const image8u_view roi = image8u_view(image).roi(1, 1, 2, 2);
+    EXPECT_THROW(roi(2, 0), assertion_error);
+    EXPECT_THROW(roi(0, 0, 1), assertion_error);
+    EXPECT_THROW(roi.roi(1, 1, 2, 1), assertion_error);
+    EXPECT_THROW(image8u_view(image).roi(3, 0, 2, 1), assertion_error);
+}
+
+TEST(image, rowsAndUncheckedAccess) {
+    image32i image(4, 3, 2);
+    for (int j = 0; j < 3; ++j)
+        for (int i = 0; i < 4; ++i)
+            for (int c = 0; c < 2; ++c)
+                image(j, i, c) = j * 100 + i * 10 + c;
+
+    EXPECT_EQ(image.row(2), image.data() + 2 * 8);
+    EXPECT_EQ(image.at_unchecked(1, 3, 1), 131);
+    EXPECT_EQ(&image.at_unchecked(2, 1, 0), &image(2, 1, 0));
+    EXPECT_EQ(image.pixels().size(), 24);
+
+    int j = 0;
+    for (std::span<int> row : image.rows()) {
+        ASSERT_EQ(row.size(), 8);
+        EXPECT_EQ(row[3], j * 100 + 11);
+        row[0] = -1;
+        ++j;
+    }
+    EXPECT_EQ(j, 3);
+    EXPECT_EQ(image(1, 0, 0), -1);
+
+    // rows of a ROI skip the pixels outside of it
+    const image32i_view roi = image32i_view(image).roi(1, 1, 2, 2);
+    EXPECT_EQ(roi.at_unchecked(1, 1, 1), 221);
+    std::vector<int> values;
+    for (std::span<const int> row : roi.rows())
+        for (int v : row)
+            values.push_back(v);
+    EXPECT_EQ(values, std::vector<int>({110, 111, 120, 121, 210, 211, 220, 221}));
+}
+
+TEST(image, uncheckedAccessIsCheckedInDebugBuilds) {
+#ifdef NDEBUG
+    GTEST_SKIP() << "bounds of the fast access tier are checked only in debug builds";
+#else
+    image8u image(4, 4, 1);
+    EXPECT_THROW(image.row(4), assertion_error);
+    EXPECT_THROW(image.at_unchecked(0, 4), assertion_error);
+    EXPECT_THROW(image8u_view(image).roi(1, 1, 2, 2).at_unchecked(0, 2), assertion_error);
+#endif
+}
+
+TEST(image, benchmark_accessors) {
+    FastRandom r(2391);
+    const int w = 1920;
+    const int h = 1080;
+    image8u image(w, h, 3);
+    for (std::uint8_t &v : image.pixels())
+        v = r.nextInt(0, 255);
+
+    Timer t;
+    long long checked = 0;
+    for (int j = 0; j < h; ++j)
+        for (int i = 0; i < w; ++i)
+            for (int c = 0; c < 3; ++c)
+                checked += image(j, i, c);
+    const double checked_seconds = t.elapsed();
+
+    t.restart();
+    long long unchecked = 0;
+    for (int j = 0; j < h; ++j)
+        for (int i = 0; i < w; ++i)
+            for (int c = 0; c < 3; ++c)
+                unchecked += image.at_unchecked(j, i, c);
+    const double unchecked_seconds = t.elapsed();
+
+    t.restart();
+    long long by_rows = 0;
+    for (std::span<const std::uint8_t> row : std::as_const(image).rows())
+        for (std::uint8_t v : row)
+            by_rows += v;
+    const double rows_seconds = t.elapsed();
+
+    std::cout << "sum of " << w << "x" << h << " RGB: operator() " << checked_seconds << " sec, at_unchecked "
+              << unchecked_seconds << " sec (x" << checked_seconds / unchecked_seconds << "), rows "
+              << rows_seconds << " sec (x" << checked_seconds / rows_seconds << ")" << std::endl;
+    EXPECT_EQ(unchecked, checked);
+    EXPECT_EQ(by_rows, checked);
+}
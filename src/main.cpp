@@ -3,11 +3,13 @@
 #include <libimages/algorithms/blur.h>
 #include <libimages/algorithms/downsample.h>
 #include <libimages/algorithms/grayscale.h>
+#include <libimages/algorithms/image_pyramid.h>
 #include <libimages/algorithms/threshold_masking.h>
 #include <libimages/algorithms/morphology.h>
 #include <libimages/algorithms/split_into_parts.h>
 #include <libimages/algorithms/extract_contour.h>
 #include <libimages/algorithms/simplify_contours.h>
+#include <libimages/algorithms/match_sides.h>
 
 #include <libbase/stats.h>
 #include <libbase/timer.h>
@@ -15,452 +17,832 @@
 #include <libbase/runtime_assert.h>
 #include <libbase/configure_working_directory.h>
 #include <libimages/debug_io.h>
+#include <libimages/binary_mask.h>
+#include <libimages/debug_sink.h>
 #include <libimages/image.h>
+#include <libimages/image_memory.h>
 #include <libimages/image_io.h>
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cctype>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <sstream>
+#include <thread>
+#include <tuple>
 #include <unordered_map>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 #include "sides_comparison_utils.h"
 #include "puzzle_assembly.h"
 
-int main() {
-    try {
-        configureWorkingDirectory();
+namespace {
+
+// стадии обработки одной картинки, для каждой из них замеряется время
+// (в пакетном режиме по ним выводится p50/p99 латентность)
+enum PipelineStage {
+    STAGE_LOAD,
+    STAGE_GRAYSCALE,
+    STAGE_THRESHOLD,
+    STAGE_MORPHOLOGY,
+    STAGE_SPLIT_OBJECTS,
+    STAGE_CONTOURS,
+    STAGE_MATCHING,
+    STAGE_ASSEMBLY,
+    STAGES_COUNT
+};
+
+const char *stageName(int stage) {
+    static const char *names[STAGES_COUNT] = {
+        "load", "grayscale", "threshold", "morphology", "splitObjects", "contours", "matching", "assemblePuzzle",
+    };
+    rassert(stage >= 0 && stage < STAGES_COUNT, 834712093412, stage);
+    return names[stage];
+}
 
-        // это список картинок которые вы хотите обработать при запуске
-        // сначала тестироваться лучше всего на маленькой картинке (первая в списке)
-        // но если все работает и хочется дополнительно проверить алгоритм,
-        // то раскомментируйте остальные строчки и проверьте алгоритм и на них
-        // отладочная визуализация теперь сохраняется не напрямую в debug,
-        // а в подпапке вида debug/00_photo_six_parts_downscaled_x4 (название соответствует картинке)
-        std::vector<std::string> to_process = {
-            "00_photo_six_parts_downscaled_x4",
-            // "00_photo_six_parts",
-            // "01_eight_parts",
-            // "02_eight_parts_shuffled",
-            // "03_eight_parts_shuffled2",
-        };
+struct ImageReport final {
+    std::string image_name;
+    bool ok = false;
+    std::array<double, STAGES_COUNT> stage_seconds{};
+    double total_seconds = 0.0;
+};
+
+// шаги морфологии маски объект-фон, strength задан для полного разрешения,
+// при сегментации в уменьшенной в scale раз картинке радиусы уменьшаются во столько же раз
+std::vector<morphology::Stage> foregroundMorphologyStages(int scale) {
+    using morphology::Operation;
+    auto scaled = [scale](int strength) { return std::max(1, (strength + scale / 2) / scale); };
+    int strength = 6;
+    return {
+        {Operation::Dilate, scaled(strength)}, // 03_is_foreground_dilated
+        {Operation::Erode, scaled(strength)},  // 04_is_foreground_dilated_eroded
+        {Operation::Erode, scaled(strength)},  // 05_is_foreground_dilated_eroded_eroded
+        {Operation::Dilate, scaled(strength)},
+        // добавляем эрозию на один-два шага чтобы при взятии цветов для описания сторон - не брать случайно черные цвета с фона
+        // эта проблема особенно ярко заметна на белых сторонах - там много черных вкраплений
+        // и хорошо видно что график вместо того чтобы быть в высоких около-255 значениях - часто скакал вниз
+        {Operation::Erode, scaled(2)},
+    };
+}
 
-        // создание визуализации каждой пары сопоставлений занимает большое время, поэтому оставим этот выключатель на будущее
-        // когда нужен просто результат без анализа - можно будет выключить
-        bool draw_sides_matching_plots = false;
+// полный конвейер обработки одной картинки: load -> grayscale -> threshold -> morphology -> splitObjects -> contour -> match -> assemblePuzzle
+// весь лог пишется в out/err, чтобы в пакетном режиме логи параллельно обрабатываемых картинок не перемешивались
+// отладочные визуализации строятся и сохраняются только если их уровень включен в debug (см. DebugLevel)
+// при segmentation_scale > 1 маска объект-фон строится в уменьшенной в segmentation_scale раз картинке,
+// а в полном разрешении объекты сегментируются заново только внутри своих bbox (см. splitObjectsCoarseToFine),
+// поэтому контуры, углы и цвета сторон извлекаются с полной точностью
+// при subpixel_contours углы кусочков для сборки уточняются по субпиксельному контуру (см. extractContourSubpixel)
+void processImage(const std::string &image_path, const std::string &image_name, const debug_io::DebugSink &debug,
+                  int segmentation_scale, bool subpixel_contours, bool draw_sides_matching_plots, std::ostream &out,
+                  std::ostream &err, ImageReport &report) {
+    using debug_io::DebugLevel;
+
+    Timer total_t;
+    Timer t;
+    // замеряет время очередной стадии и перезапускает таймер для следующей
+    auto finishStage = [&](PipelineStage stage) {
+        report.stage_seconds[stage] = t.elapsed();
+        t.restart();
+    };
+
+    if (debug.enabled(DebugLevel::Summary)) {
+        // удаляем папку чтобы не анализировать случайно старые визуализации
+        std::filesystem::remove_all(debug.dir());
+    }
 
-        Timer all_images_t;
-        for (const std::string &image_name: to_process) {
-            Timer total_t;
-            Timer t;
-
-            std::string debug_dir = "debug/" + image_name + "/";
-            // удаляем папку чтобы не анализировать случайно старые визуализации
-            std::filesystem::remove_all(debug_dir);
-
-            image8u image = load_image("data/" + image_name + ".jpg");
-            auto [w, h, c] = image.size();
-            rassert(c == 3, 237045347618912, image.channels());
-            std::cout << "image loaded in " << t.elapsed() << " sec" << std::endl;
-            debug_io::dump_image(debug_dir + "00_input.jpg", image);
-
-            image32f grayscale = to_grayscale_float(image);
-            rassert(grayscale.channels() == 1, 2317812937193);
-            rassert(grayscale.width() == w && grayscale.height() == h, 7892137419283791);
-            debug_io::dump_image(debug_dir + "01_grayscale.jpg", grayscale);
-
-            std::vector<float> intensities_on_border;
-            for (int j = 0; j < h; ++j) {
-                for (int i = 0; i < w; ++i) {
-                    // пропускаем все пиксели кроме границы изображения
-                    if (i != 0 && i != w - 1 && j != 0 && j != h - 1)
-                        continue;
-                    intensities_on_border.push_back(grayscale(j, i));
-                }
-            }
-            // DONE: какой инвариант мы можем проверить про размер intensities_on_border.size()? чем он должен быть равен?
-            rassert(intensities_on_border.size() == 2 * w + 2 * h - 4, 7283197129381312);
-            std::cout << "intensities on border: " << stats::summaryStats(intensities_on_border) << std::endl;
-
-            // DONE: найдем порог разделяющий яркость на фон и объект - background_threshold
-            double background_threshold = 1.5 * stats::percentile(intensities_on_border, 90);
-            std::cout << "background threshold=" << background_threshold << std::endl;
-
-            // DONE: построим маску объект-фон + сохраним визуализацию на диск + выведем в лог процент пикселей на фоне
-            image8u is_foreground_mask = threshold_masking(grayscale, background_threshold);
-            double is_foreground_sum = stats::sum(is_foreground_mask.toVector());
-            std::cout << "thresholded background: " << stats::toPercent(w * h - is_foreground_sum / 255.0, 1.0 * w * h) << std::endl;
-            debug_io::dump_image(debug_dir + "02_is_foreground_mask.png", is_foreground_mask);
-
-            t.restart();
-            // DONE: сделаем маску более гладкой и точной через Морфологию
-            // DONE: сначала попробуем dilation + erosion, все ли хорошо поулчилось? нет ли выбросов?
-            int strength = 6;
-
-            const bool with_openmp = true;
-            image8u dilated_mask = morphology::dilate(is_foreground_mask, strength, with_openmp);
-            image8u dilated_eroded_mask = morphology::erode(dilated_mask, strength, with_openmp);
-            image8u dilated_eroded_eroded_mask = morphology::erode(dilated_eroded_mask, strength, with_openmp);
-            image8u dilated_eroded_eroded_dilated_mask = morphology::dilate(dilated_eroded_eroded_mask, strength, with_openmp);
-
-            // добавляем эрозию на один-два шага чтобы при взятии цветов для описания сторон - не брать случайно черные цвета с фона
-            // эта проблема особенно ярко заметна на белых сторонах - там много черных вкраплений
-            // и хорошо видно что график вместо того чтобы быть в высоких около-255 значениях - часто скакал вниз
-            dilated_eroded_eroded_dilated_mask = morphology::erode(dilated_eroded_eroded_dilated_mask, 2, with_openmp);
-
-            std::cout << "full morphology in " << t.elapsed() << " sec" << std::endl;
-
-            // DONE 1 посмотрите на RGB графики тех сторон у которых нет и не может быть соседей, то есть у белых полос
-            // разумно ли они выглядят? с чем это может быть связано? как это исправить?
-            debug_io::dump_image(debug_dir + "03_is_foreground_dilated.png", dilated_mask);
-            debug_io::dump_image(debug_dir + "04_is_foreground_dilated_eroded.png", dilated_eroded_mask);
-            debug_io::dump_image(debug_dir + "05_is_foreground_dilated_eroded_eroded.png", dilated_eroded_eroded_mask);
-            debug_io::dump_image(debug_dir + "06_is_foreground_dilated_eroded_eroded_dilated.png", dilated_eroded_eroded_dilated_mask);
-
-            is_foreground_mask = dilated_eroded_eroded_dilated_mask;
-            auto [objOffsets, objImages, objMasks] = splitObjects(image, is_foreground_mask);
-            int objects_count = objImages.size();
-            std::cout << objects_count << " objects extracted" << std::endl;
-            rassert(objects_count == 6 || objects_count == 8, 237189371298, objects_count);
-
-            // визуализируем цветами компоненты связности - один объект - один цвет
-            image32i image_with_object_indices(image.width(), image.height(), 1);
-            for (int obj = 0; obj < objects_count; ++obj) {
-                // это отступ - координата верхнего левого угла объекта на оригинальной картинке
-                point2i offset = objOffsets[obj];
-
-                // это маска объекта
-                image8u mask = objMasks[obj];
-
-                for (int j = 0; j < mask.height(); ++j) {
-                    for (int i = 0; i < mask.width(); ++i) {
-                        // если объект в своей маске отмечен как "тут объект"
-                        if (mask(j, i) == 255) {
-                            // то рассчитываем координаты этого пикселя в оригинальной картинке и пишем туда наш номер (индексация с 1)
-                            int global_i = offset.x + i;
-                            int global_j = offset.y + j;
-                            image_with_object_indices(global_j, global_i) = obj + 1;
-                        }
+    image8u image = load_image(image_path);
+    auto [w, h, c] = image.size();
+    rassert(c == 3, 237045347618912, image.channels());
+    out << "image loaded in " << t.elapsed() << " sec" << std::endl;
+    debug.dump(DebugLevel::Full, "00_input.jpg", image);
+    finishStage(STAGE_LOAD);
+
+    // дальше вплоть до splitObjects работаем с картинкой для сегментации - исходной или уровнем пирамиды,
+    // уменьшенным усреднением блоков 2x2 столько раз, сколько нужно (уровни строятся один раз и кешируются)
+    image8u_pyramid image_pyramid(image);
+    const image8u_view segmentation_image = image_pyramid.level(std::countr_zero(static_cast<unsigned>(segmentation_scale)));
+    if (segmentation_scale > 1) {
+        std::tie(w, h, c) = segmentation_image.size();
+        out << "segmentation at 1/" << segmentation_scale << " scale: " << w << "x" << h << std::endl;
+    }
+
+    // картинка в оттенках серого целиком нужна только для отладочной визуализации - маска ниже строится без нее
+    if (debug.enabled(DebugLevel::Full)) {
+        image32f grayscale = to_grayscale_float(segmentation_image);
+        rassert(grayscale.channels() == 1, 2317812937193);
+        rassert(grayscale.width() == w && grayscale.height() == h, 7892137419283791);
+        debug.dump(DebugLevel::Full, "01_grayscale.jpg", std::move(grayscale));
+    }
+
+    // яркости пикселей на границе изображения собираются в гистограмму 8-битной яркости (luma8)
+    const LumaHistogram intensities_on_border = border_luma_histogram(segmentation_image);
+    // DONE: какой инвариант мы можем проверить про размер intensities_on_border.size()? чем он должен быть равен?
+    rassert(intensities_on_border.total() == 2 * w + 2 * h - 4, 7283197129381312);
+    out << "intensities on border: " << intensities_on_border.total() << " values - (min=" << intensities_on_border.percentile(0)
+        << " 10%=" << intensities_on_border.percentile(10) << " median=" << intensities_on_border.percentile(50)
+        << " 90%=" << intensities_on_border.percentile(90) << " max=" << intensities_on_border.percentile(100) << ")" << std::endl;
+    finishStage(STAGE_GRAYSCALE);
+
+    // DONE: найдем порог разделяющий яркость на фон и объект - background_threshold
+    double background_threshold = 1.5 * intensities_on_border.percentile(90);
+    out << "background threshold=" << background_threshold << std::endl;
+
+    // DONE: построим маску объект-фон + сохраним визуализацию на диск + выведем в лог процент пикселей на фоне
+    // маска хранится по биту на пиксель (BinaryMask) - в 8 раз меньше памяти чем image8u с 0/255,
+    // и морфология над ней работает сразу с 64 пикселями за одну операцию
+    // яркость, сравнение с порогом, упаковка в биты и подсчет пикселей объекта - за один проход по картинке
+    std::size_t foreground_count = 0;
+    BinaryMask is_foreground_mask = threshold_luma_mask(segmentation_image, background_threshold, &foreground_count);
+    double is_foreground_sum = foreground_count;
+    out << "thresholded background: " << stats::toPercent(w * h - is_foreground_sum, 1.0 * w * h) << std::endl;
+    debug.dump(DebugLevel::Summary, "02_is_foreground_mask.png", is_foreground_mask);
+    finishStage(STAGE_THRESHOLD);
+
+    // DONE: сделаем маску более гладкой и точной через Морфологию
+    // DONE: сначала попробуем dilation + erosion, все ли хорошо поулчилось? нет ли выбросов?
+    const bool with_openmp = true;
+    const std::vector<morphology::Stage> morphology_stages = foregroundMorphologyStages(segmentation_scale);
+    // все шаги выполняются за один проход по полосам картинки (без промежуточных масок во всю картинку)
+    morphology::PipelineTimings morphology_timings;
+    BinaryMask morphology_mask = morphology::pipeline(is_foreground_mask, morphology_stages, &morphology_timings, with_openmp);
+
+    for (size_t k = 0; k < morphology_stages.size(); ++k) {
+        out << "  morphology " << morphology::operation_name(morphology_stages[k].operation) << "(" << morphology_stages[k].strength
+            << ") in " << morphology_timings.stage_seconds[k] << " sec" << std::endl;
+    }
+    out << "full morphology in " << t.elapsed() << " sec" << std::endl;
+
+    // DONE 1 посмотрите на RGB графики тех сторон у которых нет и не может быть соседей, то есть у белых полос
+    // разумно ли они выглядят? с чем это может быть связано? как это исправить?
+    // промежуточные маски нужны только для отладочных картинок - поэтому строим их только в этом случае
+    if (debug.enabled(DebugLevel::Full)) {
+        const char *filenames[] = {"03_is_foreground_dilated.png", "04_is_foreground_dilated_eroded.png",
+                                   "05_is_foreground_dilated_eroded_eroded.png"};
+        BinaryMask intermediate = is_foreground_mask;
+        for (int k = 0; k < 3; ++k) {
+            intermediate = morphology::pipeline(intermediate, {morphology_stages[k]}, nullptr, with_openmp);
+            debug.dump(DebugLevel::Full, filenames[k], intermediate);
+        }
+    }
+    debug.dump(DebugLevel::Full, "06_is_foreground_dilated_eroded_eroded_dilated.png", morphology_mask);
+    finishStage(STAGE_MORPHOLOGY);
+
+    is_foreground_mask = morphology_mask;
+    // objImages - это не копии, а окна (ImageView) в исходную картинку image, поэтому image должна жить дольше них
+    std::vector<point2i> objOffsets;
+    std::vector<image8u_view> objImages;
+    std::vector<image8u> objMasks;
+    if (segmentation_scale == 1) {
+        std::tie(objOffsets, objImages, objMasks) = splitObjects(image, is_foreground_mask);
+    } else {
+        // в полном разрешении повторяем тот же порог и ту же морфологию, но только в окрестности каждого объекта,
+        // отступ покрывает неточность границ уменьшенной маски и радиус морфологии
+        const std::vector<morphology::Stage> full_resolution_stages = foregroundMorphologyStages(1);
+        int margin = 2 * segmentation_scale;
+        for (const morphology::Stage &stage: full_resolution_stages) {
+            margin += stage.strength;
+        }
+        auto segment = [&](image8u_view roi) {
+            BinaryMask mask = threshold_luma_mask(roi, background_threshold);
+            return morphology::pipeline(mask, full_resolution_stages, nullptr, with_openmp);
+        };
+        std::tie(objOffsets, objImages, objMasks) = splitObjectsCoarseToFine(image, is_foreground_mask, segmentation_scale, margin, segment);
+    }
+    int objects_count = objImages.size();
+    out << objects_count << " objects extracted" << std::endl;
+    rassert(objects_count == 6 || objects_count == 8, 237189371298, objects_count);
+
+    // визуализируем цветами компоненты связности - один объект - один цвет
+    if (debug.enabled(DebugLevel::Summary)) {
+        image32i image_with_object_indices(image.width(), image.height(), 1);
+        for (int obj = 0; obj < objects_count; ++obj) {
+            // это отступ - координата верхнего левого угла объекта на оригинальной картинке
+            point2i offset = objOffsets[obj];
+    
+            // это маска объекта
+            image8u mask = objMasks[obj];
+    
+            for (int j = 0; j < mask.height(); ++j) {
+                for (int i = 0; i < mask.width(); ++i) {
+                    // если объект в своей маске отмечен как "тут объект"
+                    if (mask(j, i) == 255) {
+                        // то рассчитываем координаты этого пикселя в оригинальной картинке и пишем туда наш номер (индексация с 1)
+                        int global_i = offset.x + i;
+                        int global_j = offset.y + j;
+                        image_with_object_indices(global_j, global_i) = obj + 1;
                     }
                 }
             }
-            debug_io::dump_image(debug_dir + "07_colorized_objects.jpg", debug_io::colorize_labels(image_with_object_indices, 0));
-
-            std::vector<std::vector<std::vector<point2i>>> objSides(objects_count);
-            std::vector<std::vector<point2i>> objCorners(objects_count);
-            for (int obj = 0; obj < objects_count; ++obj) {
-                std::string obj_debug_dir = debug_dir + "objects/object" + std::to_string(obj) + "/";
+        }
+        debug.dump(DebugLevel::Summary, "07_colorized_objects.jpg", debug_io::colorize_labels(image_with_object_indices, 0));
+    }
+    finishStage(STAGE_SPLIT_OBJECTS);
+
+    // стороны - отрезки одного общего буфера точек контура между индексами углов (без копирования пикселей сторон)
+    std::vector<ContourSides> objSides(objects_count);
+    // углы могут быть уточнены с субпиксельной точностью (см. subpixel_contours), поэтому они во float
+    std::vector<std::vector<point2f>> objCorners(objects_count);
+    for (int obj = 0; obj < objects_count; ++obj) {
+        const debug_io::DebugSink obj_debug = debug.subdir("objects/object" + std::to_string(obj));
+
+        obj_debug.dump(DebugLevel::Full, "01_image.jpg", objImages[obj]);
+        obj_debug.dump(DebugLevel::Full, "02_mask.jpg", objMasks[obj]);
+
+        // DONE реализуйте построение маски контура-периметра, нажмите Ctrl+Click на buildContourMask:
+        // сама маска контура нужна только для визуализации - контур обходится сразу по маске объекта
+        // (traceContour дает тот же контур что и extractContour(buildContourMask(...)))
+        if (obj_debug.enabled(DebugLevel::Full)) {
+            obj_debug.dump(DebugLevel::Full, "03_mask_contour.jpg", buildContourMask(objMasks[obj]));
+        }
 
-                debug_io::dump_image(obj_debug_dir + "01_image.jpg", objImages[obj]);
-                debug_io::dump_image(obj_debug_dir + "02_mask.jpg", objMasks[obj]);
+        std::vector<point2i> contour = traceContour(objMasks[obj]);
 
-                // DONE реализуйте построение маски контура-периметра, нажмите Ctrl+Click на buildContourMask:
-                image8u objContourMask = buildContourMask(objMasks[obj]);
+        if (obj_debug.enabled(DebugLevel::Full)) {
+            // сделаем черную картинку чтобы визуализировать контур на ней
+            image32f contour_visualization(objImages[obj].width(), objImages[obj].height(), 1);
 
-                debug_io::dump_image(obj_debug_dir + "03_mask_contour.jpg", objContourMask);
+            // нарисуем на ней контур
+            for (int i = 0; i < contour.size(); ++i) {
+                point2i pixel = contour[i];
+                // сделаем цвет тем ярче - чем дальше пиксель в контуре (чтобы проверить что он по часовой стрелке)
+                drawPoint(contour_visualization, pixel, color32f(i * 255.0f / contour.size()));
+            }
 
-                std::vector<point2i> contour = extractContour(objContourMask);
+            obj_debug.dump(DebugLevel::Full, "04_mask_contour_clockwise.jpg", std::move(contour_visualization));
+        }
 
-                // сделаем черную картинку чтобы визуализировать контур на ней
-                image32f contour_visualization(objImages[obj].width(), objImages[obj].height(), 1);
+        // у нас теперь есть перечень пикселей на контуре объекта
+        // DONE реализуйте определение в этом контуре 4 вершин-углов и нарисуйте их на картинке, нажмите Ctrl+Click на simplifyContour:
+        // (углы ищутся как вершины вписанного в выпуклую оболочку контура четырехугольника максимальной площади -
+        // на пазлах это примерно те же углы (в пределах пары пикселей), что и у simplifyContour(contour, 4), но без удаления вершин контура по одной через кучу)
+        std::vector<int> corner_indices = findQuadCornerIndices(contour);
+        rassert(corner_indices.size() == 4, 32174819274812);
+        std::vector<point2i> corners;
+        for (int idx: corner_indices) {
+            corners.push_back(contour[idx]);
+            objCorners[obj].push_back(point2f(contour[idx].x, contour[idx].y));
+        }
 
-                // нарисуем на ней контур
-                for (int i = 0; i < contour.size(); ++i) {
-                    point2i pixel = contour[i];
-                    // сделаем цвет тем ярче - чем дальше пиксель в контуре (чтобы проверить что он по часовой стрелке)
-                    drawPoint(contour_visualization, pixel, color32f(i * 255.0f / contour.size()));
+        // маска уменьшена эрозией, поэтому ее углы на несколько пикселей внутри кусочка - для гомографии при сборке
+        // углы уточняются по субпиксельному контуру: изолиния порога яркости на сглаженной картинке рядом с контуром маски
+        // (стороны для сравнения цветов по-прежнему берутся из целочисленного контура - внутри кусочка)
+        if (subpixel_contours) {
+            // край кусочка бывает до ~8 пикселей снаружи маски: финальная эрозия + скругление углов открытием
+            const int radius = 10;
+            const int margin = radius + 2;
+            const int x0 = std::max(0, objOffsets[obj].x - margin);
+            const int y0 = std::max(0, objOffsets[obj].y - margin);
+            const int x1 = std::min(image.width(), objOffsets[obj].x + objImages[obj].width() + margin);
+            const int y1 = std::min(image.height(), objOffsets[obj].y + objImages[obj].height() + margin);
+            const image32f grayscale_around = blur(to_grayscale_float(image8u_view(image).roi(x0, y0, x1 - x0, y1 - y0)), 1.0f);
+            // координаты в grayscale_around = координаты в картинке объекта + shift
+            const point2i shift = objOffsets[obj] - point2i(x0, y0);
+            std::vector<point2i> shifted_contour = contour;
+            for (point2i &p: shifted_contour) {
+                p += shift;
+            }
+            const std::vector<point2f> subpixel_contour = extractContourSubpixel(grayscale_around, shifted_contour, background_threshold, radius);
+            // замкнутая изолиния короче контура маски - это не край кусочка, а какое-то пятно рядом с ним
+            std::vector<point2f> refined_corners;
+            if (subpixel_contour.size() >= contour.size() / 2) {
+                // каждому углу соответствует ближайший угол субпиксельного контура
+                const std::vector<point2f> subpixel_corners = findQuadCorners(subpixel_contour);
+                for (point2f corner: objCorners[obj]) {
+                    const point2f shifted = corner + point2f(shift.x, shift.y);
+                    const point2f nearest = *std::min_element(subpixel_corners.begin(), subpixel_corners.end(),
+                        [&](point2f a, point2f b) { return (a - shifted).norm2() < (b - shifted).norm2(); });
+                    const point2f refined = nearest - point2f(shift.x, shift.y);
+                    // два угла не могут уточниться в одну точку - иначе гомография вырождается
+                    if (std::find(refined_corners.begin(), refined_corners.end(), refined) != refined_corners.end())
+                        break;
+                    refined_corners.push_back(refined);
                 }
+            }
+            if (refined_corners.size() == 4) {
+                objCorners[obj] = refined_corners;
+            } else {
+                err << "object " << obj << ": no subpixel contour, integer corners are used" << std::endl;
+            }
+        }
 
-                debug_io::dump_image(obj_debug_dir + "04_mask_contour_clockwise.jpg", contour_visualization);
+        if (obj_debug.enabled(DebugLevel::Full)) {
+            // сделаем черную картинку чтобы визуализировать вершины-углы на ней
+            image32f corners_visualization(objImages[obj].width(), objImages[obj].height(), 1);
+            for (point2i corner: corners) {
+                drawPoint(corners_visualization, corner, color32f(255.0f), 10);
+            }
+            obj_debug.dump(DebugLevel::Full, "05_corners_visualization.jpg", std::move(corners_visualization));
+        }
 
-                // у нас теперь есть перечень пикселей на контуре объекта
-                // DONE реализуйте определение в этом контуре 4 вершин-углов и нарисуйте их на картинке, нажмите Ctrl+Click на simplifyContour:
-                std::vector<point2i> corners = simplifyContour(contour, 4);
-                objCorners[obj] = corners;
-                rassert(corners.size() == 4, 32174819274812);
+        // теперь извлечем стороны объекта - углы уже заданы индексами в контуре, поэтому их не надо в нем искать
+        objSides[obj] = ContourSides(std::move(contour), std::move(corner_indices));
+        const ContourSides &sides = objSides[obj];
+        rassert(sides.count() == 4, 237897832141);
+
+        if (obj_debug.enabled(DebugLevel::Full)) {
+            // визуализируем каждую сторону объекта отдельным цветом:
+            image8u sides_visualization(objImages[obj].width(), objImages[obj].height(), 3);
+            FastRandom r(2391);
+            for (int i = 0; i < sides.count(); ++i) {
+                color8u random_color = {(uint8_t) r.nextInt(0, 255), (uint8_t) r.nextInt(0, 255), (uint8_t) r.nextInt(0, 255)};
+                color8u side_color = random_color;
+                drawPoints(sides_visualization, sides.side(i), side_color);
+            }
+            obj_debug.dump(DebugLevel::Full, "06_sides.jpg", std::move(sides_visualization));
+        }
+    }
+    finishStage(STAGE_CONTOURS);
+
+    // в этом векторе мы будем хранить сопоставления:
+    // MatchedSide.objB - индекс сопоставленного объекта-кусочка пазла
+    // MatchedSide.sideB - индекс сопоставленной стороны сопоставленного кусочка
+    // MatchedSide.differenceBest - насколько отличаются цвета (по нашей метрике, 0 - совпадают идеально)
+    // MatchedSide.differenceSecondBest - насколько отличаются цвета со второй по лучшевизне сопоставленной стороной
+    //        (нужно для анализа "насколько наша метрика уверенно отличила правильный ответ от ложного")
+    // если сопоставления не нашлось: -1 -1 -1
+    std::vector<std::vector<MatchedSide>> objMatchedSides(objects_count);
+
+    // профиль цветов стороны не зависит от того, с какой стороной ее сравнивают - поэтому извлекаем и сглаживаем
+    // цвета каждой стороны (в обоих направлениях) ровно один раз, а при сопоставлении лишь сравниваем готовые дескрипторы
+    // DONE 2 посмотрите на графики и подумайте, может имеет смысл как-то воздействовать на снятые с границы цвета?
+    // например сгладить? если решите попробовать - воспользуйтесь готовой функцией blur(color_strip8u colors, float strength)
+    const float blur_strength = 4.0f;
+    // стороны всех объектов нумеруются подряд: сторона side объекта obj имеет номер objFirstSide[obj] + side
+    std::vector<SideDescriptor> sideDescriptors;
+    std::vector<int> objFirstSide(objects_count);
+    std::vector<int> sideObj, sideIndexInObj; // обратное соответствие: номер стороны -> (объект, сторона объекта)
+    for (int obj = 0; obj < objects_count; ++obj) {
+        objFirstSide[obj] = sideDescriptors.size();
+        for (int side = 0; side < objSides[obj].count(); ++side) {
+            // почти белые стороны - это край всего изображения, для них нет соседних кусочков паззла,
+            // поэтому они помечаются как ignored и ни с кем не сопоставляются (иначе сопоставились бы с кем-то случайным)
+            sideDescriptors.push_back(buildSideDescriptor(objImages[obj], objSides[obj].side(side), blur_strength, obj));
+            sideObj.push_back(obj);
+            sideIndexInObj.push_back(side);
+        }
+    }
 
-                // сделаем черную картинку чтобы визуализировать вершины-углы на ней
-                image32f corners_visualization(objImages[obj].width(), objImages[obj].height(), 1);
-                for (point2i corner: corners) {
-                    drawPoint(corners_visualization, corner, color32f(255.0f), 10);
-                }
-                debug_io::dump_image(obj_debug_dir + "05_corners_visualization.jpg", corners_visualization);
-
-                // теперь извлечем стороны объекта
-                std::vector<std::vector<point2i>> sides = splitContourByCorners(contour, corners);
-                rassert(sides.size() == 4, 237897832141);
-
-                // визуализируем каждую сторону объекта отдельным цветом:
-                image8u sides_visualization(objImages[obj].width(), objImages[obj].height(), 3);
-                FastRandom r(2391);
-                for (int i = 0; i < sides.size(); ++i) {
-                    color8u random_color = {(uint8_t) r.nextInt(0, 255), (uint8_t) r.nextInt(0, 255), (uint8_t) r.nextInt(0, 255)};
-                    color8u side_color = random_color;
-                    drawPoints(sides_visualization, sides[i], side_color);
-                }
-                debug_io::dump_image(obj_debug_dir + "06_sides.jpg", sides_visualization);
+    // теперь будем сопоставлять каждую сторону объекта с каждой другой стороной другого объекта
+    // DONE 3 метрика отличия двух цветов - сумма модулей разниц по каналам (см. sidesDifferences)
+    // DONE 4 финальный вердикт насколько сильно отличаются две стороны - медиана попиксельных разниц (см. sidesDifference)
+    // матрица всех попарных разниц заполняется параллельно, стороны одного и того же объекта друг с другом не сравниваются
+    out << "matching sides with each other" << std::endl;
+    const SidesDissimilarityMatrix sidesDifferencesMatrix = matchSides(sideDescriptors);
+    for (int objA = 0; objA < objects_count; ++objA) {
+        objMatchedSides[objA].resize(objSides[objA].count());
+        rassert(objMatchedSides[objA][0].differenceBest == -1, 23423431);
+        for (int sideA = 0; sideA < objSides[objA].count(); ++sideA) {
+            // два лучших кандидата - самый похожий и второй по лучшевизне
+            std::vector<SideCandidate> candidates = sidesDifferencesMatrix.topK(objFirstSide[objA] + sideA, 2);
+            if (candidates.empty())
+                continue;
+            const int best = candidates[0].side;
+            const float secondBestDifference = candidates.size() > 1 ? candidates[1].difference : -1.0f;
+            objMatchedSides[objA][sideA] = {sideObj[best], sideIndexInObj[best], candidates[0].difference, secondBestDifference};
+        }
+    }
 
-                objSides[obj] = sides;
+    if (draw_sides_matching_plots && debug.enabled(DebugLevel::Full)) {
+        // превью объекта берется из уровня его пирамиды, ближайшего к размеру превью, уровни строятся один раз на объект
+        // (а не blur + downsample всего объекта для каждой пары сторон)
+        std::vector<image8u_pyramid> objPyramids(objImages.begin(), objImages.end());
+        auto drawPreview = [&](int obj, int side_index, int preview_width, int preview_height) {
+            image8u_pyramid &pyramid = objPyramids[obj];
+            const int k = pyramid.level_for_size(preview_width, preview_height);
+            image8u preview = pyramid.level(k).copy();
+            for (point2i pixel: objSides[obj].side(side_index)) {
+                drawPoint(preview, {pixel.x >> k, pixel.y >> k}, color8u(255, 0, 0), std::max(1, 5 >> k));
             }
+            return downsample(preview, preview_width, preview_height);
+        };
 
-            // в этом векторе мы будем хранить сопоставления:
-            // MatchedSide.objB - индекс сопоставленного объекта-кусочка пазла
-            // MatchedSide.sideB - индекс сопоставленной стороны сопоставленного кусочка
-            // MatchedSide.differenceBest - насколько отличаются цвета (по нашей метрике, 0 - совпадают идеально)
-            // MatchedSide.differenceSecondBest - насколько отличаются цвета со второй по лучшевизне сопоставленной стороной
-            //        (нужно для анализа "насколько наша метрика уверенно отличила правильный ответ от ложного")
-            // если сопоставления не нашлось: -1 -1 -1
-            std::vector<std::vector<MatchedSide>> objMatchedSides(objects_count);
-
-            // теперь будем сопоставлять каждую сторону объекта с каждой другой стороной другого объекта
-            std::cout << "matching sides with each other" << std::endl;
-            // перебираем объект А и его сторону для которой мы будем искать сопоставление
-            for (int objA = 0; objA < objects_count; ++objA) {
-                std::string obj_debug_dir = debug_dir + "objects/object" + std::to_string(objA) + "/";
-                objMatchedSides[objA].resize(objSides[objA].size());
-                rassert(objMatchedSides[objA][0].differenceBest == -1, 23423431);
-                for (int sideA = 0; sideA < objSides[objA].size(); ++sideA) {
-                    // мы знаем из каких пикселей брать цвета для этих точек
-                    const std::vector<point2i> pixelsA = objSides[objA][sideA];
-                    // извлекаем цвета пикселей из картинки объекта A
-                    const std::vector<color8u> colorsA = extractColors(objImages[objA], pixelsA);
-                    const int channels = objImages[objA].channels();
-
-                    if (isMostlyWhite(colorsA)) {
-                        // пропускаем стороны которые почти полностью белые - это край всего изображения
-                        // ждя них нет соседних кусочков паззла, значит не нужно их сопоставлять (в результате сопоставляя с кем-то случайным)
-                        continue;
-                    }
+        for (int sideIdA = 0; sideIdA < sideDescriptors.size(); ++sideIdA) {
+            const int objA = sideObj[sideIdA];
+            const int sideA = sideIndexInObj[sideIdA];
+            const debug_io::DebugSink obj_debug = debug.subdir("objects/object" + std::to_string(objA));
+            for (int sideIdB = 0; sideIdB < sideDescriptors.size(); ++sideIdB) {
+                if (!sidesDifferencesMatrix.compared(sideIdA, sideIdB))
+                    continue;
+                const int objB = sideObj[sideIdB];
+                const int sideB = sideIndexInObj[sideIdB];
+                const SideDescriptor &descA = sideDescriptors[sideIdA];
+                const SideDescriptor &descB = sideDescriptors[sideIdB];
+
+                // стороны выравниваются по длине, сторона B берется в обратном порядке (как zip-молния)
+                int n = std::min(descA.colors.length(), descB.colors.length());
+                color_strip8u a = downsample(descA.colors, n);
+                color_strip8u b = downsample(descB.colors_reversed, n);
+                std::vector<float> differences;
+                sidesDifferences(descA, descB, differences);
+                float total_difference = sidesDifferencesMatrix(sideIdA, sideIdB);
+
+                // сделаем небольшой предпросмотр обоих объектов с отмеченными сторонами
+                int preview_image_width = n;
+                int preview_image_height = n;
+
+                int colors_rgb_line_height = 10;
+                int separator_line_height = 3;
+                int graph_height = 100;
+                // визуализируем наложение этих двух сторон
+                image8u ab_visualization(n + n, std::max(2 * preview_image_height,  2 * colors_rgb_line_height + 4 * separator_line_height + 2 * graph_height + graph_height), 3);
+
+                // сначала нарисуем объект A + на нем отмеченная сторона A
+                point2i offset = {0, 0}; // это точка отступа - где находится угол следующего рисуемого объекта
+                drawImage(ab_visualization, drawPreview(objA, sideA, preview_image_width, preview_image_height), offset);
+                offset.y += preview_image_height; // смещаем отступ на высоту нарисованной картинки
+
+                // затем объект B + на нем отмеченная сторона B
+                drawImage(ab_visualization, drawPreview(objB, sideB, preview_image_width, preview_image_height), offset);
+                offset.y += preview_image_height;
+
+                // графики рисуем в правой части картинки
+                offset = {preview_image_width, 0};
+
+                // сначала наложим сами цвета обеих сторон
+                drawRGBLine(ab_visualization, a, offset, colors_rgb_line_height);
+                offset.y += colors_rgb_line_height;
+                drawRGBLine(ab_visualization, b, offset, colors_rgb_line_height);
+                offset.y += colors_rgb_line_height;
+
+                color_strip8u separator_line_colors(n, color8u(0, 255, 0));
+
+                // затем построим графики яркости этих сторон - красным цветом график яркости RED канала, зеленым и синим - GREEN/BLUE соответственно
+                drawRGBLine(ab_visualization, separator_line_colors, offset, separator_line_height);
+                offset.y += separator_line_height;
+                drawGraph(ab_visualization, a, offset, graph_height);
+                offset.y += graph_height;
+                drawRGBLine(ab_visualization, separator_line_colors, offset, separator_line_height);
+                offset.y += separator_line_height;
+                drawGraph(ab_visualization, b, offset, graph_height);
+                offset.y += graph_height;
+                drawRGBLine(ab_visualization, separator_line_colors, offset, separator_line_height);
+                offset.y += separator_line_height;
+
+                // затем визуализируем графиком нашу метрику отличия
+                float normalization_value = 100.0f; // график имеет шкалу от 0 до normalization_value
+                drawGraph(ab_visualization, differences, offset, graph_height, normalization_value);
+                offset.y += graph_height;
+                drawRGBLine(ab_visualization, separator_line_colors, offset, separator_line_height);
+                offset.y += separator_line_height;
+
+                // заметьте что мы специально в начале файла пишем diff (еще и дополненный нулями)
+                // благодаря этому мы прямо в списке файлов будем видеть лучшее и худшее сопоставление
+                obj_debug.dump(DebugLevel::Full, "side" + std::to_string(sideA)
+                    + "/diff=" + pad(total_difference, 5) + "_with_object" + std::to_string(objB) + "_side" + std::to_string(sideB) + ".png",
+                    std::move(ab_visualization));
+            }
+        }
+    }
+
+    std::unordered_map<std::string, std::vector<std::vector<MatchedSide>>> correct_matches;
+    {
+        // захаркодим ответы для маленькой картинки, чтобы всегда сразу видеть сколько ответов у нас верно,
+        // а сколько - нет
+        // благодаря детерминизму алгоритма (у нас даже все FastRandom ведут себя из раза в раз - ОДИНАКОВО)
+        // от запуска к запуску все четко повторяется, включая нумерацию объектов и сторон
+        // поэтому возможно вручную фиксировать правильный ответ
+        std::vector<std::vector<MatchedSide>> answers(objects_count);
+        for (int obj = 0; obj < objects_count; ++obj) {
+            answers[obj].resize(objSides[obj].count());
+        }
+        answers[0][0] = MatchedSide(1, 2, 239, 239);
+        answers[0][1] = MatchedSide(3, 3, 239, 239);
+        answers[1][0] = MatchedSide(2, 3, 239, 239);
+        answers[1][1] = MatchedSide(5, 3, 239, 239);
+        answers[1][2] = MatchedSide(0, 0, 239, 239);
+        answers[2][2] = MatchedSide(4, 3, 239, 239);
+        answers[2][3] = MatchedSide(1, 0, 239, 239);
+        answers[3][0] = MatchedSide(5, 2, 239, 239);
+        answers[3][3] = MatchedSide(0, 1, 239, 239);
+        answers[4][2] = MatchedSide(5, 0, 239, 239);
+        answers[4][3] = MatchedSide(2, 2, 239, 239);
+        answers[5][0] = MatchedSide(4, 2, 239, 239);
+        answers[5][2] = MatchedSide(3, 0, 239, 239);
+        answers[5][3] = MatchedSide(1, 1, 239, 239);
+
+        correct_matches["00_photo_six_parts_downscaled_x4"] = answers;
+    }
 
-                    // перебираем другой объект B и его сторону с которой мы хотим попробовать себя сравнить
-                    for (int objB = 0; objB < objects_count; ++objB) {
-                        if (objA == objB)
-                            continue;
-                        for (int sideB = 0; sideB < objSides[objB].size(); ++sideB) {
-                            // мы знаем из каких пикселей брать цвета для точек второй стороны B
-                            std::vector<point2i> pixelsB = objSides[objB][sideB];
-                            // разворачиваем пиксели стороны в обратном порядке, ведь мы хотим как zip-молнию
-                            // сравнить их пиксель за пикселем, каждый из этих списков пикселей стороны - по часовой стрелке
-                            // значит они как борящиеся друг против друга шестеренки трутся и расходятся в противоположных направлениях
-                            // поэтому нужно их сориентировать инвертировав порядок одного из них
-                            std::reverse(pixelsB.begin(), pixelsB.end()); // да, эту строку нужно раскомментировать
-                            // извлекаем цвета пикселей из картинки объекта A
-                            const std::vector<color8u> colorsB = extractColors(objImages[objB], pixelsB);
-                            rassert(channels == objImages[objB].channels(), 34712839741231);
-
-                            if (isMostlyWhite(colorsB)) {
-                                // пропускаем стороны которые почти полностью белые - это край всего изображения
-                                // ждя них нет соседних кусочков паззла, значит не нужно их сопоставлять (в результате сопоставляя с кем-то случайным)
-                                continue;
-                            }
-
-                            // чтобы удобно было сравнивать - нужно чтобы эти две стороны были выравнены по длине
-                            int n = std::min(colorsA.size(), colorsB.size());
-                            // DONE 2 посмотрите на графики и подумайте, может имеет смысл как-то воздействовать на снятые с границы цвета?
-                            // например сгладить? если решите попробовать - воспользуйтесь готовой функцией blur(std::vector<color8u> colors, float strength)
-                            float blur_strength = 4.0f;
-                            std::vector<color8u> a = downsample(blur(colorsA, blur_strength), n);
-                            std::vector<color8u> b = downsample(blur(colorsB, blur_strength), n);
-                            rassert(a.size() == n && b.size() == n, 2378192321);
-
-                            // теперь давайте в каждой паре пикселей оценим насколько сильно они отличаются
-                            std::vector<float> differences(n);
-                            for (int i = 0; i < n; ++i) {
-                                float d = 0;
-                                color8u colA = a[i];
-                                color8u colB = b[i];
-                                // DONE 3 реализуйте какую-то метрику сравнивающую насколько эти два цвета colA и colB отличаются
-                                for (int c = 0; c < channels; ++c) {
-                                    uint8_t colAChannelIntensity = colA(c);
-                                    uint8_t colBChannelIntensity = colB(c);
-                                    d += std::abs((int) colAChannelIntensity - colBChannelIntensity);
-                                }
-                                differences[i] = d;
-                            }
-                            for (int i = 0; i < n; ++i) {
-                                rassert(differences[i] >= 0.0f, 32423415214, differences[i]);
-                            }
-
-                            // DONE 4 и наконец финальный вердикт - насколько сильно отличаются эти две стороны? например это может быть медиана попиксельных разниц
-                            // (не забудьте про stats::median, stats:sum, stats::percentile)
-                            float total_difference = stats::median(differences); // это совсем простой вариант чтобы код просто компилировался - тут мы берем разницу первого попавшегося одного пикселя
-
-                            float previous_best = objMatchedSides[objA][sideA].differenceBest;
-                            if (previous_best == -1 || total_difference <= previous_best) {
-                                // если раньше сопоставления еще не было вовсе (-1)
-                                // если если наше сопоставление лучше (наша разница меньше старой)
-                                // то сохраняем текущее сопоставление как пока что лучший ответ (старый ответ становится вторым по лучшевизне)
-                                objMatchedSides[objA][sideA] = {objB, sideB, total_difference, previous_best};
-                            }
-
-                            if (draw_sides_matching_plots) {
-                                // сделаем небольшой предпросмотр обоих объектов с отмеченными сторонами
-                                int preview_image_width = n;
-                                int preview_image_height = n;
-
-                                int colors_rgb_line_height = 10;
-                                int separator_line_height = 3;
-                                int graph_height = 100;
-                                // визуализируем наложение этих двух сторон
-                                image8u ab_visualization(n + n, std::max(2 * preview_image_height,  2 * colors_rgb_line_height + 4 * separator_line_height + 2 * graph_height + graph_height), 3);
-
-                                // сначала нарисуем объект A + на нем отмеченная сторона A
-                                point2i offset = {0, 0}; // это точка отступа - где находится угол следующего рисуемого объекта
-                                image8u previewA = objImages[objA];
-                                drawPoints(previewA, objSides[objA][sideA], color8u(255, 0, 0), 5);
-                                previewA = downsample(blur(previewA, previewA.width() / preview_image_width), preview_image_width, preview_image_height);
-                                drawImage(ab_visualization, previewA, offset);
-                                offset.y += preview_image_height; // смещаем отступ на высоту нарисованной картинки
-
-                                // затем объект B + на нем отмеченная сторона B
-                                image8u previewB = objImages[objB];
-                                drawPoints(previewB, objSides[objB][sideB], color8u(255, 0, 0), 5);
-                                previewB = downsample(blur(previewB, previewB.width() / preview_image_width), preview_image_width, preview_image_height);
-                                drawImage(ab_visualization, previewB, offset);
-                                offset.y += preview_image_height;
-
-                                // графики рисуем в правой части картинки
-                                offset = {preview_image_width, 0};
-
-                                // сначала наложим сами цвета обеих сторон
-                                drawRGBLine(ab_visualization, a, offset, colors_rgb_line_height);
-                                offset.y += colors_rgb_line_height;
-                                drawRGBLine(ab_visualization, b, offset, colors_rgb_line_height);
-                                offset.y += colors_rgb_line_height;
-
-                                std::vector<color8u> separator_line_colors(n, color8u(0, 255, 0));
-
-                                // затем построим графики яркости этих сторон - красным цветом график яркости RED канала, зеленым и синим - GREEN/BLUE соответственно
-                                drawRGBLine(ab_visualization, separator_line_colors, offset, separator_line_height);
-                                offset.y += separator_line_height;
-                                drawGraph(ab_visualization, a, offset, graph_height);
-                                offset.y += graph_height;
-                                drawRGBLine(ab_visualization, separator_line_colors, offset, separator_line_height);
-                                offset.y += separator_line_height;
-                                drawGraph(ab_visualization, b, offset, graph_height);
-                                offset.y += graph_height;
-                                drawRGBLine(ab_visualization, separator_line_colors, offset, separator_line_height);
-                                offset.y += separator_line_height;
-
-                                // затем визуализируем графиком нашу метрику отличия
-                                float normalization_value = 100.0f; // график имеет шкалу от 0 до normalization_value
-                                drawGraph(ab_visualization, differences, offset, graph_height, normalization_value);
-                                offset.y += graph_height;
-                                drawRGBLine(ab_visualization, separator_line_colors, offset, separator_line_height);
-                                offset.y += separator_line_height;
-
-                                // заметьте что мы специально в начале файла пишем diff (еще и дополненный нулями)
-                                // благодаря этому мы прямо в списке файлов будем видеть лучшее и худшее сопоставление
-                                debug_io::dump_image(obj_debug_dir + "side" + std::to_string(sideA)
-                                    + "/diff=" + pad(total_difference, 5) + "_with_object" + std::to_string(objB) + "_side" + std::to_string(sideB) + ".png",
-                                    ab_visualization);
-                            }
+    {
+        // нарисуем отрезками сопоставления между сторонами
+        int segment_thickness = 5;
+        // картинку копируем только если ее будем сохранять
+        const bool draw_matched_sides = debug.enabled(DebugLevel::Summary);
+        image8u segments_between_matched_sides = draw_matched_sides ? image : image8u();
+        FastRandom r(2391);
+        int correct_matches_count = 0;
+        int incorrect_matches_count = 0;
+        for (int objA = 0; objA < objects_count; ++objA) {
+            // все сопоставления исходящие из сторон этого объекта - будут одного случайного цвета
+            color8u random_color_for_object = {(uint8_t) r.nextInt(0, 255), (uint8_t) r.nextInt(0, 255), (uint8_t) r.nextInt(0, 255)};
+            point2i random_shift = {r.nextInt(-segment_thickness, segment_thickness), r.nextInt(-segment_thickness, segment_thickness)}; // это нужно чтобы встречные ребра не наслоились закрыв друг друга, а было легко видеть что это два ребра
+            for (int sideA = 0; sideA < objSides[objA].count(); ++sideA) {
+                auto [objB, sideB, differenceBest, differenceSecondBest] = objMatchedSides[objA][sideA];
+
+                if (correct_matches.count(image_name)) {
+                    auto [expectedObjB, expectedSideB, _, __] = correct_matches[image_name][objA][sideA];
+                    if (expectedObjB == objB && expectedSideB == sideB) {
+                        correct_matches_count++;
+                    } else {
+                        incorrect_matches_count++;
+                        err << "EXPECTED: obj" << objA << "-side" <<sideA << " -> obj" << expectedObjB << "-side" << expectedSideB << " with difference=" << differenceBest << " (second best: " << differenceSecondBest << ")" << " - BUT FOUND:" << std::endl;
+                        if (differenceBest == -1) {
+                            err << "obj" << objA << "-side" <<sideA << " -> obj" << objB << "-side" << sideB << " with difference=" << differenceBest << " (second best: " << differenceSecondBest << ")" << std::endl;
                         }
                     }
                 }
-            }
 
-            std::unordered_map<std::string, std::vector<std::vector<MatchedSide>>> correct_matches;
-            {
-                // захаркодим ответы для маленькой картинки, чтобы всегда сразу видеть сколько ответов у нас верно,
-                // а сколько - нет
-                // благодаря детерминизму алгоритма (у нас даже все FastRandom ведут себя из раза в раз - ОДИНАКОВО)
-                // от запуска к запуску все четко повторяется, включая нумерацию объектов и сторон
-                // поэтому возможно вручную фиксировать правильный ответ
-                std::vector<std::vector<MatchedSide>> answers(objects_count);
-                for (int obj = 0; obj < objects_count; ++obj) {
-                    answers[obj].resize(objSides[obj].size());
+                if (differenceBest == -1) {
+                    continue;
+                }
+
+                out << "obj" << objA << "-side" <<sideA << " -> obj" << objB << "-side" << sideB << " with difference=" << differenceBest << " (second best: " << differenceSecondBest << ")" << std::endl;
+                const std::span<const point2i> sideAPixels = objSides[objA].side(sideA);
+                const std::span<const point2i> sideBPixels = objSides[objB].side(sideB);
+                point2i sideACenter = objOffsets[objA] + sideAPixels[sideAPixels.size() / 2]; // вершина в середине стороны A
+                point2i sideBCenter = objOffsets[objB] + sideBPixels[sideBPixels.size() / 2]; // вершина в середине сопоставленной с ней стороны B
+                if (draw_matched_sides) {
+                    drawPoint(segments_between_matched_sides, random_shift + sideACenter, random_color_for_object, 4 * segment_thickness);
+                    drawSegment(segments_between_matched_sides, random_shift + sideACenter, random_shift + sideBCenter, random_color_for_object, segment_thickness);
                 }
-                answers[0][0] = MatchedSide(1, 2, 239, 239);
-                answers[0][1] = MatchedSide(3, 3, 239, 239);
-                answers[1][0] = MatchedSide(2, 3, 239, 239);
-                answers[1][1] = MatchedSide(5, 3, 239, 239);
-                answers[1][2] = MatchedSide(0, 0, 239, 239);
-                answers[2][2] = MatchedSide(4, 3, 239, 239);
-                answers[2][3] = MatchedSide(1, 0, 239, 239);
-                answers[3][0] = MatchedSide(5, 2, 239, 239);
-                answers[3][3] = MatchedSide(0, 1, 239, 239);
-                answers[4][2] = MatchedSide(5, 0, 239, 239);
-                answers[4][3] = MatchedSide(2, 2, 239, 239);
-                answers[5][0] = MatchedSide(4, 2, 239, 239);
-                answers[5][2] = MatchedSide(3, 0, 239, 239);
-                answers[5][3] = MatchedSide(1, 1, 239, 239);
-
-                correct_matches["00_photo_six_parts_downscaled_x4"] = answers;
             }
+        }
+        if (correct_matches.count(image_name)) {
+            out << "correct matches: " << correct_matches_count << std::endl;
+            out << "incorrect matches: " << incorrect_matches_count << std::endl;
+        }
+        debug.dump(DebugLevel::Summary, "08_matched_sides.jpg", std::move(segments_between_matched_sides));
+    }
+    finishStage(STAGE_MATCHING);
+
+    // Занятие 7
+    // Итак у нас есть:
+    // 1) objOffsets, objImages, objMasks - извлеченные изображения объектов-кусочков (с маской и смещением указывающим на позицию в целой картинке)
+    // 2) objSides[obj].side(side) - span<const point2i> - координаты пикселей стороны side объекта obj (в его извлеченном изображении)
+    // 3) objMatchedSides[objA][sideA] = {objB, sideB, ...}; - информация о том с каким (objB, sideB) нас сопоставило, или (-1, -1) если мы являемся белым краем
+
+    // План:
+    // 1) Построить граф: вершины - объекты, ребра - сопоставления с другими объектами (из objMatchedSides)
+    // 2) Найти в графе вершины-углы - попробовать выложить паззл начиная с них
+    // 3) Найдя угол выясним сколько кусочков в ширину - прошагаем по графу вправо до упора
+    // 4) Так же выясним сколько кусочков в высоту - шагаем от угла вниз до упора
+    // 5) Сверяем что ширина * высоту = числу кусочков (иначе - пропускаем этот уголок, попробуем начать с другого)
+    // 6) Создаем двумерный массив, каждая ячейка будет хранить номер кусочка-объекта + число поворотов по часовой стрелке (такое чтобы side0 смотрело направо, соответственно side1 - вниз, и т.д.)
+    // 7) Выводим его для проверки в консоль
+    // 8) Заполняем его распространяясь в ширину от кусочка-уголка
+    // 9) TODO Определим ширину/высоту каждого столбика/строки пазла (медиана от ширин/высот назначенных кусочков)
+    //    пока что в коде сделано наивно - везде ширина и толщина берется за 200 пикселей
+    // 10) Найдем для каждого кусочка матрицу описывающую переход из его изображения в общий холст
+    // 11) Спроецируем все кусочки этой матрицей
+    PuzzleAssemblyResult assembled = assemblePuzzle(objImages, objMasks, objCorners, objMatchedSides);
+
+    printGrid(out, assembled);
+
+    debug.dump(DebugLevel::Summary, "09_assembled_with_lines.png", std::move(assembled.assembledWithLines));
+    debug.dump(DebugLevel::Summary, "10_assembled.png", std::move(assembled.assembled));
+    finishStage(STAGE_ASSEMBLY);
+
+    report.total_seconds = total_t.elapsed();
+    out << "image " << image_name << " processed in " << report.total_seconds << " sec" << std::endl;
+    report.ok = true;
+}
 
-            {
-                // нарисуем отрезками сопоставления между сторонами
-                int segment_thickness = 5;
-                image8u segments_between_matched_sides = image;
-                FastRandom r(2391);
-                int correct_matches_count = 0;
-                int incorrect_matches_count = 0;
-                for (int objA = 0; objA < objects_count; ++objA) {
-                    // все сопоставления исходящие из сторон этого объекта - будут одного случайного цвета
-                    color8u random_color_for_object = {(uint8_t) r.nextInt(0, 255), (uint8_t) r.nextInt(0, 255), (uint8_t) r.nextInt(0, 255)};
-                    point2i random_shift = {r.nextInt(-segment_thickness, segment_thickness), r.nextInt(-segment_thickness, segment_thickness)}; // это нужно чтобы встречные ребра не наслоились закрыв друг друга, а было легко видеть что это два ребра
-                    for (int sideA = 0; sideA < objSides[objA].size(); ++sideA) {
-                        auto [objB, sideB, differenceBest, differenceSecondBest] = objMatchedSides[objA][sideA];
-
-                        if (correct_matches.count(image_name)) {
-                            auto [expectedObjB, expectedSideB, _, __] = correct_matches[image_name][objA][sideA];
-                            if (expectedObjB == objB && expectedSideB == sideB) {
-                                correct_matches_count++;
-                            } else {
-                                incorrect_matches_count++;
-                                std::cerr << "EXPECTED: obj" << objA << "-side" <<sideA << " -> obj" << expectedObjB << "-side" << expectedSideB << " with difference=" << differenceBest << " (second best: " << differenceSecondBest << ")" << " - BUT FOUND:" << std::endl;
-                                if (differenceBest == -1) {
-                                    std::cerr << "obj" << objA << "-side" <<sideA << " -> obj" << objB << "-side" << sideB << " with difference=" << differenceBest << " (second best: " << differenceSecondBest << ")" << std::endl;
-                                }
-                            }
-                        }
+// это список картинок которые обрабатываются при запуске без аргументов
+// сначала тестироваться лучше всего на маленькой картинке (первая в списке)
+// но если все работает и хочется дополнительно проверить алгоритм,
+// то раскомментируйте остальные строчки и проверьте алгоритм и на них
+// отладочная визуализация теперь сохраняется не напрямую в debug,
+// а в подпапке вида debug/00_photo_six_parts_downscaled_x4 (название соответствует картинке)
+std::vector<std::string> defaultImagesToProcess() {
+    std::vector<std::string> to_process = {
+        "00_photo_six_parts_downscaled_x4",
+        // "00_photo_six_parts",
+        // "01_eight_parts",
+        // "02_eight_parts_shuffled",
+        // "03_eight_parts_shuffled2",
+    };
+    std::vector<std::string> paths;
+    for (const std::string &image_name: to_process) {
+        paths.push_back("data/" + image_name + ".jpg");
+    }
+    return paths;
+}
 
-                        if (differenceBest == -1) {
-                            continue;
-                        }
+bool isSupportedImageFile(const std::filesystem::path &path) {
+    std::string ext = path.extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char ch) { return static_cast<char>(std::tolower(ch)); });
+    return ext == ".jpg" || ext == ".jpeg" || ext == ".png";
+}
 
-                        std::cout << "obj" << objA << "-side" <<sideA << " -> obj" << objB << "-side" << sideB << " with difference=" << differenceBest << " (second best: " << differenceSecondBest << ")" << std::endl;
-                        point2i sideACenter = objOffsets[objA] + objSides[objA][sideA][objSides[objA][sideA].size() / 2]; // вершина в середине стороны A
-                        point2i sideBCenter = objOffsets[objB] + objSides[objB][sideB][objSides[objB][sideB].size() / 2]; // вершина в середине сопоставленной с ней стороны B
-                        drawPoint(segments_between_matched_sides, random_shift + sideACenter, random_color_for_object, 4 * segment_thickness);
-                        drawSegment(segments_between_matched_sides, random_shift + sideACenter, random_shift + sideBCenter, random_color_for_object, segment_thickness);
-                    }
+// input - либо папка (берутся все .jpg/.jpeg/.png в ней), либо файл-манифест со списком путей (по одному в строке,
+// пустые строки и строки начинающиеся с # пропускаются, относительные пути считаются от папки манифеста)
+std::vector<std::string> listImagesToProcess(const std::filesystem::path &input) {
+    namespace fs = std::filesystem;
+    rassert(fs::exists(input), "Batch input does not exist", input.string());
+
+    std::vector<std::string> paths;
+    if (fs::is_directory(input)) {
+        for (const fs::directory_entry &entry: fs::directory_iterator(input)) {
+            if (entry.is_regular_file() && isSupportedImageFile(entry.path())) {
+                paths.push_back(entry.path().string());
+            }
+        }
+        // порядок обхода папки не определен - сортируем чтобы запуски были воспроизводимы
+        std::sort(paths.begin(), paths.end());
+    } else {
+        std::ifstream manifest(input);
+        rassert(manifest.is_open(), "Can't open batch manifest", input.string());
+        std::string line;
+        while (std::getline(manifest, line)) {
+            line.erase(0, line.find_first_not_of(" \t\r"));
+            line.erase(line.find_last_not_of(" \t\r") + 1);
+            if (line.empty() || line[0] == '#')
+                continue;
+            fs::path path = line;
+            if (path.is_relative())
+                path = input.parent_path() / path;
+            paths.push_back(path.string());
+        }
+    }
+    rassert(!paths.empty(), "No images found in batch input", input.string());
+    return paths;
+}
+
+void printBatchSummary(const std::vector<ImageReport> &reports, double elapsed_seconds) {
+    std::vector<std::vector<double>> stage_seconds(STAGES_COUNT);
+    std::vector<double> total_seconds;
+    int failed_count = 0;
+    for (const ImageReport &report: reports) {
+        if (!report.ok) {
+            ++failed_count;
+            continue;
+        }
+        for (int stage = 0; stage < STAGES_COUNT; ++stage) {
+            stage_seconds[stage].push_back(report.stage_seconds[stage]);
+        }
+        total_seconds.push_back(report.total_seconds);
+    }
+
+    std::cout << reports.size() << " images processed (" << failed_count << " failed) in " << elapsed_seconds << " sec, "
+              << reports.size() / elapsed_seconds << " images/sec" << std::endl;
+    if (total_seconds.empty())
+        return;
+
+    std::cout << std::left << std::setw(16) << "stage" << std::right << std::setw(12) << "p50 sec" << std::setw(12) << "p99 sec" << std::endl;
+    auto printRow = [](const std::string &name, const std::vector<double> &values) {
+        std::cout << std::left << std::setw(16) << name << std::right << std::fixed << std::setprecision(4)
+                  << std::setw(12) << stats::percentile(values, 50) << std::setw(12) << stats::percentile(values, 99)
+                  << std::defaultfloat << std::endl;
+    };
+    for (int stage = 0; stage < STAGES_COUNT; ++stage) {
+        printRow(stageName(stage), stage_seconds[stage]);
+    }
+    printRow("total", total_seconds);
+}
+
+} // namespace
+
+// Usage:
+// CVPuzzleSolver                          - обрабатывает картинки из defaultImagesToProcess()
+// CVPuzzleSolver <dir|manifest> [--jobs N] - пакетный режим: все картинки из папки (или из файла-манифеста)
+//                                           обрабатываются параллельно на N потоках (по умолчанию - по числу ядер),
+//                                           при N > 1 каждая картинка обрабатывается однопоточно (без OpenMP внутри
+//                                           алгоритмов), чтобы всего было не больше N потоков, при N = 1 алгоритмы
+//                                           используют OpenMP на всех ядрах
+// --debug off|summary|full                - какие отладочные визуализации сохранять в debug/<картинка>/
+//                                           (по умолчанию full, а в пакетном режиме - off)
+// --segmentation-scale N                  - искать объекты в уменьшенной в N = 2^k раз картинке (f.e. 4 или 8 для фото
+//                                           в полном разрешении), контуры и цвета сторон все равно в полном разрешении
+// --subpixel-contours                     - уточнять углы кусочков для сборки по субпиксельному контуру
+int main(int argc, char **argv) {
+    try {
+        std::filesystem::path batch_input;
+        int jobs = 0;
+        std::string debug_level_name;
+        int segmentation_scale = 1;
+        bool subpixel_contours = false;
+        for (int i = 1; i < argc; ++i) {
+            const std::string arg = argv[i];
+            if (arg == "--jobs" && i + 1 < argc) {
+                jobs = std::stoi(argv[++i]);
+                rassert(jobs > 0, "--jobs must be positive", jobs);
+            } else if (arg == "--segmentation-scale" && i + 1 < argc) {
+                segmentation_scale = std::stoi(argv[++i]);
+                rassert(std::has_single_bit(static_cast<unsigned>(segmentation_scale)), "--segmentation-scale must be a power of two", segmentation_scale);
+            } else if (arg == "--subpixel-contours") {
+                subpixel_contours = true;
+            } else if (arg == "--debug" && i + 1 < argc) {
+                debug_level_name = argv[++i];
+            } else {
+                rassert(batch_input.empty(), "Unexpected argument", arg);
+                // запоминаем абсолютный путь до того как configureWorkingDirectory() сменит рабочую папку
+                batch_input = std::filesystem::absolute(arg);
+            }
+        }
+
+        configureWorkingDirectory();
+
+        std::vector<std::string> image_paths = batch_input.empty() ? defaultImagesToProcess() : listImagesToProcess(batch_input);
+        const bool batch_mode = !batch_input.empty();
+        if (jobs == 0) {
+            jobs = batch_mode ? std::max(1u, std::thread::hardware_concurrency()) : 1;
+        }
+        jobs = std::min<int>(jobs, image_paths.size());
+
+        // в пакетном режиме нужен только результат, поэтому кодирование и сохранение отладочных картинок по умолчанию выключено
+        const debug_io::DebugLevel debug_level = !debug_level_name.empty() ? debug_io::parseDebugLevel(debug_level_name)
+                                               : (batch_mode ? debug_io::DebugLevel::Off : debug_io::DebugLevel::Full);
+        // буферы картинок (grayscale, маски, промежуточные результаты blur, вырезанные объекты...) берутся из общего пула:
+        // освобожденный буфер переиспользуется следующей картинкой такого же размера вместо нового выделения памяти,
+        // пул объявлен раньше потока-писателя отладочных картинок, т.к. должен пережить все картинки из очереди писателя
+        ImagePool image_pool;
+
+        // кодирование JPEG/PNG происходит в отдельном потоке-писателе (общем для всех картинок), а не в потоках-обработчиках
+        std::shared_ptr<debug_io::AsyncImageWriter> debug_writer;
+        if (debug_level != debug_io::DebugLevel::Off) {
+            debug_writer = std::make_shared<debug_io::AsyncImageWriter>();
+        }
+
+        // создание визуализации каждой пары сопоставлений занимает большое время, поэтому оставим этот выключатель на будущее
+        // когда нужен просто результат без анализа - можно будет выключить
+        bool draw_sides_matching_plots = false;
+
+        std::vector<ImageReport> reports(image_paths.size());
+        std::atomic<std::size_t> next_image = 0;
+        std::mutex log_mutex;
+
+        // каждый поток-обработчик берет следующую еще не взятую картинку, пока они не закончатся
+        auto worker = [&]() {
+            const ImageMemoryScope image_memory(&image_pool);
+#ifdef _OPENMP
+            // параллельность уже по картинкам - иначе каждый из N потоков запускал бы в алгоритмах свои N потоков OpenMP
+            if (jobs > 1) {
+                omp_set_num_threads(1);
+            }
+#endif
+            while (true) {
+                const std::size_t index = next_image++;
+                if (index >= image_paths.size())
+                    break;
+
+                const std::string &image_path = image_paths[index];
+                ImageReport &report = reports[index];
+                report.image_name = std::filesystem::path(image_path).stem().string();
+
+                // если поток один - пишем лог сразу, иначе копим лог картинки и выводим его целиком по окончании
+                std::ostringstream out_buffer, err_buffer;
+                std::ostream &out = (jobs == 1) ? std::cout : out_buffer;
+                std::ostream &err = (jobs == 1) ? std::cerr : err_buffer;
+                try {
+                    const debug_io::DebugSink debug(debug_level, "debug/" + report.image_name + "/", debug_writer);
+                    processImage(image_path, report.image_name, debug, segmentation_scale, subpixel_contours, draw_sides_matching_plots, out, err, report);
+                } catch (const std::exception &e) {
+                    err << "Error while processing " << image_path << ": " << e.what() << "\n";
                 }
-                if (correct_matches.count(image_name)) {
-                    std::cout << "correct matches: " << correct_matches_count << std::endl;
-                    std::cout << "incorrect matches: " << incorrect_matches_count << std::endl;
+
+                if (jobs != 1) {
+                    std::lock_guard<std::mutex> lock(log_mutex);
+                    std::cout << out_buffer.str() << std::flush;
+                    std::cerr << err_buffer.str() << std::flush;
                 }
-                debug_io::dump_image(debug_dir + "08_matched_sides.jpg", segments_between_matched_sides);
             }
+        };
 
-            // Занятие 7
-            // Итак у нас есть:
-            // 1) objOffsets, objImages, objMasks - извлеченные изображения объектов-кусочков (с маской и смещением указывающим на позицию в целой картинке)
-            // 2) objSides[obj][side] - vector<point2i> - координаты пикселей стороны side объекта obj (в его извлеченном изображении)
-            // 3) objMatchedSides[objA][sideA] = {objB, sideB, ...}; - информация о том с каким (objB, sideB) нас сопоставило, или (-1, -1) если мы являемся белым краем
-
-            // План:
-            // 1) Построить граф: вершины - объекты, ребра - сопоставления с другими объектами (из objMatchedSides)
-            // 2) Найти в графе вершины-углы - попробовать выложить паззл начиная с них
-            // 3) Найдя угол выясним сколько кусочков в ширину - прошагаем по графу вправо до упора
-            // 4) Так же выясним сколько кусочков в высоту - шагаем от угла вниз до упора
-            // 5) Сверяем что ширина * высоту = числу кусочков (иначе - пропускаем этот уголок, попробуем начать с другого)
-            // 6) Создаем двумерный массив, каждая ячейка будет хранить номер кусочка-объекта + число поворотов по часовой стрелке (такое чтобы side0 смотрело направо, соответственно side1 - вниз, и т.д.)
-            // 7) Выводим его для проверки в консоль
-            // 8) Заполняем его распространяясь в ширину от кусочка-уголка
-            // 9) TODO Определим ширину/высоту каждого столбика/строки пазла (медиана от ширин/высот назначенных кусочков)
-            //    пока что в коде сделано наивно - везде ширина и толщина берется за 200 пикселей
-            // 10) Найдем для каждого кусочка матрицу описывающую переход из его изображения в общий холст
-            // 11) Спроецируем все кусочки этой матрицей
-            PuzzleAssemblyResult assembled = assemblePuzzle(objImages, objMasks, objCorners, objMatchedSides);
-
-            printGrid(std::cout, assembled);
-
-            debug_io::dump_image(debug_dir + "09_assembled_with_lines.png", assembled.assembledWithLines);
-            debug_io::dump_image(debug_dir + "10_assembled.png", assembled.assembled);
-
-            std::cout << "image " << image_name << " processed in " << total_t.elapsed() << " sec" << std::endl;
+        Timer all_images_t;
+        std::vector<std::thread> workers;
+        for (int i = 1; i < jobs; ++i) {
+            workers.emplace_back(worker);
+        }
+        worker();
+        for (std::thread &thread: workers) {
+            thread.join();
+        }
+        const double all_images_seconds = all_images_t.elapsed();
+        std::cout << "all images processed in " << all_images_seconds << " sec" << std::endl;
+        std::cout << "image buffers: " << image_pool.misses() << " allocated, " << image_pool.hits() << " reused" << std::endl;
+        if (debug_writer) {
+            debug_writer->flush();
+            std::cout << "debug images saved in " << all_images_t.elapsed() - all_images_seconds << " sec" << std::endl;
         }
-        std::cout << "all images processed in " << all_images_t.elapsed() << " sec" << std::endl;
 
+        if (batch_mode) {
+            printBatchSummary(reports, all_images_seconds);
+        }
+
+        for (const ImageReport &report: reports) {
+            if (!report.ok)
+                return 2;
+        }
         return 0;
     } catch (const std::exception &e) {
         std::cerr << "Error: " << e.what() << "\n";
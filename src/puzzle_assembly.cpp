@@ -3,6 +3,7 @@
 #include <libbase/runtime_assert.h>
 #include <libbase/stats.h>
 #include <libimages/draw.h>
+#include <libimages/algorithms/warp_perspective.h>
 
 #include <algorithm>
 #include <array>
@@ -264,204 +265,17 @@ static float dist2f(point2i a, point2i b) {
 static int medianRounded(const std::vector<float>& v, int fallback) {
     if (v.empty()) return fallback;
     std::vector<float> tmp = v;
-    const float m = static_cast<float>(stats::median(tmp));
+    const float m = static_cast<float>(stats::medianInPlace(tmp.data(), tmp.size()));
     const int r = (int)std::lround(std::max(1.0f, m));
     return r;
 }
 
-// ------------------- Homography -------------------
-
-struct H3 final {
-    // Row-major 3x3
-    double a[9]{};
-};
-
-static H3 invert3x3OrDie(const H3& M) {
-    const double* m = M.a;
-    const double a00 = m[0], a01 = m[1], a02 = m[2];
-    const double a10 = m[3], a11 = m[4], a12 = m[5];
-    const double a20 = m[6], a21 = m[7], a22 = m[8];
-
-    const double c00 =  a11 * a22 - a12 * a21;
-    const double c01 = -(a10 * a22 - a12 * a20);
-    const double c02 =  a10 * a21 - a11 * a20;
-
-    const double c10 = -(a01 * a22 - a02 * a21);
-    const double c11 =  a00 * a22 - a02 * a20;
-    const double c12 = -(a00 * a21 - a01 * a20);
-
-    const double c20 =  a01 * a12 - a02 * a11;
-    const double c21 = -(a00 * a12 - a02 * a10);
-    const double c22 =  a00 * a11 - a01 * a10;
-
-    const double det = a00 * c00 + a01 * c01 + a02 * c02;
-    rassert(std::abs(det) > 1e-12, 90100011, "Homography matrix is singular");
-
-    const double invDet = 1.0 / det;
-
-    H3 inv;
-    // adjugate = cofactors transposed
-    inv.a[0] = c00 * invDet;
-    inv.a[1] = c10 * invDet;
-    inv.a[2] = c20 * invDet;
-
-    inv.a[3] = c01 * invDet;
-    inv.a[4] = c11 * invDet;
-    inv.a[5] = c21 * invDet;
-
-    inv.a[6] = c02 * invDet;
-    inv.a[7] = c12 * invDet;
-    inv.a[8] = c22 * invDet;
-
-    return inv;
-}
-
-static void applyH(const H3& H, double x, double y, double& ox, double& oy) {
-    const double* m = H.a;
-    const double w = m[6] * x + m[7] * y + m[8];
-    rassert(std::abs(w) > 1e-12, 90100012, "Invalid homography w");
-    ox = (m[0] * x + m[1] * y + m[2]) / w;
-    oy = (m[3] * x + m[4] * y + m[5]) / w;
-}
-
-static H3 solveHomography4ptOrDie(
-    const std::array<point2f, 4>& src,
-    const std::array<point2f, 4>& dst) {
-
-    // Unknowns: h00 h01 h02 h10 h11 h12 h20 h21, with h22=1
-    double A[8][9] = {}; // augmented matrix [8 x (8+1)]
-
-    for (int i = 0; i < 4; ++i) {
-        const double x = src[i].x;
-        const double y = src[i].y;
-        const double u = dst[i].x;
-        const double v = dst[i].y;
-
-        // u row
-        {
-            double* r = A[2 * i];
-            r[0] = x; r[1] = y; r[2] = 1.0;
-            r[3] = 0; r[4] = 0; r[5] = 0;
-            r[6] = -x * u; r[7] = -y * u;
-            r[8] = u;
-        }
-        // v row
-        {
-            double* r = A[2 * i + 1];
-            r[0] = 0; r[1] = 0; r[2] = 0;
-            r[3] = x; r[4] = y; r[5] = 1.0;
-            r[6] = -x * v; r[7] = -y * v;
-            r[8] = v;
-        }
-    }
-
-    // Gaussian elimination with partial pivoting
-    for (int col = 0; col < 8; ++col) {
-        int piv = col;
-        double best = std::abs(A[col][col]);
-        for (int r = col + 1; r < 8; ++r) {
-            const double v = std::abs(A[r][col]);
-            if (v > best) {
-                best = v;
-                piv = r;
-            }
-        }
-        rassert(best > 1e-12, 90100013, "Homography solve failed: singular system");
-
-        if (piv != col) {
-            for (int k = col; k < 9; ++k) std::swap(A[piv][k], A[col][k]);
-        }
-
-        const double diag = A[col][col];
-        for (int k = col; k < 9; ++k) A[col][k] /= diag;
-
-        for (int r = 0; r < 8; ++r) {
-            if (r == col) continue;
-            const double f = A[r][col];
-            if (f == 0.0) continue;
-            for (int k = col; k < 9; ++k) A[r][k] -= f * A[col][k];
-        }
-    }
-
-    double h[8]{};
-    for (int i = 0; i < 8; ++i) h[i] = A[i][8];
-
-    H3 H{};
-    H.a[0] = h[0]; H.a[1] = h[1]; H.a[2] = h[2];
-    H.a[3] = h[3]; H.a[4] = h[4]; H.a[5] = h[5];
-    H.a[6] = h[6]; H.a[7] = h[7]; H.a[8] = 1.0;
-    return H;
-}
-
-// ------------------- Sampling -------------------
-
-static inline uint8_t clamp_u8(int v) {
-    if (v < 0) return 0;
-    if (v > 255) return 255;
-    return static_cast<uint8_t>(v);
-}
-
-static void sampleBilinearRGB(const image8u& img, float x, float y, uint8_t& r, uint8_t& g, uint8_t& b) {
-    const int W = img.width();
-    const int H = img.height();
-    rassert(W > 0 && H > 0, 90100014);
-
-    // Clamp to image bounds
-    x = std::clamp(x, 0.0f, float(W - 1));
-    y = std::clamp(y, 0.0f, float(H - 1));
-
-    const int x0 = (int)std::floor(x);
-    const int y0 = (int)std::floor(y);
-    const int x1 = std::min(x0 + 1, W - 1);
-    const int y1 = std::min(y0 + 1, H - 1);
-
-    const float fx = x - float(x0);
-    const float fy = y - float(y0);
-
-    auto at = [&](int yy, int xx, int c) -> float {
-        if (img.channels() == 1) {
-            return float(img(yy, xx));
-        }
-        return float(img(yy, xx, c));
-    };
-
-    float c00r = at(y0, x0, 0), c00g = at(y0, x0, 1), c00b = at(y0, x0, 2);
-    float c10r = at(y0, x1, 0), c10g = at(y0, x1, 1), c10b = at(y0, x1, 2);
-    float c01r = at(y1, x0, 0), c01g = at(y1, x0, 1), c01b = at(y1, x0, 2);
-    float c11r = at(y1, x1, 0), c11g = at(y1, x1, 1), c11b = at(y1, x1, 2);
-
-    float r0 = c00r * (1 - fx) + c10r * fx;
-    float g0 = c00g * (1 - fx) + c10g * fx;
-    float b0 = c00b * (1 - fx) + c10b * fx;
-
-    float r1 = c01r * (1 - fx) + c11r * fx;
-    float g1 = c01g * (1 - fx) + c11g * fx;
-    float b1 = c01b * (1 - fx) + c11b * fx;
-
-    float rf = r0 * (1 - fy) + r1 * fy;
-    float gf = g0 * (1 - fy) + g1 * fy;
-    float bf = b0 * (1 - fy) + b1 * fy;
-
-    r = clamp_u8((int)std::lround(rf));
-    g = clamp_u8((int)std::lround(gf));
-    b = clamp_u8((int)std::lround(bf));
-}
-
-static bool maskNearestIsObject(const image8u& mask, float x, float y) {
-    const int W = mask.width();
-    const int H = mask.height();
-    const int xi = (int)std::lround(x);
-    const int yi = (int)std::lround(y);
-    if (xi < 0 || xi >= W || yi < 0 || yi >= H) return false;
-    return mask(yi, xi) == 255;
-}
-
 } // namespace
 
 PuzzleAssemblyResult assemblePuzzle(
-    const std::vector<image8u>& objImages,
+    const std::vector<image8u_view>& objImages,
     const std::vector<image8u>& objMasks,
-    const std::vector<std::vector<point2i>>& objCorners,
+    const std::vector<std::vector<point2f>>& objCorners,
     const std::vector<std::vector<MatchedSide>>& objMatchedSides) {
 
     const int objects_count = static_cast<int>(objImages.size());
@@ -539,7 +353,7 @@ PuzzleAssemblyResult assemblePuzzle(
     const int canvasW = xOff[static_cast<size_t>(W)];
     const int canvasH = yOff[static_cast<size_t>(H)];
 
-    // Assemble with inverse warping per cell
+    // Assemble with inverse warping per cell (pixels outside of the piece masks stay black)
     res.assembled = image8u(canvasW, canvasH, 3);
     res.assembled.fill(0);
 
@@ -549,63 +363,34 @@ PuzzleAssemblyResult assemblePuzzle(
             const int obj = pp.obj;
             const int rot = pp.rot90;
 
-            const image8u& srcImg = objImages[static_cast<size_t>(obj)];
+            const image8u_view srcImg = objImages[static_cast<size_t>(obj)];
             const image8u& srcMask = objMasks[static_cast<size_t>(obj)];
             const auto& corners = objCorners[static_cast<size_t>(obj)];
 
-            // Destination rectangle corners
-            const float X0 = (float)xOff[static_cast<size_t>(gx)];
-            const float Y0 = (float)yOff[static_cast<size_t>(gy)];
-            const float X1 = (float)xOff[static_cast<size_t>(gx + 1)];
-            const float Y1 = (float)yOff[static_cast<size_t>(gy + 1)];
+            // Destination cell of the canvas, the piece is warped into its ROI
+            const int X0 = xOff[static_cast<size_t>(gx)];
+            const int Y0 = yOff[static_cast<size_t>(gy)];
+            const int cellW = xOff[static_cast<size_t>(gx + 1)] - X0;
+            const int cellH = yOff[static_cast<size_t>(gy + 1)] - Y0;
 
+            // Destination rectangle corners (in the cell)
             std::array<point2f, 4> dst = {
-                point2f{X0, Y0}, // TL
-                point2f{X1, Y0}, // TR
-                point2f{X1, Y1}, // BR
-                point2f{X0, Y1}  // BL
+                point2f{0.0f, 0.0f},                 // TL
+                point2f{(float)cellW, 0.0f},         // TR
+                point2f{(float)cellW, (float)cellH}, // BR
+                point2f{0.0f, (float)cellH}          // BL
             };
 
             // Source corners for these board corners, using rot
-            const point2i TLi = corners[static_cast<size_t>(pieceCornerFromBoardCorner(3, rot))];
-            const point2i TRi = corners[static_cast<size_t>(pieceCornerFromBoardCorner(0, rot))];
-            const point2i BRi = corners[static_cast<size_t>(pieceCornerFromBoardCorner(1, rot))];
-            const point2i BLi = corners[static_cast<size_t>(pieceCornerFromBoardCorner(2, rot))];
-
             std::array<point2f, 4> src = {
-                point2f{(float)TLi.x, (float)TLi.y},
-                point2f{(float)TRi.x, (float)TRi.y},
-                point2f{(float)BRi.x, (float)BRi.y},
-                point2f{(float)BLi.x, (float)BLi.y}
+                corners[static_cast<size_t>(pieceCornerFromBoardCorner(3, rot))], // TL
+                corners[static_cast<size_t>(pieceCornerFromBoardCorner(0, rot))], // TR
+                corners[static_cast<size_t>(pieceCornerFromBoardCorner(1, rot))], // BR
+                corners[static_cast<size_t>(pieceCornerFromBoardCorner(2, rot))]  // BL
             };
 
-            const H3 Hsrc2dst = solveHomography4ptOrDie(src, dst);
-            const H3 Hdst2src = invert3x3OrDie(Hsrc2dst);
-
-            const int ix0 = (int)std::floor(std::min(X0, X1));
-            const int iy0 = (int)std::floor(std::min(Y0, Y1));
-            const int ix1 = (int)std::ceil (std::max(X0, X1));
-            const int iy1 = (int)std::ceil (std::max(Y0, Y1));
-
-            for (int Y = iy0; Y < iy1; ++Y) {
-                if (Y < 0 || Y >= res.assembled.height()) continue;
-                for (int X = ix0; X < ix1; ++X) {
-                    if (X < 0 || X >= res.assembled.width()) continue;
-
-                    // Use pixel center
-                    double sx = 0.0, sy = 0.0;
-                    applyH(Hdst2src, (double)X + 0.5, (double)Y + 0.5, sx, sy);
-
-                    if (!maskNearestIsObject(srcMask, (float)sx, (float)sy)) continue;
-
-                    uint8_t rr = 0, gg = 0, bb = 0;
-                    sampleBilinearRGB(srcImg, (float)sx, (float)sy, rr, gg, bb);
-
-                    res.assembled(Y, X, 0) = rr;
-                    res.assembled(Y, X, 1) = gg;
-                    res.assembled(Y, X, 2) = bb;
-                }
-            }
+            const Homography Hsrc2dst = Homography::fromCorrespondences(src, dst);
+            warpPerspective(srcImg, srcMask, Hsrc2dst.inverse(), ImageView<std::uint8_t>(res.assembled).roi(X0, Y0, cellW, cellH));
         }
     }
 
@@ -34,9 +34,9 @@ struct PuzzleAssemblyResult final {
 };
 
 PuzzleAssemblyResult assemblePuzzle(
-    const std::vector<image8u>& objImages,
+    const std::vector<image8u_view>& objImages,
     const std::vector<image8u>& objMasks,
-    const std::vector<std::vector<point2i>>& objCorners, // size=objects_count, each size=4, order consistent with side indices
+    const std::vector<std::vector<point2f>>& objCorners, // size=objects_count, each size=4, order consistent with side indices (can be subpixel)
     const std::vector<std::vector<MatchedSide>>& objMatchedSides);
 
 void printGrid(std::ostream& os, const PuzzleAssemblyResult& r);
@@ -2,6 +2,7 @@
 
 #include <libbase/stats.h>
 #include <libbase/runtime_assert.h>
+#include <libimages/algorithms/blur.h>
 
 #include <algorithm>
 #include <cmath>
@@ -10,12 +11,6 @@
 
 namespace {
 
-inline void set_rgb(image8u& img, int x, int y, const color8u& c) {
-    img(y, x, 0) = c(0);
-    img(y, x, 1) = c(1);
-    img(y, x, 2) = c(2);
-}
-
 inline void set_rgb(image8u& img, int x, int y, uint8_t r, uint8_t g, uint8_t b) {
     img(y, x, 0) = r;
     img(y, x, 1) = g;
@@ -36,73 +31,90 @@ inline int sample_index_round(int i, int n, int m) {
 
 } // namespace
 
-std::vector<color8u> extractColors(const image8u &image, const std::vector<point2i> &pixels) {
+color_strip8u extractColors(image8u_view image, std::span<const point2i> pixels) {
     rassert(image.channels() == 1 || image.channels() == 3, 983417231, image.channels());
 
-    std::vector<color8u> out;
-    out.reserve(pixels.size());
+    const int n = static_cast<int>(pixels.size());
+    color_strip8u out(n, 3);
+    uint8_t *r = out.channel(0);
+    uint8_t *g = out.channel(1);
+    uint8_t *b = out.channel(2);
 
     const int w = image.width();
     const int h = image.height();
     const int c = image.channels();
 
-    for (const auto& p : pixels) {
+    for (int k = 0; k < n; ++k) {
+        const point2i p = pixels[k];
         rassert(p.x >= 0 && p.x < w && p.y >= 0 && p.y < h, 983417232);
 
         if (c == 3) {
-            out.emplace_back(image(p.y, p.x, 0), image(p.y, p.x, 1), image(p.y, p.x, 2));
+            r[k] = image(p.y, p.x, 0);
+            g[k] = image(p.y, p.x, 1);
+            b[k] = image(p.y, p.x, 2);
         } else {
-            uint8_t v = image(p.y, p.x);
-            out.emplace_back(v, v, v);
+            r[k] = g[k] = b[k] = image(p.y, p.x);
         }
     }
 
     return out;
 }
 
-bool isMostlyWhite(const std::vector<color8u> &colors, double percentile, uint8_t percentileMinIntensity) {
-    std::vector<float> intensities;
-    for (const color8u &color: colors) {
-        for (int c = 0; c < color.channels(); ++c) {
-            intensities.push_back(color(c));
-        }
-    }
-    double percentile_intensity = stats::percentile(intensities, percentile);
+bool isMostlyWhite(const color_strip8u &colors, double percentile, uint8_t percentileMinIntensity) {
+    // planes are contiguous, so all channels of all colors are just colors.length() * colors.channels() values,
+    // they are counted into a histogram in place (without copying them into a vector)
+    stats::Histogram<256> intensities;
+    intensities.add(colors.data(), (size_t) colors.length() * colors.channels());
+    double percentile_intensity = intensities.percentile(percentile);
     bool is_mostly_white = percentile_intensity > percentileMinIntensity;
     return is_mostly_white;
 }
 
-void drawImage(image8u &image, image8u &image_part, point2i offset) {
+SideDescriptor buildSideDescriptor(image8u_view image, std::span<const point2i> pixels, float blur_strength, int obj) {
+    const color_strip8u colors = extractColors(image, pixels);
+
+    SideDescriptor descriptor;
+    descriptor.group = obj;
+    descriptor.ignored = isMostlyWhite(colors);
+    descriptor.colors = blur(colors, blur_strength);
+    // blur the reversed colors instead of reversing the blurred ones - the summation order (and so rounding) stays
+    // exactly the same as if the side's pixels were reversed before extraction
+    descriptor.colors_reversed = blur(colors.reversed(), blur_strength);
+    return descriptor;
+}
+
+void drawImage(image8u &image, image8u_view image_part, point2i offset) {
     rassert(offset.y + image_part.height() <= image.height(), 1231412431);
     rassert(offset.x + image_part.width() <= image.width(), 64534524523);
+    rassert(offset.x >= 0 && offset.y >= 0, 3427823974239, offset.x, offset.y);
     rassert(image.channels() == image_part.channels(), 3427823974238);
+    const std::size_t row_elements = static_cast<std::size_t>(image_part.width()) * image_part.channels();
     for (int j = 0; j < image_part.height(); ++j) {
-        for (int i = 0; i < image_part.width(); ++i) {
-            for (int c = 0; c < image_part.channels(); ++c) {
-                image(offset.y + j, offset.x + i, c) = image_part(j, i, c);
-            }
-        }
+        const std::uint8_t *src = image_part.row(j);
+        std::copy(src, src + row_elements, &image.at_unchecked(offset.y + j, offset.x));
     }
 }
 
-void drawRGBLine(image8u &image, std::vector<color8u> &a, point2i offset, int height) {
+void drawRGBLine(image8u &image, const color_strip8u &a, point2i offset, int height) {
     rassert(image.channels() == 3, 981273641);
+    rassert(a.channels() == 3, 981273644);
 
     rassert(offset.y + height <= image.height(), 1231412445631);
-    rassert(offset.x + a.size() <= image.width(), 64534524522353);
+    rassert(offset.x + a.length() <= image.width(), 64534524522353);
 
-    for (int x = 0; x < a.size(); ++x) {
+    for (int x = 0; x < a.length(); ++x) {
         for (int y = 0; y < height; ++y) {
-            set_rgb(image, offset.x + x, offset.y + y, a[x]);
+            set_rgb(image, offset.x + x, offset.y + y, a(x, 0), a(x, 1), a(x, 2));
         }
     }
 }
 
-void drawGraph(image8u &image, std::vector<color8u> &a, point2i offset, int height) {
+void drawGraph(image8u &image, const color_strip8u &a, point2i offset, int height) {
     rassert(image.channels() == 3, 981273642);
+    rassert(a.channels() == 3, 981273645);
 
     rassert(offset.y + height <= image.height(), 54656234);
-    rassert(offset.x + a.size() <= image.width(), 247426342);
+    rassert(offset.x + a.length() <= image.width(), 247426342);
 
     auto y_from_val = [&](int v) -> int {
         v = clampi(v, 0, 255);
@@ -112,10 +124,10 @@ void drawGraph(image8u &image, std::vector<color8u> &a, point2i offset, int heig
         return yy;
     };
 
-    for (int x = 0; x < a.size(); ++x) {
-        const int yr = y_from_val(a[x](0));
-        const int yg = y_from_val(a[x](1));
-        const int yb = y_from_val(a[x](2));
+    for (int x = 0; x < a.length(); ++x) {
+        const int yr = y_from_val(a(x, 0));
+        const int yg = y_from_val(a(x, 1));
+        const int yb = y_from_val(a(x, 2));
 
         // R channel graph (red)
         set_rgb(image, offset.x + x, offset.y + yr, 255, 0, 0);
@@ -1,22 +1,31 @@
 #pragma once
 
+#include <span>
 #include <string>
 #include <vector>
 
 #include <libbase/point2.h>
 #include <libimages/color.h>
+#include <libimages/color_strip.h>
 #include <libimages/image.h>
+#include <libimages/algorithms/match_sides.h>
 
 
-std::vector<color8u> extractColors(const image8u &image, const std::vector<point2i> &pixels);
+// colors of the pixels (always 3 channels, grayscale is replicated), one allocation for the whole side
+color_strip8u extractColors(image8u_view image, std::span<const point2i> pixels);
 
-bool isMostlyWhite(const std::vector<color8u> &colors, double percentile=5, uint8_t percentileMinIntensity=175);
+bool isMostlyWhite(const color_strip8u &colors, double percentile=5, uint8_t percentileMinIntensity=175);
 
-void drawImage(image8u &image, image8u &image_part, point2i offset);
+// Color profile of a puzzle piece side - it doesn't depend on the side it is compared with,
+// so it is built once per side and then reused for all pairs.
+// Colors are blurred, mostly white sides (border of the whole image - they have no neighbour) are ignored.
+SideDescriptor buildSideDescriptor(image8u_view image, std::span<const point2i> pixels, float blur_strength, int obj);
 
-void drawRGBLine(image8u &image, std::vector<color8u> &a, point2i offset, int height);
+void drawImage(image8u &image, image8u_view image_part, point2i offset);
 
-void drawGraph(image8u &image, std::vector<color8u> &a, point2i offset, int height);
+void drawRGBLine(image8u &image, const color_strip8u &a, point2i offset, int height);
+
+void drawGraph(image8u &image, const color_strip8u &a, point2i offset, int height);
 
 void drawGraph(image8u &image, std::vector<float> &a, point2i offset, int height, float maxValue=-1.0f);
 
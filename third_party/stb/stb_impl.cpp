@@ -1,5 +1,46 @@
 // This translation unit compiles stb once for the whole project.
 
+#include <cstdlib>
+#include <cstring>
+
+#if defined(_WIN32)
+#include <malloc.h>
+#endif
+
+// Pixels decoded by stbi_load are adopted by images without a copy (see load_image in libimages),
+// so stb_image allocates its buffers with the image buffers alignment (IMAGE_ALIGNMENT in libimages/image_memory.h).
+static constexpr std::size_t STBI_BUFFER_ALIGNMENT = 64;
+
+static void *stbi_aligned_malloc(std::size_t size) {
+    const std::size_t rounded = (size + STBI_BUFFER_ALIGNMENT - 1) / STBI_BUFFER_ALIGNMENT * STBI_BUFFER_ALIGNMENT;
+#if defined(_WIN32)
+    return _aligned_malloc(rounded, STBI_BUFFER_ALIGNMENT);
+#else
+    return std::aligned_alloc(STBI_BUFFER_ALIGNMENT, rounded);
+#endif
+}
+
+static void stbi_aligned_free(void *p) {
+#if defined(_WIN32)
+    _aligned_free(p);
+#else
+    std::free(p);
+#endif
+}
+
+static void *stbi_aligned_realloc(void *p, std::size_t old_size, std::size_t new_size) {
+    void *result = stbi_aligned_malloc(new_size);
+    if (result && p) {
+        std::memcpy(result, p, old_size < new_size ? old_size : new_size);
+        stbi_aligned_free(p);
+    }
+    return result;
+}
+
+#define STBI_MALLOC(sz) stbi_aligned_malloc(sz)
+#define STBI_REALLOC_SIZED(p, oldsz, newsz) stbi_aligned_realloc(p, oldsz, newsz)
+#define STBI_FREE(p) stbi_aligned_free(p)
+
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 